@@ -17,7 +17,25 @@
 
 #include "Adafruit_BMP085.h"
 
+// startMeasurement() / measure() states
+#define BMP085_IDLE         0
+#define BMP085_TEMPERATURE  1
+#define BMP085_PRESSURE     2
+#define BMP085_DONE         3
+
 Adafruit_BMP085::Adafruit_BMP085() {
+  state = BMP085_IDLE;
+  started = 0;
+  lastUP = 0;
+  lastB5 = 0;
+  B5 = 0;
+  haveB5 = false;
+  b5Reads = 0;
+  b5Time = 0;
+  refreshReads = BMP085_TEMP_READS;
+  refreshAge = BMP085_TEMP_MAX_AGE;
+  altitude = 0;
+  seaLevelFactor = 1UL << 24;
 }
 
 
@@ -30,20 +48,24 @@ boolean Adafruit_BMP085::begin(uint8_t mode) {
 
   if (read8(0xD0) != 0x55) return false;
 
-  /* read calibration data */
-  ac1 = read16(BMP085_CAL_AC1);
-  ac2 = read16(BMP085_CAL_AC2);
-  ac3 = read16(BMP085_CAL_AC3);
-  ac4 = read16(BMP085_CAL_AC4);
-  ac5 = read16(BMP085_CAL_AC5);
-  ac6 = read16(BMP085_CAL_AC6);
+  /* read calibration data, all 11 words in one burst */
+  uint8_t cal[22];
+  readBytes(BMP085_CAL_AC1, cal, sizeof(cal));
+
+  ac1 = (cal[0] << 8) | cal[1];
+  ac2 = (cal[2] << 8) | cal[3];
+  ac3 = (cal[4] << 8) | cal[5];
+  ac4 = (cal[6] << 8) | cal[7];
+  ac5 = (cal[8] << 8) | cal[9];
+  ac6 = (cal[10] << 8) | cal[11];
 
-  b1 = read16(BMP085_CAL_B1);
-  b2 = read16(BMP085_CAL_B2);
+  b1 = (cal[12] << 8) | cal[13];
+  b2 = (cal[14] << 8) | cal[15];
 
-  mb = read16(BMP085_CAL_MB);
-  mc = read16(BMP085_CAL_MC);
-  md = read16(BMP085_CAL_MD);
+  mb = (cal[16] << 8) | cal[17];
+  mc = (cal[18] << 8) | cal[19];
+  md = (cal[20] << 8) | cal[21];
+  haveB5 = false;
 #if (BMP085_DEBUG == 1)
   Serial.print("ac1 = "); Serial.println(ac1, DEC);
   Serial.print("ac2 = "); Serial.println(ac2, DEC);
@@ -82,21 +104,9 @@ uint32_t Adafruit_BMP085::readRawPressure(void) {
   uint32_t raw;
 
   write8(BMP085_CONTROL, BMP085_READPRESSURECMD + (oversampling << 6));
+  delay(pressureWait());
 
-  if (oversampling == BMP085_ULTRALOWPOWER) 
-    delay(5);
-  else if (oversampling == BMP085_STANDARD) 
-    delay(8);
-  else if (oversampling == BMP085_HIGHRES) 
-    delay(14);
-  else 
-    delay(26);
-
-  raw = read16(BMP085_PRESSUREDATA);
-
-  raw <<= 8;
-  raw |= read8(BMP085_PRESSUREDATA+2);
-  raw >>= (8 - oversampling);
+  raw = readPressureData();
 
  /* this pull broke stuff, look at it later?
   if (oversampling==0) {
@@ -114,15 +124,14 @@ uint32_t Adafruit_BMP085::readRawPressure(void) {
 
 
 int32_t Adafruit_BMP085::readPressure(void) {
-  int32_t UT, UP, B3, B5, B6, X1, X2, X3, p;
-  uint32_t B4, B7;
+  int32_t UP;
 
-  UT = readRawTemperature();
+  if (temperatureStale())
+    updateB5(readRawTemperature());
   UP = readRawPressure();
 
 #if BMP085_DEBUG == 1
   // use datasheet numbers!
-  UT = 27898;
   UP = 23843;
   ac6 = 23153;
   ac5 = 32757;
@@ -135,13 +144,18 @@ int32_t Adafruit_BMP085::readPressure(void) {
   ac1 = 408;
   ac4 = 32741;
   oversampling = 0;
+  updateB5(27898);
 #endif
 
-  B5 = computeB5(UT);
+  b5Reads++;
+  return computePressure(B5, UP);
+}
+
+int32_t Adafruit_BMP085::computePressure(int32_t B5, int32_t UP) {
+  int32_t B3, B6, X1, X2, X3, p;
+  uint32_t B4, B7;
 
 #if BMP085_DEBUG == 1
-  Serial.print("X1 = "); Serial.println(X1);
-  Serial.print("X2 = "); Serial.println(X2);
   Serial.print("B5 = "); Serial.println(B5);
 #endif
 
@@ -194,13 +208,32 @@ int32_t Adafruit_BMP085::readPressure(void) {
   return p;
 }
 
+int32_t Adafruit_BMP085::readSealevelPressure(void) {
+  return sealevelPressure(readPressure());
+}
+
 int32_t Adafruit_BMP085::readSealevelPressure(float altitude_meters) {
-  float pressure = readPressure();
+  // callers pass the same altitude every time, keep its factor
+  if (altitude_meters != altitude)
+    setAltitude(altitude_meters);
+  return sealevelPressure(readPressure());
+}
+
+void Adafruit_BMP085::setAltitude(float altitude_meters) {
+  altitude = altitude_meters;
+  seaLevelFactor = (uint32_t)(16777216 / pow(1.0-altitude_meters/44330, 5.255) + 0.5);
+}
+
+int32_t Adafruit_BMP085::sealevelPressure(int32_t pressure) {
+  return (int32_t)(((int64_t)pressure * seaLevelFactor + (1L << 23)) >> 24);
+}
+
+int32_t Adafruit_BMP085::sealevelPressure(int32_t pressure, float altitude_meters) {
   return (int32_t)(pressure / pow(1.0-altitude_meters/44330, 5.255));
 }
 
 float Adafruit_BMP085::readTemperature(void) {
-  int32_t UT, B5;     // following ds convention
+  int32_t UT;     // following ds convention
   float temp;
 
   UT = readRawTemperature();
@@ -214,13 +247,115 @@ float Adafruit_BMP085::readTemperature(void) {
   md = 2868;
 #endif
 
-  B5 = computeB5(UT);
+  // a fresh temperature is free to reuse for the next pressure readings
+  updateB5(UT);
   temp = (B5+8) >> 4;
   temp /= 10;
   
   return temp;
 }
 
+// pressure conversion time in ms for the oversampling setting
+uint8_t Adafruit_BMP085::pressureWait(void) {
+  if (oversampling == BMP085_ULTRALOWPOWER) 
+    return 5;
+  else if (oversampling == BMP085_STANDARD) 
+    return 8;
+  else if (oversampling == BMP085_HIGHRES) 
+    return 14;
+  else 
+    return 26;
+}
+
+void Adafruit_BMP085::setTemperatureRefresh(uint8_t reads, unsigned long maxAge) {
+  refreshReads = reads;
+  refreshAge = maxAge;
+}
+
+// true if the cached B5 is due to be converted again
+boolean Adafruit_BMP085::temperatureStale(void) {
+  return !haveB5 || b5Reads >= refreshReads || millis() - b5Time >= refreshAge;
+}
+
+void Adafruit_BMP085::updateB5(int32_t UT) {
+  B5 = computeB5(UT);
+  haveB5 = true;
+  b5Reads = 0;
+  b5Time = millis();
+}
+
+void Adafruit_BMP085::startMeasurement(void) {
+  // skip the temperature conversion while the cached B5 is fresh enough
+  if (temperatureStale()) {
+    write8(BMP085_CONTROL, BMP085_READTEMPCMD);
+    state = BMP085_TEMPERATURE;
+  } else {
+    write8(BMP085_CONTROL, BMP085_READPRESSURECMD + (oversampling << 6));
+    state = BMP085_PRESSURE;
+  }
+  started = millis();
+}
+
+// true once the conversion started at started has had wait ms, or with
+// BMP085_EOC_POLL, once the sensor clears its Sco bit
+boolean Adafruit_BMP085::conversionDone(uint8_t wait) {
+  unsigned long elapsed = millis() - started;
+
+#if BMP085_EOC_POLL
+  // give up on the bit after twice the conversion time
+  if (elapsed <= 2 * wait)
+    return !(read8(BMP085_CONTROL) & 0x20);
+  return true;
+#else
+  // millis() may tick just after the start, so wait one ms more
+  return elapsed > wait;
+#endif
+}
+
+boolean Adafruit_BMP085::measure(void) {
+  if (state == BMP085_TEMPERATURE) {
+    if (!conversionDone(5)) return false;
+
+    updateB5(read16(BMP085_TEMPDATA));
+    write8(BMP085_CONTROL, BMP085_READPRESSURECMD + (oversampling << 6));
+    started = millis();
+    state = BMP085_PRESSURE;
+    return false;
+  }
+
+  if (state == BMP085_PRESSURE) {
+    if (!conversionDone(pressureWait())) return false;
+
+    lastUP = readPressureData();
+    lastB5 = B5;
+    b5Reads++;
+    state = BMP085_DONE;
+  }
+
+  return state == BMP085_DONE;
+}
+
+float Adafruit_BMP085::measuredTemperature(void) {
+  return ((lastB5 + 8) >> 4) / 10.0;
+}
+
+int32_t Adafruit_BMP085::measuredPressure(void) {
+  return computePressure(lastB5, lastUP);
+}
+
+uint32_t Adafruit_BMP085::measuredRawPressure(void) {
+  return lastUP;
+}
+
+int32_t Adafruit_BMP085::measuredB5(void) {
+  return lastB5;
+}
+
+void Adafruit_BMP085::computePressures(const int32_t *B5, const int32_t *UP, int32_t *pressure, uint8_t n) {
+  for (uint8_t i = 0; i < n; i++)
+    pressure[i] = computePressure(B5[i], UP[i]);
+}
+
 float Adafruit_BMP085::readAltitude(float sealevelPressure) {
   float altitude;
 
@@ -234,54 +369,49 @@ float Adafruit_BMP085::readAltitude(float sealevelPressure) {
 
 /*********************************************************************/
 
+// raw pressure of the finished conversion, MSB, LSB and XLSB in one burst
+uint32_t Adafruit_BMP085::readPressureData(void) {
+  uint8_t data[3];
+  readBytes(BMP085_PRESSUREDATA, data, 3);
+
+  uint32_t raw = ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | data[2];
+  return raw >> (8 - oversampling);
+}
+
 uint8_t Adafruit_BMP085::read8(uint8_t a) {
   uint8_t ret;
 
-  Wire.beginTransmission(BMP085_I2CADDR); // start transmission to device 
-#if (ARDUINO >= 100)
-  Wire.write(a); // sends register address to read from
-#else
-  Wire.send(a); // sends register address to read from
-#endif
-  Wire.endTransmission(); // end transmission
-  
-  Wire.beginTransmission(BMP085_I2CADDR); // start transmission to device 
-  Wire.requestFrom(BMP085_I2CADDR, 1);// send data n-bytes read
-#if (ARDUINO >= 100)
-  ret = Wire.read(); // receive DATA
-#else
-  ret = Wire.receive(); // receive DATA
-#endif
-  Wire.endTransmission(); // end transmission
-
+  readBytes(a, &ret, 1);
   return ret;
 }
 
 uint16_t Adafruit_BMP085::read16(uint8_t a) {
-  uint16_t ret;
+  uint8_t data[2];
+
+  readBytes(a, data, 2);
+  return (data[0] << 8) | data[1];
+}
 
+// read n consecutive registers from a: the register address is sent
+// followed by a repeated start, and the sensor then sends all n bytes
+void Adafruit_BMP085::readBytes(uint8_t a, uint8_t *buf, uint8_t n) {
   Wire.beginTransmission(BMP085_I2CADDR); // start transmission to device 
 #if (ARDUINO >= 100)
   Wire.write(a); // sends register address to read from
+  Wire.endTransmission(false); // no stop, keep the bus
 #else
   Wire.send(a); // sends register address to read from
-#endif
   Wire.endTransmission(); // end transmission
-  
-  Wire.beginTransmission(BMP085_I2CADDR); // start transmission to device 
-  Wire.requestFrom(BMP085_I2CADDR, 2);// send data n-bytes read
+#endif
+
+  Wire.requestFrom((uint8_t)BMP085_I2CADDR, n);// send data n-bytes read
+  for (uint8_t i = 0; i < n; i++) {
 #if (ARDUINO >= 100)
-  ret = Wire.read(); // receive DATA
-  ret <<= 8;
-  ret |= Wire.read(); // receive DATA
+    buf[i] = Wire.read(); // receive DATA
 #else
-  ret = Wire.receive(); // receive DATA
-  ret <<= 8;
-  ret |= Wire.receive(); // receive DATA
+    buf[i] = Wire.receive(); // receive DATA
 #endif
-  Wire.endTransmission(); // end transmission
-
-  return ret;
+  }
 }
 
 void Adafruit_BMP085::write8(uint8_t a, uint8_t d) {
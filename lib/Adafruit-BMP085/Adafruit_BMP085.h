@@ -27,6 +27,29 @@
 
 #define BMP085_DEBUG 0
 
+// Set to 1 to have measure() poll the conversion running (Sco) bit of the
+// control register instead of waiting out the datasheet conversion time
+#ifndef BMP085_EOC_POLL
+#define BMP085_EOC_POLL 0
+#endif
+
+// The pressure compensation depends on temperature (B5), which changes far
+// more slowly than pressure is usually sampled, so readPressure() and
+// startMeasurement() reuse the last one and only convert temperature again
+// after BMP085_TEMP_READS pressure readings or BMP085_TEMP_MAX_AGE ms,
+// whichever comes first. With the datasheet calibration the pressure is
+// off by about 2 hPa per degree C the temperature has moved since then
+// (1.6 at 700 hPa, 2.2 at 1000 hPa); outdoors that is well under the
+// 0.2 hPa noise of the sensor at these defaults.
+// setTemperatureRefresh(1, 0) converts it every time again.
+#ifndef BMP085_TEMP_READS
+#define BMP085_TEMP_READS 10
+#endif
+
+#ifndef BMP085_TEMP_MAX_AGE
+#define BMP085_TEMP_MAX_AGE 10000
+#endif
+
 #define BMP085_I2CADDR 0x77
 
 #define BMP085_ULTRALOWPOWER 0
@@ -58,19 +81,72 @@ class Adafruit_BMP085 {
   boolean begin(uint8_t mode = BMP085_ULTRAHIGHRES);  // by default go highres
   float readTemperature(void);
   int32_t readPressure(void);
-  int32_t readSealevelPressure(float altitude_meters = 0);
+  int32_t readSealevelPressure(void); // at the setAltitude() altitude
+  int32_t readSealevelPressure(float altitude_meters);
   float readAltitude(float sealevelPressure = 101325); // std atmosphere
   uint16_t readRawTemperature(void);
   uint32_t readRawPressure(void);
+
+  // Non-blocking reading. startMeasurement() starts a temperature
+  // conversion, or a pressure one while the cached temperature is fresh,
+  // and returns. Each measure() call checks the conversion in progress:
+  // when the temperature is done it starts the pressure conversion, and
+  // when that is done it keeps the raw result and returns true. Call it
+  // every few ms until then; it never waits.
+  void startMeasurement(void);
+  boolean measure(void);
+  float measuredTemperature(void);
+  int32_t measuredPressure(void);
+
+  // The raw result of the last measure(), to store and compensate later:
+  // the raw pressure and the temperature compensation (B5) it goes with.
+  // computePressures() compensates n of them at once, into Pa.
+  uint32_t measuredRawPressure(void);
+  int32_t measuredB5(void);
+  void computePressures(const int32_t *B5, const int32_t *UP, int32_t *pressure, uint8_t n);
+
+  // Sea level pressure. The correction only depends on the altitude, so
+  // setAltitude() works it out once, as a Q24 factor, and
+  // sealevelPressure(pressure) is then a single multiply, rounded to the
+  // nearest Pa; the static version does a pow() on every call.
+  void setAltitude(float altitude_meters);
+  int32_t sealevelPressure(int32_t pressure);
+  static int32_t sealevelPressure(int32_t pressure, float altitude_meters);
+
+  // convert temperature again after reads pressure readings or maxAge ms
+  void setTemperatureRefresh(uint8_t reads, unsigned long maxAge);
   
  private:
   int32_t computeB5(int32_t UT);
+  int32_t computePressure(int32_t B5, int32_t UP);
+  boolean temperatureStale(void);
+  void updateB5(int32_t UT);
+  boolean conversionDone(uint8_t wait);
+  uint8_t pressureWait(void);
   uint8_t read8(uint8_t addr);
   uint16_t read16(uint8_t addr);
+  void readBytes(uint8_t addr, uint8_t *buf, uint8_t n);
+  uint32_t readPressureData(void);
   void write8(uint8_t addr, uint8_t data);
 
   uint8_t oversampling;
 
+  // sea level correction for altitude, in Q24
+  float altitude;
+  uint32_t seaLevelFactor;
+
+  uint8_t state;
+  unsigned long started;
+  // raw result of the last measure()
+  uint32_t lastUP;
+  int32_t lastB5;
+
+  // cached temperature compensation, see BMP085_TEMP_READS
+  int32_t B5;
+  boolean haveB5;
+  uint8_t b5Reads, refreshReads;
+  unsigned long b5Time, refreshAge;
+
   int16_t ac1, ac2, ac3, b1, b2, mb, mc, md;
   uint16_t ac4, ac5, ac6;
 };
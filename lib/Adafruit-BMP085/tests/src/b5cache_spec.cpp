@@ -0,0 +1,144 @@
+#include "Adafruit_BMP085.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+// datasheet example: 15.0 C and 69964 Pa at BMP085_ULTRALOWPOWER
+#define DATASHEET_UT 27898
+#define DATASHEET_UP 23843
+
+void setup(Adafruit_BMP085& bmp) {
+    Wire.loadDatasheetCalibration();
+    Wire.ut = DATASHEET_UT;
+    Wire.up = DATASHEET_UP;
+    bmp.begin(BMP085_ULTRALOWPOWER);
+    Wire.temperatureConversions = 0;
+    Wire.pressureConversions = 0;
+}
+
+// step a non-blocking measurement to completion, 1 ms at a time
+int32_t measure(Adafruit_BMP085& bmp) {
+    bmp.startMeasurement();
+    while (!bmp.measure()) {
+        advance(1);
+    }
+    return bmp.measuredPressure();
+}
+
+
+int test_b5cache_datasheet() {
+    IT("reads the datasheet example pressure and temperature");
+    Adafruit_BMP085 bmp;
+    setup(bmp);
+
+    IS_TRUE(bmp.readPressure() == 69964);
+    IS_TRUE(bmp.readTemperature() == 15.0f);
+
+    END_IT
+}
+
+int test_b5cache_reads() {
+    IT("converts temperature once per BMP085_TEMP_READS pressure readings");
+    Adafruit_BMP085 bmp;
+    setup(bmp);
+
+    for (int i = 0; i < 3 * BMP085_TEMP_READS; i++) {
+        bmp.readPressure();
+    }
+    IS_TRUE(Wire.pressureConversions == 3 * BMP085_TEMP_READS);
+    IS_TRUE(Wire.temperatureConversions == 3);
+
+    END_IT
+}
+
+int test_b5cache_age() {
+    IT("converts temperature again once the cached one is BMP085_TEMP_MAX_AGE old");
+    Adafruit_BMP085 bmp;
+    setup(bmp);
+
+    bmp.readPressure();
+    advance(BMP085_TEMP_MAX_AGE - 100);
+    bmp.readPressure();
+    IS_TRUE(Wire.temperatureConversions == 1);
+
+    advance(100);
+    bmp.readPressure();
+    IS_TRUE(Wire.temperatureConversions == 2);
+
+    END_IT
+}
+
+int test_b5cache_non_blocking() {
+    IT("shares the cache with startMeasurement() and measure()");
+    Adafruit_BMP085 bmp;
+    setup(bmp);
+
+    for (int i = 0; i < BMP085_TEMP_READS + 1; i++) {
+        IS_TRUE(measure(bmp) == 69964);
+    }
+    IS_TRUE(Wire.pressureConversions == BMP085_TEMP_READS + 1);
+    IS_TRUE(Wire.temperatureConversions == 2);
+
+    END_IT
+}
+
+int test_b5cache_refresh_every_time() {
+    IT("converts temperature on every reading after setTemperatureRefresh(1, 0)");
+    Adafruit_BMP085 bmp;
+    setup(bmp);
+    bmp.setTemperatureRefresh(1, 0);
+
+    for (int i = 0; i < 5; i++) {
+        bmp.readPressure();
+        measure(bmp);
+    }
+    IS_TRUE(Wire.temperatureConversions == 10);
+
+    END_IT
+}
+
+// pressure error per degree C of a cache that missed a warming of the
+// sensor, at the raw pressure up
+float staleError(uint32_t up) {
+    Adafruit_BMP085 bmp;
+    setup(bmp);
+    Wire.up = up;
+
+    // cache 15.0 C, then warm the sensor by a degree or so
+    float before = bmp.readTemperature();
+    Wire.ut = DATASHEET_UT + 160;
+    int32_t stale = bmp.readPressure();
+    float after = bmp.readTemperature();
+    int32_t fresh = bmp.readPressure();
+    Wire.ut = DATASHEET_UT;
+
+    TRACE(fresh << " Pa: " << (fresh - stale) / (after - before) << " Pa/C\n");
+    if (Wire.temperatureConversions != 2 || after - before < 0.5f) {
+        return 0;
+    }
+    return (fresh - stale) / (after - before);
+}
+
+int test_b5cache_stale_error() {
+    IT("is off by about 2 hPa per degree C of stale temperature");
+
+    // about 700 and 1000 hPa
+    float low = staleError(DATASHEET_UP);
+    float high = staleError(DATASHEET_UP + 10000);
+    IS_TRUE(low > 140 && low < 180);
+    IS_TRUE(high > 200 && high < 250);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("BMP085 temperature compensation cache");
+    test_b5cache_datasheet();
+    test_b5cache_reads();
+    test_b5cache_age();
+    test_b5cache_non_blocking();
+    test_b5cache_refresh_every_time();
+    test_b5cache_stale_error();
+
+    FINISH
+}
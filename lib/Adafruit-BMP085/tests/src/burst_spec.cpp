@@ -0,0 +1,103 @@
+#include "Adafruit_BMP085.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+void setup(Adafruit_BMP085& bmp) {
+    Wire.loadDatasheetCalibration();
+    Wire.ut = 27898;
+    Wire.up = 23843;
+    bmp.begin(BMP085_ULTRALOWPOWER);
+    Wire.resetTraffic();
+}
+
+
+int test_burst_begin() {
+    IT("reads the chip id and then the whole calibration block in one burst");
+    Adafruit_BMP085 bmp;
+    Wire.loadDatasheetCalibration();
+    Wire.resetTraffic();
+
+    IS_TRUE(bmp.begin(BMP085_ULTRALOWPOWER));
+    IS_TRUE(Wire.requests == 2);
+    IS_TRUE(Wire.lastRequest == 22);
+    IS_TRUE(Wire.repeatedStarts == 2);
+    IS_TRUE(Wire.requestsAfterStop == 0);
+    IS_TRUE(Wire.stops == 0);
+
+    END_IT
+}
+
+int test_burst_pressure() {
+    IT("reads the three pressure bytes in one request after a repeated start");
+    Adafruit_BMP085 bmp;
+    setup(bmp);
+
+    IS_TRUE(bmp.readRawPressure() == 23843);
+    // the conversion command, then the result
+    IS_TRUE(Wire.stops == 1);
+    IS_TRUE(Wire.repeatedStarts == 1);
+    IS_TRUE(Wire.requests == 1);
+    IS_TRUE(Wire.lastRequest == 3);
+    IS_TRUE(Wire.requestsAfterStop == 0);
+
+    END_IT
+}
+
+int test_burst_temperature() {
+    IT("reads the two temperature bytes in one request after a repeated start");
+    Adafruit_BMP085 bmp;
+    setup(bmp);
+
+    IS_TRUE(bmp.readRawTemperature() == 27898);
+    IS_TRUE(Wire.stops == 1);
+    IS_TRUE(Wire.repeatedStarts == 1);
+    IS_TRUE(Wire.requests == 1);
+    IS_TRUE(Wire.lastRequest == 2);
+    IS_TRUE(Wire.requestsAfterStop == 0);
+
+    END_IT
+}
+
+int test_burst_reading() {
+    IT("makes one request per register read of a full reading");
+    Adafruit_BMP085 bmp;
+    setup(bmp);
+    bmp.setTemperatureRefresh(1, 0);
+
+    // a temperature and a pressure conversion, and their results
+    IS_TRUE(bmp.readPressure() == 69964);
+    IS_TRUE(Wire.stops == 2);
+    IS_TRUE(Wire.requests == 2);
+    IS_TRUE(Wire.repeatedStarts == Wire.requests);
+    IS_TRUE(Wire.requestsAfterStop == 0);
+
+    END_IT
+}
+
+int test_burst_measure() {
+    IT("polls and reads a non-blocking measurement with repeated starts only");
+    Adafruit_BMP085 bmp;
+    setup(bmp);
+
+    bmp.startMeasurement();
+    while (!bmp.measure()) {
+        advance(1);
+    }
+    IS_TRUE(bmp.measuredPressure() == 69964);
+    IS_TRUE(Wire.repeatedStarts == Wire.requests);
+    IS_TRUE(Wire.requestsAfterStop == 0);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("BMP085 burst reads");
+    test_burst_begin();
+    test_burst_pressure();
+    test_burst_temperature();
+    test_burst_reading();
+    test_burst_measure();
+
+    FINISH
+}
@@ -0,0 +1,15 @@
+#include "Arduino.h"
+
+static unsigned long now = 0;
+
+unsigned long millis(void) {
+    return now;
+}
+
+void delay(unsigned long ms) {
+    now += ms;
+}
+
+void advance(unsigned long ms) {
+    now += ms;
+}
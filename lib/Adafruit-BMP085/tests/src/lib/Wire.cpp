@@ -0,0 +1,87 @@
+#include "Wire.h"
+#include <string.h>
+
+FakeBMP085 Wire;
+
+FakeBMP085::FakeBMP085() : ut(0), up(0), temperatureConversions(0), pressureConversions(0), reg(0), written(0), pending(0) {
+    memset(registers, 0, sizeof(registers));
+    registers[0xD0] = 0x55;
+    resetTraffic();
+}
+
+void FakeBMP085::resetTraffic() {
+    stops = 0;
+    repeatedStarts = 0;
+    requests = 0;
+    requestsAfterStop = 0;
+    lastRequest = 0;
+    repeatedStart = false;
+}
+
+void FakeBMP085::loadDatasheetCalibration() {
+    const int16_t cal[11] = { 408, -72, -14383, (int16_t)32741, (int16_t)32757, 23153, 6190, 4, -32768, -8711, 2868 };
+    for (int i = 0; i < 11; i++) {
+        registers[0xAA + 2 * i] = (uint16_t)cal[i] >> 8;
+        registers[0xAB + 2 * i] = cal[i] & 0xFF;
+    }
+}
+
+void FakeBMP085::beginTransmission(uint8_t address) {
+    written = 0;
+}
+
+size_t FakeBMP085::write(uint8_t data) {
+    if (written++ == 0) {
+        reg = data;
+        return 1;
+    }
+
+    registers[reg] = data;
+    if (reg == 0xF4 && data == 0x2E) {
+        temperatureConversions++;
+        registers[0xF6] = ut >> 8;
+        registers[0xF7] = ut & 0xFF;
+    }
+    else if (reg == 0xF4 && (data & 0x3F) == 0x34) {
+        pressureConversions++;
+        uint32_t shifted = up << (8 - (data >> 6));
+        registers[0xF6] = shifted >> 16;
+        registers[0xF7] = (shifted >> 8) & 0xFF;
+        registers[0xF8] = shifted & 0xFF;
+    }
+    reg++;
+    return 1;
+}
+
+uint8_t FakeBMP085::endTransmission(bool stop) {
+    if (stop) {
+        stops++;
+    } else {
+        repeatedStarts++;
+    }
+    repeatedStart = !stop;
+    return 0;
+}
+
+uint8_t FakeBMP085::requestFrom(uint8_t address, uint8_t quantity) {
+    requests++;
+    if (!repeatedStart) {
+        requestsAfterStop++;
+    }
+    repeatedStart = false;
+    lastRequest = quantity;
+    pending = quantity;
+    return quantity;
+}
+
+int FakeBMP085::available() {
+    return pending;
+}
+
+int FakeBMP085::read() {
+    if (pending == 0) {
+        return -1;
+    }
+    pending--;
+    return registers[reg++];
+}
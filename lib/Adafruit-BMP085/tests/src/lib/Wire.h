@@ -0,0 +1,55 @@
+#ifndef Wire_h
+#define Wire_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+// A BMP085 on the bus: a register file, with a conversion command written
+// to the control register loading the result registers at once
+class FakeBMP085 {
+public:
+    FakeBMP085();
+
+    // calibration registers from the datasheet example
+    void loadDatasheetCalibration();
+
+    // raw values the next conversions return
+    uint16_t ut;
+    uint32_t up;
+
+    // conversions started
+    int temperatureConversions;
+    int pressureConversions;
+
+    // bus traffic: write transactions ended with a stop or with a repeated
+    // start, read requests, requests that did not follow a repeated start,
+    // and the size of the last request
+    int stops;
+    int repeatedStarts;
+    int requests;
+    int requestsAfterStop;
+    uint8_t lastRequest;
+
+    // zero the traffic counters
+    void resetTraffic();
+
+    void begin() {}
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t data);
+    uint8_t endTransmission(bool stop = true);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity);
+    int available();
+    int read();
+
+    uint8_t registers[256];
+
+private:
+    uint8_t reg;
+    int written;
+    int pending;
+    bool repeatedStart;
+};
+
+extern FakeBMP085 Wire;
+
+#endif // Wire_h
@@ -0,0 +1,98 @@
+#include "Adafruit_BMP085.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+// sea level pressure in double
+double exact(int32_t pressure, double altitude) {
+    return pressure / pow(1.0 - altitude / 44330, 5.255);
+}
+
+
+int test_sealevel_precomputed() {
+    IT("keeps sealevelPressure() within 1 Pa of the exact correction");
+    Adafruit_BMP085 bmp;
+    double worst = 0;
+
+    for (float altitude = -400; altitude <= 3000; altitude += 13.7f) {
+        bmp.setAltitude(altitude);
+        for (int32_t p = 30000; p <= 110000; p += 7) {
+            double error = fabs(bmp.sealevelPressure(p) - exact(p, altitude));
+            if (error > worst) {
+                worst = error;
+            }
+        }
+    }
+    TRACE(worst << " Pa ");
+    IS_TRUE(worst < 1.0);
+
+    END_IT
+}
+
+int test_sealevel_static() {
+    IT("agrees with the static pow() version to 1 Pa");
+    Adafruit_BMP085 bmp;
+    bmp.setAltitude(241.2f);
+
+    for (int32_t p = 30000; p <= 110000; p += 101) {
+        int32_t d = bmp.sealevelPressure(p) - Adafruit_BMP085::sealevelPressure(p, 241.2f);
+        IS_TRUE(d >= -1 && d <= 1);
+    }
+
+    END_IT
+}
+
+int test_sealevel_default() {
+    IT("leaves the pressure as it is before setAltitude()");
+    Adafruit_BMP085 bmp;
+
+    IS_TRUE(bmp.sealevelPressure(97000) == 97000);
+    bmp.setAltitude(0);
+    IS_TRUE(bmp.sealevelPressure(101325) == 101325);
+
+    END_IT
+}
+
+int test_sealevel_change() {
+    IT("follows a change of altitude at run time");
+    Adafruit_BMP085 bmp;
+
+    bmp.setAltitude(241.2f);
+    int32_t high = bmp.sealevelPressure(97000);
+    bmp.setAltitude(0);
+    IS_TRUE(bmp.sealevelPressure(97000) == 97000);
+    bmp.setAltitude(241.2f);
+    IS_TRUE(bmp.sealevelPressure(97000) == high);
+    IS_TRUE(high > 97000);
+
+    END_IT
+}
+
+int test_sealevel_read() {
+    IT("corrects readSealevelPressure() for the altitude given");
+    Adafruit_BMP085 bmp;
+    Wire.loadDatasheetCalibration();
+    Wire.ut = 27898;
+    Wire.up = 23843;
+    bmp.begin(BMP085_ULTRALOWPOWER);
+
+    int32_t at = bmp.readPressure();
+    int32_t corrected = bmp.readSealevelPressure(1000.0f);
+    IS_TRUE(fabs(corrected - exact(at, 1000.0)) < 1.0);
+
+    // the altitude is kept for the next readings
+    IS_TRUE(bmp.readSealevelPressure() == corrected);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("BMP085 sea level pressure");
+    test_sealevel_precomputed();
+    test_sealevel_static();
+    test_sealevel_default();
+    test_sealevel_change();
+    test_sealevel_read();
+
+    FINISH
+}
@@ -32,6 +32,7 @@
 Adafruit_Si7021::Adafruit_Si7021(void) {
   _i2caddr = SI7021_DEFAULT_ADDRESS;
   sernum_a = sernum_b = 0;
+  _measuring = _haveHumidity = false;
 }
 
 bool Adafruit_Si7021::begin(void) {
@@ -58,7 +59,7 @@ float Adafruit_Si7021::readHumidity(void) {
   uint16_t hum = Wire.read();
   hum <<= 8;
   hum |= Wire.read();
-  uint8_t chxsum = Wire.read();
+  Wire.read();  // checksum
 
   float humidity = hum;
   humidity *= 125;
@@ -78,7 +79,7 @@ float Adafruit_Si7021::readTemperature(void) {
   uint16_t temp = Wire.read();
   temp <<= 8;
   temp |= Wire.read();
-  uint8_t chxsum = Wire.read();
+  Wire.read();  // checksum
 
   float temperature = temp;
   temperature *= 175.72;
@@ -88,6 +89,105 @@ float Adafruit_Si7021::readTemperature(void) {
   return temperature;
 }
 
+bool Adafruit_Si7021::startMeasurement(void) {
+  _haveHumidity = false;
+
+  Wire.beginTransmission(_i2caddr);
+  Wire.write((uint8_t)SI7021_MEASRH_NOHOLD_CMD);
+  _measuring = (Wire.endTransmission() == 0);
+
+  return _measuring;
+}
+
+bool Adafruit_Si7021::measurementReady(void) {
+  if (_haveHumidity) return true;
+  if (!_measuring) return false;
+
+  // the sensor NACKs its address until the conversion is done
+  if (Wire.requestFrom(_i2caddr, 3) < 3) {
+    while (Wire.available()) Wire.read();
+    return false;
+  }
+
+  _rawHumidity = Wire.read();
+  _rawHumidity <<= 8;
+  _rawHumidity |= Wire.read();
+  Wire.read();  // checksum
+
+  _measuring = false;
+  _haveHumidity = true;
+  return true;
+}
+
+bool Adafruit_Si7021::readMeasurement(float *humidity, float *temperature) {
+  uint16_t hum, temp;
+  if (!readMeasurementCodes(&hum, &temp)) return false;
+
+  float rh = hum;
+  rh *= 125;
+  rh /= 65536;
+  rh -= 6;
+  *humidity = rh;
+
+  float t = temp;
+  t *= 175.72;
+  t /= 65536;
+  t -= 46.85;
+  *temperature = t;
+
+  return true;
+}
+
+bool Adafruit_Si7021::readMeasurement(int16_t *humidity, int16_t *temperature) {
+  uint16_t hum, temp;
+  if (!readMeasurementCodes(&hum, &temp)) return false;
+
+  *humidity = humidityFromCode(hum);
+  *temperature = temperatureFromCode(temp);
+
+  return true;
+}
+
+// RH = 125 * code / 65536 - 6, in 0.01 %RH
+int16_t Adafruit_Si7021::humidityFromCode(uint16_t code) {
+  return (int16_t)((((uint32_t)code * 12500 + 32768) >> 16) - 600);
+}
+
+// T = 175.72 * code / 65536 - 46.85, in 0.01 deg C
+int16_t Adafruit_Si7021::temperatureFromCode(uint16_t code) {
+  return (int16_t)((((uint32_t)code * 17572 + 32768) >> 16) - 4685);
+}
+
+void Adafruit_Si7021::humidityFromCodes(const uint16_t *codes, int16_t *humidity, uint8_t n) {
+  for (uint8_t i = 0; i < n; i++)
+    humidity[i] = humidityFromCode(codes[i]);
+}
+
+void Adafruit_Si7021::temperatureFromCodes(const uint16_t *codes, int16_t *temperature, uint8_t n) {
+  for (uint8_t i = 0; i < n; i++)
+    temperature[i] = temperatureFromCode(codes[i]);
+}
+
+bool Adafruit_Si7021::readMeasurementCodes(uint16_t *humidity, uint16_t *temperature) {
+  if (!measurementReady()) return false;
+  _haveHumidity = false;
+
+  *humidity = _rawHumidity;
+
+  // the temperature measured for the humidity compensation, no conversion needed
+  Wire.beginTransmission(_i2caddr);
+  Wire.write((uint8_t)SI7021_READPREVTEMP_CMD);
+  Wire.endTransmission(false);
+
+  if (Wire.requestFrom(_i2caddr, 2) < 2) return false;
+  uint16_t temp = Wire.read();
+  temp <<= 8;
+  temp |= Wire.read();
+  *temperature = temp;
+
+  return true;
+}
+
 void Adafruit_Si7021::reset(void) {
   Wire.beginTransmission(_i2caddr);
   Wire.write((uint8_t)SI7021_RESET_CMD);
@@ -99,7 +199,7 @@ void Adafruit_Si7021::readSerialNumber(void) {
   Wire.beginTransmission(_i2caddr);
   Wire.write((uint8_t)SI7021_ID1_CMD>>8);
   Wire.write((uint8_t)SI7021_ID1_CMD&0xFF);
-  Wire.endTransmission();
+  Wire.endTransmission(false);
 
   Wire.requestFrom(_i2caddr, 8);
   sernum_a = Wire.read();
@@ -117,7 +217,7 @@ void Adafruit_Si7021::readSerialNumber(void) {
   Wire.beginTransmission(_i2caddr);
   Wire.write((uint8_t)SI7021_ID2_CMD>>8);
   Wire.write((uint8_t)SI7021_ID2_CMD&0xFF);
-  Wire.endTransmission();
+  Wire.endTransmission(false);
 
   Wire.requestFrom(_i2caddr, 8);
   sernum_b = Wire.read();
@@ -161,7 +261,7 @@ uint16_t Adafruit_Si7021::readRegister16(uint8_t reg) {
   uint16_t value;
   Wire.beginTransmission(_i2caddr);
   Wire.write((uint8_t)reg);
-  Wire.endTransmission();
+  Wire.endTransmission(false);
 
   Wire.requestFrom(_i2caddr, 2);
   value = Wire.read();
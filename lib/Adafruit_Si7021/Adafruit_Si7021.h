@@ -58,6 +58,29 @@ class Adafruit_Si7021 {
   void readSerialNumber(void);
   float readHumidity(void);
 
+  // Non-blocking measurement. startMeasurement() starts a humidity
+  // conversion, which measures the temperature as well, and returns at
+  // once. measurementReady() polls the sensor, which NACKs until the
+  // conversion is done (up to about 23 ms). readMeasurement() then fetches
+  // the humidity and the temperature of the same conversion.
+  bool startMeasurement(void);
+  bool measurementReady(void);
+  bool readMeasurement(float *humidity, float *temperature);
+
+  // Same, as integers in 0.01 %RH and 0.01 deg C, without any float math
+  bool readMeasurement(int16_t *humidity, int16_t *temperature);
+
+  // Same, as the raw sensor codes, to convert later
+  bool readMeasurementCodes(uint16_t *humidity, uint16_t *temperature);
+
+  // Raw sensor codes to 0.01 %RH and 0.01 deg C, rounded to nearest; the
+  // array versions convert n codes in one loop, which host compilers
+  // vectorize (see make vectorize in tests/); the ESP8266 has no SIMD
+  static int16_t humidityFromCode(uint16_t code);
+  static int16_t temperatureFromCode(uint16_t code);
+  static void humidityFromCodes(const uint16_t *codes, int16_t *humidity, uint8_t n);
+  static void temperatureFromCodes(const uint16_t *codes, int16_t *temperature, uint8_t n);
+
   uint32_t sernum_a, sernum_b;
 
  private:
@@ -67,6 +90,9 @@ class Adafruit_Si7021 {
   void writeRegister8(uint8_t reg, uint8_t value);
 
   int8_t  _i2caddr;
+
+  bool _measuring, _haveHumidity;
+  uint16_t _rawHumidity;
 };
 
 /**************************************************************************/
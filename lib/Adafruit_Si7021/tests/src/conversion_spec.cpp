@@ -0,0 +1,85 @@
+#include "Adafruit_Si7021.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+// datasheet formulas, in hundredths
+double humidityExact(uint16_t code) {
+    return (125.0 * code / 65536 - 6) * 100;
+}
+
+double temperatureExact(uint16_t code) {
+    return (175.72 * code / 65536 - 46.85) * 100;
+}
+
+
+int test_conversion_humidity() {
+    IT("converts every humidity code to 0.01 %RH rounded to nearest from the float formula");
+    double worst = 0;
+
+    for (uint32_t code = 0; code <= 0xFFFF; code++) {
+        double error = fabs(Adafruit_Si7021::humidityFromCode(code) - humidityExact(code));
+        if (error > worst) {
+            worst = error;
+        }
+    }
+    TRACE(worst << " LSB ");
+    IS_TRUE(worst < 0.501);
+
+    END_IT
+}
+
+int test_conversion_temperature() {
+    IT("converts every temperature code to 0.01 deg C rounded to nearest from the float formula");
+    double worst = 0;
+
+    for (uint32_t code = 0; code <= 0xFFFF; code++) {
+        double error = fabs(Adafruit_Si7021::temperatureFromCode(code) - temperatureExact(code));
+        if (error > worst) {
+            worst = error;
+        }
+    }
+    TRACE(worst << " LSB ");
+    IS_TRUE(worst < 0.501);
+
+    END_IT
+}
+
+int test_conversion_known() {
+    IT("converts known codes to their datasheet values");
+
+    IS_TRUE(Adafruit_Si7021::humidityFromCode(0) == -600);
+    IS_TRUE(Adafruit_Si7021::humidityFromCode(0x7C80) == 5479);
+    IS_TRUE(Adafruit_Si7021::temperatureFromCode(0) == -4685);
+    IS_TRUE(Adafruit_Si7021::temperatureFromCode(0x6666) == 2344);
+
+    END_IT
+}
+
+int test_conversion_batch() {
+    IT("converts a batch of codes the same as one at a time");
+    uint16_t codes[64];
+    int16_t humidity[64], temperature[64];
+
+    for (int i = 0; i < 64; i++) {
+        codes[i] = i * 1021;
+    }
+    Adafruit_Si7021::humidityFromCodes(codes, humidity, 64);
+    Adafruit_Si7021::temperatureFromCodes(codes, temperature, 64);
+    for (int i = 0; i < 64; i++) {
+        IS_TRUE(humidity[i] == Adafruit_Si7021::humidityFromCode(codes[i]));
+        IS_TRUE(temperature[i] == Adafruit_Si7021::temperatureFromCode(codes[i]));
+    }
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("Si7021 conversions");
+    test_conversion_humidity();
+    test_conversion_temperature();
+    test_conversion_known();
+    test_conversion_batch();
+
+    FINISH
+}
@@ -0,0 +1,96 @@
+#include "Wire.h"
+#include "Arduino.h"
+
+FakeSi7021 Wire;
+
+FakeSi7021::FakeSi7021() : humidity(0), temperature(0), conversionTime(23), present(true),
+    humidityConversions(0), temperatureConversions(0), nacks(0),
+    command(0), written(0), outLength(0), outPos(0),
+    converting(false), doneAt(0), result(0), previousTemperature(0) {
+}
+
+void FakeSi7021::beginTransmission(uint8_t address) {
+    written = 0;
+}
+
+size_t FakeSi7021::write(uint8_t data) {
+    if (written++ == 0) {
+        command = data;
+    }
+    return 1;
+}
+
+uint8_t FakeSi7021::endTransmission(bool stop) {
+    if (!present) {
+        return 2;
+    }
+
+    outLength = 0;
+    outPos = 0;
+    if (command == 0xF5) {
+        humidityConversions++;
+        converting = true;
+        doneAt = millis() + conversionTime;
+        result = humidity;
+        previousTemperature = temperature;
+    }
+    else if (command == 0xF3) {
+        temperatureConversions++;
+        converting = true;
+        doneAt = millis() + conversionTime;
+        result = temperature;
+    }
+    else if (command == 0xE0) {
+        out[0] = previousTemperature >> 8;
+        out[1] = previousTemperature & 0xFF;
+        outLength = 2;
+    }
+    else if (command == 0xE7) {
+        out[0] = 0x3A;
+        outLength = 1;
+    }
+    else {
+        // serial number and firmware reads: zeros
+        for (int i = 0; i < 8; i++) {
+            out[i] = 0;
+        }
+        outLength = 8;
+    }
+    return 0;
+}
+
+uint8_t FakeSi7021::requestFrom(uint8_t address, uint8_t quantity) {
+    if (!present) {
+        return 0;
+    }
+
+    if (converting) {
+        if (millis() < doneAt) {
+            nacks++;
+            return 0;
+        }
+        converting = false;
+        out[0] = result >> 8;
+        out[1] = result & 0xFF;
+        out[2] = 0;
+        outLength = 3;
+        outPos = 0;
+    }
+
+    if (quantity > outLength - outPos) {
+        quantity = outLength - outPos;
+    }
+    outLength = outPos + quantity;
+    return quantity;
+}
+
+int FakeSi7021::available() {
+    return outLength - outPos;
+}
+
+int FakeSi7021::read() {
+    if (outPos >= outLength) {
+        return -1;
+    }
+    return out[outPos++];
+}
@@ -0,0 +1,56 @@
+#ifndef Wire_h
+#define Wire_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+// An Si7021 on the bus. A no-hold humidity or temperature command starts a
+// conversion that takes conversionTime ms of the virtual clock; until then
+// the sensor NACKs a read of its result. 0xE0 reads the temperature
+// measured with the last humidity conversion, and 0xE7 the user register.
+class FakeSi7021 {
+public:
+    FakeSi7021();
+
+    // codes the next conversions return
+    uint16_t humidity;
+    uint16_t temperature;
+    unsigned long conversionTime;
+
+    // false to NACK everything, as if no sensor were connected
+    bool present;
+
+    // conversions started, and reads NACKed while one was running
+    int humidityConversions;
+    int temperatureConversions;
+    int nacks;
+
+    void begin() {}
+    void begin(int, int) {}
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t data);
+    uint8_t endTransmission(bool stop = true);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity);
+    int available();
+    int read();
+
+private:
+    // the command written, and the results it gives
+    uint8_t command;
+    int written;
+    uint8_t out[8];
+    int outLength;
+    int outPos;
+
+    // the conversion in progress, if any, and when it is done
+    bool converting;
+    unsigned long doneAt;
+    uint16_t result;
+
+    // temperature measured with the last humidity conversion
+    uint16_t previousTemperature;
+};
+
+extern FakeSi7021 Wire;
+
+#endif // Wire_h
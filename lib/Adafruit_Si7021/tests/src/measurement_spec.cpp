@@ -0,0 +1,156 @@
+#include "Adafruit_Si7021.h"
+#include "Wire.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+// 54.79 %RH and 23.44 deg C
+#define HUMIDITY_CODE    0x7C80
+#define TEMPERATURE_CODE 0x6666
+
+void setup(Adafruit_Si7021& sensor) {
+    Wire.present = true;
+    Wire.humidity = HUMIDITY_CODE;
+    Wire.temperature = TEMPERATURE_CODE;
+    sensor.begin();
+    Wire.humidityConversions = 0;
+    Wire.temperatureConversions = 0;
+    Wire.nacks = 0;
+}
+
+
+int test_measurement_begin() {
+    IT("finds the sensor by its user register");
+    Adafruit_Si7021 sensor;
+
+    Wire.present = true;
+    IS_TRUE(sensor.begin());
+    Wire.present = false;
+    IS_FALSE(sensor.begin());
+
+    END_IT
+}
+
+int test_measurement_poll() {
+    IT("polls a started conversion until the sensor stops NACKing");
+    Adafruit_Si7021 sensor;
+    setup(sensor);
+
+    IS_FALSE(sensor.measurementReady());
+    IS_TRUE(sensor.startMeasurement());
+    IS_TRUE(Wire.humidityConversions == 1);
+
+    for (unsigned long t = 0; t < Wire.conversionTime; t++) {
+        IS_FALSE(sensor.measurementReady());
+        advance(1);
+    }
+    IS_TRUE(Wire.nacks == (int)Wire.conversionTime);
+    IS_TRUE(sensor.measurementReady());
+
+    // and stays ready, without another read, until it is fetched
+    IS_TRUE(sensor.measurementReady());
+    IS_TRUE(Wire.nacks == (int)Wire.conversionTime);
+
+    END_IT
+}
+
+int test_measurement_codes() {
+    IT("fetches the humidity and the temperature of the same conversion");
+    Adafruit_Si7021 sensor;
+    setup(sensor);
+    uint16_t humidity, temperature;
+
+    sensor.startMeasurement();
+    // a later temperature is not what was measured with this humidity
+    Wire.temperature = 0x7000;
+    advance(Wire.conversionTime);
+    IS_TRUE(sensor.readMeasurementCodes(&humidity, &temperature));
+    IS_TRUE(humidity == HUMIDITY_CODE);
+    IS_TRUE(temperature == TEMPERATURE_CODE);
+
+    // read with 0xE0, without a temperature conversion of its own
+    IS_TRUE(Wire.humidityConversions == 1);
+    IS_TRUE(Wire.temperatureConversions == 0);
+
+    // a reading is only fetched once
+    IS_FALSE(sensor.readMeasurementCodes(&humidity, &temperature));
+
+    END_IT
+}
+
+int test_measurement_integers() {
+    IT("converts a fetched measurement to 0.01 %RH and 0.01 deg C");
+    Adafruit_Si7021 sensor;
+    setup(sensor);
+    int16_t humidity, temperature;
+
+    sensor.startMeasurement();
+    IS_FALSE(sensor.readMeasurement(&humidity, &temperature));
+    advance(Wire.conversionTime);
+    IS_TRUE(sensor.readMeasurement(&humidity, &temperature));
+    IS_TRUE(humidity == 5479);
+    IS_TRUE(temperature == 2344);
+
+    END_IT
+}
+
+int test_measurement_restart() {
+    IT("drops a reading not fetched when a new conversion starts");
+    Adafruit_Si7021 sensor;
+    setup(sensor);
+    uint16_t humidity, temperature;
+
+    sensor.startMeasurement();
+    advance(Wire.conversionTime);
+    IS_TRUE(sensor.measurementReady());
+
+    Wire.humidity = 0x8000;
+    sensor.startMeasurement();
+    IS_FALSE(sensor.measurementReady());
+    advance(Wire.conversionTime);
+    IS_TRUE(sensor.readMeasurementCodes(&humidity, &temperature));
+    IS_TRUE(humidity == 0x8000);
+
+    END_IT
+}
+
+int test_measurement_absent() {
+    IT("never reports a measurement when the sensor does not answer");
+    Adafruit_Si7021 sensor;
+    setup(sensor);
+    uint16_t humidity, temperature;
+
+    Wire.present = false;
+    IS_FALSE(sensor.startMeasurement());
+    advance(Wire.conversionTime);
+    IS_FALSE(sensor.measurementReady());
+    IS_FALSE(sensor.readMeasurementCodes(&humidity, &temperature));
+
+    END_IT
+}
+
+int test_measurement_blocking() {
+    IT("still reads humidity and temperature with a conversion each, blocking");
+    Adafruit_Si7021 sensor;
+    setup(sensor);
+
+    IS_TRUE(fabs(sensor.readHumidity() - 54.79) < 0.01);
+    IS_TRUE(fabs(sensor.readTemperature() - 23.44) < 0.01);
+    IS_TRUE(Wire.humidityConversions == 1);
+    IS_TRUE(Wire.temperatureConversions == 1);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("Si7021 measurement");
+    test_measurement_begin();
+    test_measurement_poll();
+    test_measurement_codes();
+    test_measurement_integers();
+    test_measurement_restart();
+    test_measurement_absent();
+    test_measurement_blocking();
+
+    FINISH
+}
@@ -0,0 +1,248 @@
+/*
+ * DerivedMetrics.cpp
+ *
+ * DerivedMetrics - quantities computed from the raw sensor readings, such
+ * as the dew point, in implementations of different cost and accuracy.
+ */
+
+
+#include "DerivedMetrics.h"
+
+// ln(1 + i/32) in Q16
+static const uint16_t LN_TABLE[33] = {
+    0, 2017, 3973, 5873, 7719, 9515, 11262, 12965, 14624, 16242, 17821,
+    19364, 20870, 22343, 23783, 25193, 26573, 27924, 29248, 30546, 31818,
+    33067, 34292, 35494, 36675, 37835, 38975, 40095, 41196, 42280, 43345,
+    44394, 45426
+};
+
+#define LN2_Q16 45426
+
+// Magnus coefficients: a = 17.62 in Q16, b = 243.12 deg C in hundredths
+#define MAGNUS_A_Q16    1154744
+#define MAGNUS_B        24312
+
+
+int16_t dewPoint(int16_t celsius, int16_t humidity) {
+#if DERIVEDMETRICS_DEW_POINT == DEW_POINT_NOAA
+    float td = dewPointNoaa(celsius / 100.0, humidity / 100.0);
+    return (int16_t)(td * 100 + (td < 0 ? -0.5 : 0.5));
+#elif DERIVEDMETRICS_DEW_POINT == DEW_POINT_MAGNUS
+    float td = dewPointMagnus(celsius / 100.0, humidity / 100.0);
+    return (int16_t)(td * 100 + (td < 0 ? -0.5 : 0.5));
+#else
+    return dewPointFixed(celsius, humidity);
+#endif
+}
+
+
+// reference (1) : http://wahiduddin.net/calc/density_algorithms.htm
+// reference (2) : http://www.colorado.edu/geography/weather_station/Geog_site/about.htm
+float dewPointNoaa(float celsius, float humidity) {
+    // (1) Saturation Vapor Pressure = ESGG(T)
+    float RATIO = 373.15 / (273.15 + celsius);
+    float RHS = -7.90298 * (RATIO - 1);
+    RHS += 5.02808 * log10(RATIO);
+    RHS += -1.3816e-7 * (pow(10, (11.344 * (1 - 1/RATIO ))) - 1) ;
+    RHS += 8.1328e-3 * (pow(10, (-3.49149 * (RATIO - 1))) - 1) ;
+    RHS += log10(1013.246);
+
+    // factor -3 is to adjust units - Vapor Pressure SVP * humidity
+    float VP = pow(10, RHS - 3) * humidity;
+
+    // (2) DEWPOINT = F(Vapor Pressure)
+    float T = log(VP/0.61078);   // temp var
+    return (241.88 * T) / (17.558 - T);
+}
+
+
+float dewPointMagnus(float celsius, float humidity) {
+    float gamma = log(humidity / 100) + 17.62 * celsius / (243.12 + celsius);
+    return 243.12 * gamma / (17.62 - gamma);
+}
+
+
+int16_t dewPointFixed(int16_t celsius, int16_t humidity) {
+    if (humidity < 1) {
+        humidity = 1;
+    }
+
+    // gamma = ln(RH / 100%) + a * T / (b + T), in Q16; ln(65536 / 10000)
+    // turns lnQ16() of the humidity into ln(RH / 100%)
+    int32_t gamma = lnQ16(humidity) + 123208;
+    gamma += (int32_t)((int64_t)1762 * 65536 * celsius / (100 * (MAGNUS_B + (int32_t)celsius)));
+
+    // Td = b * gamma / (a - gamma), rounded
+    int64_t num = (int64_t)MAGNUS_B * gamma;
+    int64_t den = MAGNUS_A_Q16 - gamma;
+    return (int16_t)((num + (num < 0 ? -den / 2 : den / 2)) / den);
+}
+
+
+int32_t lnQ16(uint32_t x) {
+    if (x == 0) {
+        return INT32_MIN;
+    }
+
+    int32_t result = 0;
+    while (x >= 0x20000) {
+        x >>= 1;
+        result += LN2_Q16;
+    }
+    while (x < 0x10000) {
+        x <<= 1;
+        result -= LN2_Q16;
+    }
+
+    // x is now 1.f in Q16; interpolate ln(1.f) in the table
+    uint32_t f = x - 0x10000;
+    uint8_t i = f >> 11;
+    uint32_t r = f & 0x7FF;
+    return result + LN_TABLE[i] + (((uint32_t)(LN_TABLE[i + 1] - LN_TABLE[i]) * r) >> 11);
+}
+
+
+int16_t heatIndex(int16_t celsius, int16_t humidity) {
+    float T = celsius * 0.018 + 32;
+    float RH = humidity / 100.0;
+
+    // the simple formula, good below 80 F
+    float HI = 0.5 * (T + 61.0 + (T - 68.0) * 1.2 + RH * 0.094);
+
+    if ((HI + T) / 2 >= 80) {
+        // Rothfusz regression, with the NWS adjustments for dry and humid air
+        HI = -42.379 + 2.04901523 * T + 10.14333127 * RH
+            - 0.22475541 * T * RH - 0.00683783 * T * T
+            - 0.05481717 * RH * RH + 0.00122874 * T * T * RH
+            + 0.00085282 * T * RH * RH - 0.00000199 * T * T * RH * RH;
+
+        if (RH < 13 && T >= 80 && T <= 112) {
+            HI -= ((13 - RH) / 4) * sqrt((17 - fabs(T - 95)) / 17);
+        }
+        else if (RH > 85 && T >= 80 && T <= 87) {
+            HI += ((RH - 85) / 10) * ((87 - T) / 5);
+        }
+    }
+
+    float hi = (HI - 32) / 0.018;
+    return (int16_t)(hi + (hi < 0 ? -0.5 : 0.5));
+}
+
+
+int16_t humidex(int16_t celsius, int16_t dewPoint) {
+    // vapor pressure in hPa from the dew point
+    float e = 6.11 * exp(5417.7530 * (1 / 273.16 - 1 / (273.15 + dewPoint / 100.0)));
+    float h = celsius + 55.55 * (e - 10);
+    return (int16_t)(h + (h < 0 ? -0.5 : 0.5));
+}
+
+
+int16_t absoluteHumidity(int16_t celsius, int16_t humidity) {
+    float T = celsius / 100.0;
+
+    // vapor pressure in hPa (Magnus), and the gas law for water vapor
+    float e = 6.112 * exp(17.67 * T / (T + 243.5)) * humidity / 10000;
+    float ah = 216.74 * e / (273.15 + T);
+    return (int16_t)(ah * 100 + 0.5);
+}
+
+
+int16_t windChill(int16_t celsius, int16_t wind) {
+    if (celsius > 1000 || wind < 480) {
+        return celsius;
+    }
+
+    float T = celsius / 100.0;
+    float v = pow(wind / 100.0, 0.16);
+    float wc = 13.12 + 0.6215 * T - 11.37 * v + 0.3965 * T * v;
+    return (int16_t)(wc * 100 + (wc < 0 ? -0.5 : 0.5));
+}
+
+
+DerivedMetrics::DerivedMetrics() {
+    for (int i = 0; i < METRIC_INPUTS; i++) {
+        inputs[i] = 0;
+        thresholds[i] = 0;
+    }
+    for (int i = 0; i < METRICS; i++) {
+        results[i] = 0;
+    }
+
+    // the sketch publishes hundredths, so any change of temperature or
+    // humidity shows; the wind, which it does not report, within 0.5 km/h
+    thresholds[METRIC_INPUT_TEMPERATURE] = 1;
+    thresholds[METRIC_INPUT_HUMIDITY] = 1;
+    thresholds[METRIC_INPUT_WIND] = 50;
+
+    known = 0;
+    stale = 0;
+}
+
+
+void DerivedMetrics::setThreshold(uint8_t input, int32_t threshold) {
+    if (input >= METRIC_INPUTS) {
+        return;
+    }
+
+    thresholds[input] = threshold;
+}
+
+
+boolean DerivedMetrics::changed(uint8_t input, int32_t value) {
+    uint8_t bit = METRIC_INPUT_MASK(input);
+    int32_t delta = value - inputs[input];
+
+    if ((known & bit) && delta < thresholds[input] && -delta < thresholds[input]) {
+        return false;
+    }
+
+    inputs[input] = value;
+    known |= bit;
+    return true;
+}
+
+
+boolean DerivedMetrics::available(uint8_t metric) {
+    if (metric >= METRICS) {
+        return false;
+    }
+
+    return (known & inputsOf(metric)) == inputsOf(metric);
+}
+
+
+int32_t DerivedMetrics::value(uint8_t metric) {
+    if (!available(metric)) {
+        return 0;
+    }
+
+    uint8_t bit = (uint8_t)1 << metric;
+    if (stale & bit) {
+        results[metric] = compute(metric);
+        stale &= ~bit;
+    }
+
+    return results[metric];
+}
+
+
+int32_t DerivedMetrics::compute(uint8_t metric) {
+    int16_t celsius = inputs[METRIC_INPUT_TEMPERATURE];
+    int16_t humidity = inputs[METRIC_INPUT_HUMIDITY];
+
+    switch (metric) {
+    case METRIC_DEW_POINT:
+        return dewPoint(celsius, humidity);
+    case METRIC_HEAT_INDEX:
+        return heatIndex(celsius, humidity);
+    case METRIC_HUMIDEX:
+        // from the memoized dew point, which has the same inputs
+        return humidex(celsius, value(METRIC_DEW_POINT));
+    case METRIC_ABSOLUTE_HUMIDITY:
+        return absoluteHumidity(celsius, humidity);
+    case METRIC_WIND_CHILL:
+        return windChill(celsius, inputs[METRIC_INPUT_WIND]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * DerivedMetrics.h
+ *
+ * DerivedMetrics - quantities computed from the raw sensor readings, such
+ * as the dew point, in implementations of different cost and accuracy.
+ *
+ * Temperatures and humidities are passed the way the sketch carries them,
+ * as integers in hundredths (0.01 deg C, 0.01 %RH). dewPoint() uses the
+ * implementation DERIVEDMETRICS_DEW_POINT selects; the others stay
+ * available for comparison:
+ *
+ *   DEW_POINT_NOAA   NOAA saturation vapor pressure series, in float;
+ *                    three pow(), two log10() and a log() per call
+ *   DEW_POINT_MAGNUS Magnus formula (a = 17.62, b = 243.12 deg C), in
+ *                    float; one log() per call
+ *   DEW_POINT_FIXED  Magnus formula in integers, with ln() from a shift
+ *                    loop and a 33-entry interpolated table
+ *
+ * Worst error of the result in hundredths against NOAA computed in
+ * double, for -40..60 deg C and 1..100 %RH, and host time per call
+ * relative to DEW_POINT_NOAA (x86-64 with an FPU, so the float variants
+ * look cheaper there than they are on an ESP8266, which emulates float in
+ * software), as tests/src/dewpoint_bench.cpp measures them:
+ *
+ *   DEW_POINT_NOAA   0.005 deg C     1
+ *   DEW_POINT_MAGNUS 0.17 deg C      0.13
+ *   DEW_POINT_FIXED  0.17 deg C      0.09
+ *
+ * DEW_POINT_FIXED stays within 0.01 deg C of DEW_POINT_MAGNUS, the rest
+ * of its error is the formula's. The Si7021 is only accurate to 3 %RH,
+ * so the fixed version is the default.
+ *
+ * The class DerivedMetrics serves the derived quantities to a sketch that
+ * reports several of them. The sketch sets the inputs as new samples come
+ * in; a metric is only computed again when it is read after one of its
+ * own inputs moved by the input's threshold or more, and otherwise
+ * returns the value computed before. By default any change of the
+ * temperature or humidity counts, since the sketch publishes hundredths. Which inputs each metric depends on
+ * is fixed at compile time, so setting an input only marks the metrics
+ * that use it and costs the same however many metrics there are.
+ */
+
+
+#ifndef DERIVEDMETRICS_H
+#define DERIVEDMETRICS_H
+
+#include <Arduino.h>
+
+#define DEW_POINT_NOAA      0
+#define DEW_POINT_MAGNUS    1
+#define DEW_POINT_FIXED     2
+
+// DERIVEDMETRICS_DEW_POINT : implementation dewPoint() uses
+#ifndef DERIVEDMETRICS_DEW_POINT
+#define DERIVEDMETRICS_DEW_POINT DEW_POINT_FIXED
+#endif
+
+// dew point in 0.01 deg C, from celsius and humidity in hundredths
+int16_t dewPoint(int16_t celsius, int16_t humidity);
+
+// dew point in deg C, NOAA reference
+float dewPointNoaa(float celsius, float humidity);
+
+// dew point in deg C, Magnus formula
+float dewPointMagnus(float celsius, float humidity);
+
+// dew point in 0.01 deg C, Magnus formula in fixed point
+int16_t dewPointFixed(int16_t celsius, int16_t humidity);
+
+// ln(x / 65536) in Q16, for x > 0
+int32_t lnQ16(uint32_t x);
+
+// heat index (NWS), in 0.01 deg C, from celsius and humidity in hundredths
+int16_t heatIndex(int16_t celsius, int16_t humidity);
+
+// humidex (Environment Canada), in hundredths, from celsius and the dew
+// point in 0.01 deg C
+int16_t humidex(int16_t celsius, int16_t dewPoint);
+
+// water vapor in the air, in 0.01 g/m3, from celsius and humidity in
+// hundredths
+int16_t absoluteHumidity(int16_t celsius, int16_t humidity);
+
+// wind chill (NWS / Environment Canada), in 0.01 deg C, from celsius and
+// the wind speed in 0.01 km/h; the temperature itself above 10 deg C or
+// below 4.8 km/h, where the formula does not apply
+int16_t windChill(int16_t celsius, int16_t wind);
+
+// Inputs of DerivedMetrics
+#define METRIC_INPUT_TEMPERATURE    0   // 0.01 deg C
+#define METRIC_INPUT_HUMIDITY       1   // 0.01 %RH
+#define METRIC_INPUT_WIND           2   // 0.01 km/h
+#define METRIC_INPUTS               3
+
+// Metrics of DerivedMetrics
+#define METRIC_DEW_POINT            0   // 0.01 deg C
+#define METRIC_HEAT_INDEX           1   // 0.01 deg C
+#define METRIC_HUMIDEX              2   // 0.01
+#define METRIC_ABSOLUTE_HUMIDITY    3   // 0.01 g/m3
+#define METRIC_WIND_CHILL           4   // 0.01 deg C
+#define METRICS                     5
+
+#define METRIC_INPUT_MASK(input) ((uint8_t)1 << (input))
+
+class DerivedMetrics {
+
+public:
+    // inputs each metric is computed from
+    static constexpr uint8_t inputsOf(uint8_t metric) {
+        return metric == METRIC_DEW_POINT ? METRIC_INPUT_MASK(METRIC_INPUT_TEMPERATURE) | METRIC_INPUT_MASK(METRIC_INPUT_HUMIDITY)
+             : metric == METRIC_HEAT_INDEX ? METRIC_INPUT_MASK(METRIC_INPUT_TEMPERATURE) | METRIC_INPUT_MASK(METRIC_INPUT_HUMIDITY)
+             : metric == METRIC_HUMIDEX ? METRIC_INPUT_MASK(METRIC_INPUT_TEMPERATURE) | METRIC_INPUT_MASK(METRIC_INPUT_HUMIDITY)
+             : metric == METRIC_ABSOLUTE_HUMIDITY ? METRIC_INPUT_MASK(METRIC_INPUT_TEMPERATURE) | METRIC_INPUT_MASK(METRIC_INPUT_HUMIDITY)
+             : metric == METRIC_WIND_CHILL ? METRIC_INPUT_MASK(METRIC_INPUT_TEMPERATURE) | METRIC_INPUT_MASK(METRIC_INPUT_WIND)
+             : 0;
+    }
+
+    // metrics computed from an input, one bit per metric
+    static constexpr uint8_t usersOf(uint8_t input, uint8_t metric = 0) {
+        return metric == METRICS ? 0
+             : (((inputsOf(metric) >> input) & 1) << metric) | usersOf(input, metric + 1);
+    }
+
+    // constructor
+    DerivedMetrics();
+
+    // recompute the metrics using input only once it moves by threshold
+    // or more from the value they were last computed with
+    void setThreshold(uint8_t input, int32_t threshold);
+
+    // new sample of INPUT; the metrics that depend on it are known at
+    // compile time
+    template<uint8_t INPUT>
+    void setInput(int32_t value) {
+        static_assert(INPUT < METRIC_INPUTS, "unknown DerivedMetrics input");
+        if (changed(INPUT, value)) {
+            stale |= usersOf(INPUT);
+        }
+    }
+
+    // returns true once all inputs of metric have been set
+    boolean available(uint8_t metric);
+
+    // current value of metric, computed again only if an input it
+    // depends on has changed; 0 if it is not available
+    int32_t value(uint8_t metric);
+
+private:
+    // store value for input and return true if it moved by the threshold
+    boolean changed(uint8_t input, int32_t value);
+
+    int32_t compute(uint8_t metric);
+
+    int32_t inputs[METRIC_INPUTS];
+    int32_t thresholds[METRIC_INPUTS];
+
+    // inputs set at least once
+    uint8_t known;
+
+    int32_t results[METRICS];
+
+    // metrics whose result is out of date, one bit per metric
+    uint8_t stale;
+};
+
+#endif
@@ -0,0 +1,84 @@
+// Measures the worst error and the host cost of each dew point
+// implementation, for the table in DerivedMetrics.h: the error against
+// the NOAA formula evaluated in double, over -40..60 deg C and 1..100 %RH,
+// and the time per call relative to DEW_POINT_NOAA.
+#include "DerivedMetrics.h"
+#include "trace.h"
+#include <ctime>
+
+#define T_MIN   -4000
+#define T_MAX   6000
+#define T_STEP  7
+#define RH_MIN  100
+#define RH_MAX  10000
+#define RH_STEP 13
+
+// dewPointNoaa() in double, in deg C
+static double noaa(double celsius, double humidity) {
+    double RATIO = 373.15 / (273.15 + celsius);
+    double RHS = -7.90298 * (RATIO - 1);
+    RHS += 5.02808 * log10(RATIO);
+    RHS += -1.3816e-7 * (pow(10, (11.344 * (1 - 1/RATIO ))) - 1) ;
+    RHS += 8.1328e-3 * (pow(10, (-3.49149 * (RATIO - 1))) - 1) ;
+    RHS += log10(1013.246);
+    double VP = pow(10, RHS - 3) * humidity;
+    double T = log(VP/0.61078);
+    return (241.88 * T) / (17.558 - T);
+}
+
+static int16_t noaaCenti(int16_t celsius, int16_t humidity) {
+    float td = dewPointNoaa(celsius / 100.0, humidity / 100.0);
+    return (int16_t)(td * 100 + (td < 0 ? -0.5 : 0.5));
+}
+
+static int16_t magnusCenti(int16_t celsius, int16_t humidity) {
+    float td = dewPointMagnus(celsius / 100.0, humidity / 100.0);
+    return (int16_t)(td * 100 + (td < 0 ? -0.5 : 0.5));
+}
+
+static volatile int32_t sink;
+
+// worst error in deg C over the sweep
+static double worstError(int16_t (*f)(int16_t, int16_t)) {
+    double worst = 0;
+    for (int16_t c = T_MIN; c <= T_MAX; c += T_STEP) {
+        for (int16_t h = RH_MIN; h <= RH_MAX; h += RH_STEP) {
+            double error = fabs(f(c, h) / 100.0 - noaa(c / 100.0, h / 100.0));
+            if (error > worst) {
+                worst = error;
+            }
+        }
+    }
+    return worst;
+}
+
+// ns per call over the sweep
+static double timePerCall(int16_t (*f)(int16_t, int16_t)) {
+    long calls = 0;
+    int32_t sum = 0;
+    clock_t start = clock();
+    for (int16_t c = T_MIN; c <= T_MAX; c += T_STEP) {
+        for (int16_t h = RH_MIN; h <= RH_MAX; h += RH_STEP) {
+            sum += f(c, h);
+            calls++;
+        }
+    }
+    sink = sum;
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / calls;
+}
+
+static void report(const char* name, int16_t (*f)(int16_t, int16_t), double reference) {
+    double ns = timePerCall(f);
+    LOG(name << worstError(f) << " deg C   " << ns / reference << " (" << ns << " ns/call)\n");
+}
+
+int main()
+{
+    double reference = timePerCall(noaaCenti);
+
+    report("DEW_POINT_NOAA   ", noaaCenti, reference);
+    report("DEW_POINT_MAGNUS ", magnusCenti, reference);
+    report("DEW_POINT_FIXED  ", dewPointFixed, reference);
+
+    return 0;
+}
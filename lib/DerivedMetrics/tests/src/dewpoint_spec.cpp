@@ -0,0 +1,88 @@
+#include "DerivedMetrics.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+// Magnus formula in double, in 0.01 deg C
+double magnus(int16_t celsius, int16_t humidity) {
+    double T = celsius / 100.0;
+    double gamma = log(humidity / 10000.0) + 17.62 * T / (243.12 + T);
+    return 243.12 * gamma / (17.62 - gamma) * 100;
+}
+
+
+int test_dewpoint_fixed() {
+    IT("keeps dewPointFixed() within 1 LSB of the Magnus formula in double");
+    double worst = 0;
+
+    // -40..60 deg C by 0.07, 1..100 %RH by 0.13
+    for (int16_t c = -4000; c <= 6000; c += 7) {
+        for (int16_t h = 100; h <= 10000; h += 13) {
+            double error = fabs(dewPointFixed(c, h) - magnus(c, h));
+            if (error > worst) {
+                worst = error;
+            }
+        }
+    }
+    TRACE(worst << " LSB ");
+    IS_TRUE(worst <= 1.0);
+
+    END_IT
+}
+
+int test_dewpoint_saturated() {
+    IT("gives the air temperature at 100 %RH");
+
+    for (int16_t c = -4000; c <= 6000; c += 500) {
+        int16_t td = dewPointFixed(c, 10000);
+        IS_TRUE(td >= c - 1 && td <= c + 1);
+    }
+
+    END_IT
+}
+
+int test_dewpoint_dry() {
+    IT("clamps a humidity of 0 instead of failing");
+
+    IS_TRUE(dewPointFixed(2000, 0) == dewPointFixed(2000, 1));
+    IS_TRUE(dewPointFixed(2000, 0) < -5000);
+
+    END_IT
+}
+
+int test_dewpoint_default() {
+    IT("uses dewPointFixed() for dewPoint() by default");
+
+    IS_TRUE(dewPoint(2345, 6789) == dewPointFixed(2345, 6789));
+
+    END_IT
+}
+
+int test_dewpoint_ln() {
+    IT("computes lnQ16() to within 1.5e-4 of ln(), the 32-step interpolation error");
+    double worst = 0;
+
+    for (uint32_t x = 1; x < 0x1000000; x = x * 5 / 4 + 1) {
+        double error = fabs(lnQ16(x) / 65536.0 - log(x / 65536.0));
+        if (error > worst) {
+            worst = error;
+        }
+    }
+    TRACE(worst << " ");
+    IS_TRUE(worst < 1.5e-4);
+    IS_TRUE(lnQ16(65536) == 0);
+    IS_TRUE(lnQ16(0) == INT32_MIN);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("Dew point");
+    test_dewpoint_fixed();
+    test_dewpoint_saturated();
+    test_dewpoint_dry();
+    test_dewpoint_default();
+    test_dewpoint_ln();
+
+    FINISH
+}
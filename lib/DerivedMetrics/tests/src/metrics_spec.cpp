@@ -0,0 +1,203 @@
+#include "DerivedMetrics.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+// the formulas in double, in hundredths
+double heatIndexExact(double celsius, double humidity) {
+    double T = celsius * 1.8 + 32;
+    double RH = humidity;
+    double HI = 0.5 * (T + 61.0 + (T - 68.0) * 1.2 + RH * 0.094);
+    if ((HI + T) / 2 >= 80) {
+        HI = -42.379 + 2.04901523 * T + 10.14333127 * RH
+            - 0.22475541 * T * RH - 0.00683783 * T * T
+            - 0.05481717 * RH * RH + 0.00122874 * T * T * RH
+            + 0.00085282 * T * RH * RH - 0.00000199 * T * T * RH * RH;
+        if (RH < 13 && T >= 80 && T <= 112) {
+            HI -= ((13 - RH) / 4) * sqrt((17 - fabs(T - 95)) / 17);
+        }
+        else if (RH > 85 && T >= 80 && T <= 87) {
+            HI += ((RH - 85) / 10) * ((87 - T) / 5);
+        }
+    }
+    return (HI - 32) / 1.8 * 100;
+}
+
+double humidexExact(double celsius, double dewPoint) {
+    double e = 6.11 * exp(5417.7530 * (1 / 273.16 - 1 / (273.15 + dewPoint)));
+    return (celsius + 5.0 / 9 * (e - 10)) * 100;
+}
+
+double absoluteHumidityExact(double celsius, double humidity) {
+    double e = 6.112 * exp(17.67 * celsius / (celsius + 243.5)) * humidity / 100;
+    return 216.74 * e / (273.15 + celsius) * 100;
+}
+
+double windChillExact(double celsius, double wind) {
+    double v = pow(wind, 0.16);
+    return (13.12 + 0.6215 * celsius - 11.37 * v + 0.3965 * celsius * v) * 100;
+}
+
+// worst error in hundredths of f against exact over a sweep of both inputs
+double worstError(int16_t (*f)(int16_t, int16_t), double (*exact)(double, double),
+                  int16_t aMin, int16_t aMax, int16_t aStep, int16_t bMin, int16_t bMax, int16_t bStep) {
+    double worst = 0;
+    for (int16_t a = aMin; a <= aMax; a += aStep) {
+        for (int16_t b = bMin; b <= bMax; b += bStep) {
+            double error = fabs(f(a, b) - exact(a / 100.0, b / 100.0));
+            if (error > worst) {
+                worst = error;
+            }
+        }
+    }
+    return worst;
+}
+
+
+int test_metrics_heat_index() {
+    IT("computes the heat index to 1 LSB of the NWS formulas, and as the NWS chart gives it");
+
+    double worst = worstError(heatIndex, heatIndexExact, -2000, 5000, 7, 100, 10000, 13);
+    TRACE(worst << " LSB ");
+    IS_TRUE(worst < 1.0);
+
+    // 90 F at 70 %RH is 106 F on the NWS chart, 100 F at 50 %RH 118 F
+    IS_TRUE(abs(heatIndex(3222, 7000) - 4111) < 56);
+    IS_TRUE(abs(heatIndex(3778, 5000) - 4778) < 56);
+    // the simple formula for cool air stays within a couple of degrees of
+    // the temperature
+    IS_TRUE(abs(heatIndex(1500, 5000) - 1500) < 200);
+
+    END_IT
+}
+
+int test_metrics_humidex() {
+    IT("computes the humidex to 1 LSB of the Environment Canada formula");
+
+    double worst = worstError(humidex, humidexExact, -2000, 5000, 7, -4000, 3000, 11);
+    TRACE(worst << " LSB ");
+    IS_TRUE(worst < 1.0);
+
+    // 30 deg C with a 15 deg C dew point is a humidex of 34
+    IS_TRUE(abs(humidex(3000, 1500) - 3400) < 50);
+
+    END_IT
+}
+
+int test_metrics_absolute_humidity() {
+    IT("computes the absolute humidity to 1 LSB of the Magnus formula");
+
+    double worst = worstError(absoluteHumidity, absoluteHumidityExact, -4000, 6000, 7, 100, 10000, 13);
+    TRACE(worst << " LSB ");
+    IS_TRUE(worst < 1.0);
+
+    // 20 deg C at 50 %RH holds 8.6 g/m3
+    IS_TRUE(abs(absoluteHumidity(2000, 5000) - 865) < 5);
+    IS_TRUE(absoluteHumidity(2000, 0) == 0);
+
+    END_IT
+}
+
+int test_metrics_wind_chill() {
+    IT("computes the wind chill to 1 LSB, and the temperature where it does not apply");
+
+    double worst = worstError(windChill, windChillExact, -5000, 1000, 7, 480, 10000, 13);
+    TRACE(worst << " LSB ");
+    IS_TRUE(worst < 1.0);
+
+    // -10 deg C in a 30 km/h wind feels like -20 on the Environment
+    // Canada chart
+    IS_TRUE(abs(windChill(-1000, 3000) + 2000) < 50);
+
+    IS_TRUE(windChill(1001, 5000) == 1001);
+    IS_TRUE(windChill(-1000, 479) == -1000);
+
+    END_IT
+}
+
+int test_metrics_users() {
+    IT("marks only the metrics computed from an input");
+    const uint8_t all = (1 << METRICS) - 1;
+
+    IS_TRUE(DerivedMetrics::usersOf(METRIC_INPUT_TEMPERATURE) == all);
+    IS_TRUE(DerivedMetrics::usersOf(METRIC_INPUT_HUMIDITY) == (all & ~(1 << METRIC_WIND_CHILL)));
+    IS_TRUE(DerivedMetrics::usersOf(METRIC_INPUT_WIND) == (1 << METRIC_WIND_CHILL));
+
+    END_IT
+}
+
+int test_metrics_available() {
+    IT("gives a metric only once all of its inputs are set");
+    DerivedMetrics metrics;
+
+    IS_FALSE(metrics.available(METRIC_DEW_POINT));
+    IS_TRUE(metrics.value(METRIC_DEW_POINT) == 0);
+    metrics.setInput<METRIC_INPUT_TEMPERATURE>(2345);
+    IS_FALSE(metrics.available(METRIC_DEW_POINT));
+    metrics.setInput<METRIC_INPUT_HUMIDITY>(6789);
+    IS_TRUE(metrics.available(METRIC_DEW_POINT));
+    IS_FALSE(metrics.available(METRIC_WIND_CHILL));
+    IS_FALSE(metrics.available(METRICS));
+
+    IS_TRUE(metrics.value(METRIC_DEW_POINT) == dewPoint(2345, 6789));
+    IS_TRUE(metrics.value(METRIC_HEAT_INDEX) == heatIndex(2345, 6789));
+    IS_TRUE(metrics.value(METRIC_HUMIDEX) == humidex(2345, dewPoint(2345, 6789)));
+    IS_TRUE(metrics.value(METRIC_ABSOLUTE_HUMIDITY) == absoluteHumidity(2345, 6789));
+
+    metrics.setInput<METRIC_INPUT_WIND>(2000);
+    IS_TRUE(metrics.value(METRIC_WIND_CHILL) == windChill(2345, 2000));
+
+    END_IT
+}
+
+int test_metrics_memoized() {
+    IT("keeps a metric without computing it again while its inputs stay within the threshold");
+    DerivedMetrics metrics;
+    metrics.setThreshold(METRIC_INPUT_TEMPERATURE, 100);
+    metrics.setInput<METRIC_INPUT_TEMPERATURE>(2000);
+    metrics.setInput<METRIC_INPUT_HUMIDITY>(5000);
+    int16_t before = metrics.value(METRIC_DEW_POINT);
+    IS_TRUE(before == dewPoint(2000, 5000));
+
+    // computing it again would give another dew point
+    IS_TRUE(dewPoint(2099, 5000) != before);
+    metrics.setInput<METRIC_INPUT_TEMPERATURE>(2099);
+    IS_TRUE(metrics.value(METRIC_DEW_POINT) == before);
+    metrics.setInput<METRIC_INPUT_TEMPERATURE>(1901);
+    IS_TRUE(metrics.value(METRIC_DEW_POINT) == before);
+
+    // a slow drift counts from the value it was computed with
+    metrics.setInput<METRIC_INPUT_TEMPERATURE>(2100);
+    IS_TRUE(metrics.value(METRIC_DEW_POINT) == dewPoint(2100, 5000));
+
+    END_IT
+}
+
+int test_metrics_default_thresholds() {
+    IT("computes a metric again for any change of a hundredth the sketch publishes");
+    DerivedMetrics metrics;
+    metrics.setInput<METRIC_INPUT_TEMPERATURE>(2000);
+    metrics.setInput<METRIC_INPUT_HUMIDITY>(5000);
+    metrics.value(METRIC_DEW_POINT);
+
+    metrics.setInput<METRIC_INPUT_HUMIDITY>(5010);
+    IS_TRUE(metrics.value(METRIC_DEW_POINT) == dewPoint(2000, 5010));
+    metrics.setInput<METRIC_INPUT_TEMPERATURE>(2003);
+    IS_TRUE(metrics.value(METRIC_DEW_POINT) == dewPoint(2003, 5010));
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("Derived metrics");
+    test_metrics_heat_index();
+    test_metrics_humidex();
+    test_metrics_absolute_humidity();
+    test_metrics_wind_chill();
+    test_metrics_users();
+    test_metrics_available();
+    test_metrics_memoized();
+    test_metrics_default_thresholds();
+
+    FINISH
+}
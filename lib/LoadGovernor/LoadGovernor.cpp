@@ -0,0 +1,139 @@
+/*
+ * LoadGovernor.cpp
+ *
+ * LoadGovernor - decides how much optional work a sketch can afford.
+ */
+
+
+#include "LoadGovernor.h"
+
+
+LoadGovernor::LoadGovernor() {
+    for (int i = 0; i < LOADGOVERNOR_LEVELS; i++) {
+        latencyLimits[i] = 0;
+        heapLimits[i] = 0;
+    }
+
+    // defaults for an ESP8266 sketch: a slow pass or two is normal, a
+    // loop that stays slow or a heap that keeps shrinking is not
+    if (LOADGOVERNOR_LEVELS > 1) {
+        setThresholds(1, 100, 12000);
+    }
+    if (LOADGOVERNOR_LEVELS > 2) {
+        setThresholds(2, 400, 6000);
+    }
+
+    lastUpdate = millis();
+    smoothed = 0;
+    peak = 0;
+    isCalm = false;
+    calmSince = 0;
+    current = LOAD_NORMAL;
+    changes = 0;
+    callback = NULL;
+}
+
+
+void LoadGovernor::setThresholds(uint8_t level, unsigned long latency, uint32_t minHeap) {
+    if (level == LOAD_NORMAL || level >= LOADGOVERNOR_LEVELS) {
+        return;
+    }
+
+    latencyLimits[level] = latency;
+    heapLimits[level] = minHeap;
+}
+
+
+void LoadGovernor::onChange(governor_callback callback) {
+    this->callback = callback;
+}
+
+
+void LoadGovernor::update(uint32_t freeHeap) {
+    unsigned long now = millis();
+    unsigned long sample = now - lastUpdate;
+    lastUpdate = now;
+
+    if (sample > peak) {
+        peak = sample;
+    }
+
+    // exponential moving average over about 8 passes
+    smoothed = smoothed - smoothed / 8 + sample * 16 / 8;
+
+    uint8_t wanted = target(freeHeap);
+    if (wanted > current) {
+        isCalm = false;
+        change(wanted);
+        return;
+    }
+
+    if (current == LOAD_NORMAL || !calm(freeHeap)) {
+        isCalm = false;
+        return;
+    }
+
+    if (!isCalm) {
+        isCalm = true;
+        calmSince = now;
+    }
+    else if (now - calmSince >= LOADGOVERNOR_HOLD) {
+        isCalm = false;
+        change(current - 1);
+    }
+}
+
+
+uint8_t LoadGovernor::target(uint32_t freeHeap) {
+    uint8_t wanted = LOAD_NORMAL;
+
+    for (uint8_t i = 1; i < LOADGOVERNOR_LEVELS; i++) {
+        if ((latencyLimits[i] && latency() > latencyLimits[i]) || freeHeap < heapLimits[i]) {
+            wanted = i;
+        }
+    }
+
+    return wanted;
+}
+
+
+boolean LoadGovernor::calm(uint32_t freeHeap) {
+    if (latencyLimits[current] && latency() > latencyLimits[current] / 2) {
+        return false;
+    }
+
+    return freeHeap >= heapLimits[current] + LOADGOVERNOR_HEAP_MARGIN;
+}
+
+
+void LoadGovernor::change(uint8_t to) {
+    uint8_t from = current;
+
+    current = to;
+    changes++;
+    if (callback != NULL) {
+        callback(from, to);
+    }
+}
+
+
+uint8_t LoadGovernor::level() {
+    return current;
+}
+
+
+unsigned long LoadGovernor::latency() {
+    return smoothed / 16;
+}
+
+
+unsigned long LoadGovernor::peakLatency() {
+    unsigned long worst = peak;
+    peak = 0;
+    return worst;
+}
+
+
+unsigned long LoadGovernor::transitions() {
+    return changes;
+}
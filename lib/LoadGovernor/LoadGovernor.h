@@ -0,0 +1,101 @@
+/*
+ * LoadGovernor.h
+ *
+ * LoadGovernor - decides how much optional work a sketch can afford.
+ *
+ * update() is called on every pass of loop(), and from anywhere that
+ * waits for a long time, such as a network idle callback. The time
+ * between calls is the loop latency; together with the free heap it sets
+ * a load level from LOAD_NORMAL up to LOADGOVERNOR_LEVELS - 1. The sketch
+ * checks level() to skip or slow down its least important work, in
+ * whatever order it chooses.
+ *
+ * The level rises as soon as either input crosses a level's threshold. It
+ * falls one level at a time, and only after the latency has stayed under
+ * half the threshold and the heap LOADGOVERNOR_HEAP_MARGIN above it for
+ * LOADGOVERNOR_HOLD milliseconds, so it does not flap.
+ */
+
+
+#ifndef LOADGOVERNOR_H
+#define LOADGOVERNOR_H
+
+#include <Arduino.h>
+
+// LOADGOVERNOR_LEVELS : number of load levels, including LOAD_NORMAL
+#ifndef LOADGOVERNOR_LEVELS
+#define LOADGOVERNOR_LEVELS 3
+#endif
+
+// LOADGOVERNOR_HOLD : milliseconds of calm before the level falls
+#ifndef LOADGOVERNOR_HOLD
+#define LOADGOVERNOR_HOLD 10000
+#endif
+
+// LOADGOVERNOR_HEAP_MARGIN : bytes above a heap threshold needed to leave its level
+#ifndef LOADGOVERNOR_HEAP_MARGIN
+#define LOADGOVERNOR_HEAP_MARGIN 2048
+#endif
+
+#define LOAD_NORMAL 0
+
+typedef void (*governor_callback)(uint8_t from, uint8_t to);
+
+class LoadGovernor {
+
+public:
+    // constructor
+    LoadGovernor();
+
+    // enter level when the smoothed loop latency exceeds latency
+    // milliseconds or free heap drops below minHeap bytes
+    void setThresholds(uint8_t level, unsigned long latency, uint32_t minHeap);
+
+    // called with the old and new level on every change
+    void onChange(governor_callback callback);
+
+    // call once per pass of loop(), with the free heap in bytes
+    void update(uint32_t freeHeap);
+
+    // current load level
+    uint8_t level();
+
+    // smoothed loop latency, in milliseconds
+    unsigned long latency();
+
+    // worst single latency seen since the last call
+    unsigned long peakLatency();
+
+    // number of level changes since start
+    unsigned long transitions();
+
+private:
+    // level the inputs call for, ignoring hysteresis
+    uint8_t target(uint32_t freeHeap);
+
+    // returns true if level can be left for the one below
+    boolean calm(uint32_t freeHeap);
+
+    void change(uint8_t to);
+
+    unsigned long latencyLimits[LOADGOVERNOR_LEVELS];
+    uint32_t heapLimits[LOADGOVERNOR_LEVELS];
+
+    // value of millis() at the previous update()
+    unsigned long lastUpdate;
+
+    // smoothed latency, in 1/16 ms
+    unsigned long smoothed;
+
+    unsigned long peak;
+
+    // value of millis() since when the inputs allow a lower level
+    unsigned long calmSince;
+    boolean isCalm;
+
+    uint8_t current;
+    unsigned long changes;
+    governor_callback callback;
+};
+
+#endif
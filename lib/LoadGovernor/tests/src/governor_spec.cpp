@@ -0,0 +1,192 @@
+#include "LoadGovernor.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+#define HEAP_PLENTY 30000
+
+// levels passed to the change callback
+uint8_t lastFrom, lastTo;
+int changeCount;
+
+void changed(uint8_t from, uint8_t to) {
+    lastFrom = from;
+    lastTo = to;
+    changeCount++;
+}
+
+// passes of loop() ms apart for duration ms, with freeHeap free
+void run(LoadGovernor& governor, unsigned long ms, unsigned long duration, uint32_t freeHeap) {
+    for (unsigned long t = 0; t < duration; t += ms) {
+        advance(ms);
+        governor.update(freeHeap);
+    }
+}
+
+
+int test_governor_normal() {
+    IT("stays at LOAD_NORMAL with a fast loop and plenty of heap");
+    LoadGovernor governor;
+
+    run(governor, 10, 60000, HEAP_PLENTY);
+    IS_TRUE(governor.level() == LOAD_NORMAL);
+    IS_TRUE(governor.latency() == 10);
+    IS_TRUE(governor.transitions() == 0);
+
+    END_IT
+}
+
+int test_governor_heap_rise() {
+    IT("rises at once, skipping levels, when the heap drops below a threshold");
+    changeCount = 0;
+    LoadGovernor governor;
+    governor.onChange(changed);
+    run(governor, 10, 100, HEAP_PLENTY);
+
+    advance(10);
+    governor.update(11999);
+    IS_TRUE(governor.level() == 1);
+    IS_TRUE(changeCount == 1);
+    IS_TRUE(lastFrom == LOAD_NORMAL && lastTo == 1);
+
+    advance(10);
+    governor.update(12000);
+    IS_TRUE(governor.level() == 1);
+
+    LoadGovernor other;
+    other.onChange(changed);
+    advance(10);
+    other.update(5000);
+    IS_TRUE(other.level() == 2);
+    IS_TRUE(lastFrom == LOAD_NORMAL && lastTo == 2);
+    IS_TRUE(other.transitions() == 1);
+
+    END_IT
+}
+
+int test_governor_latency_rise() {
+    IT("rises on the smoothed latency, not a single slow pass");
+    LoadGovernor governor;
+    run(governor, 10, 1000, HEAP_PLENTY);
+
+    advance(500);
+    governor.update(HEAP_PLENTY);
+    IS_TRUE(governor.level() == LOAD_NORMAL);
+
+    run(governor, 200, 4000, HEAP_PLENTY);
+    IS_TRUE(governor.latency() > 100);
+    IS_TRUE(governor.level() == 1);
+
+    run(governor, 500, 10000, HEAP_PLENTY);
+    IS_TRUE(governor.level() == 2);
+
+    END_IT
+}
+
+int test_governor_fall() {
+    IT("falls one level at a time after LOADGOVERNOR_HOLD ms of calm");
+    changeCount = 0;
+    LoadGovernor governor;
+    governor.onChange(changed);
+    advance(10);
+    governor.update(5000);
+    IS_TRUE(governor.level() == 2);
+
+    run(governor, 10, LOADGOVERNOR_HOLD, HEAP_PLENTY);
+    IS_TRUE(governor.level() == 2);
+    run(governor, 10, 10, HEAP_PLENTY);
+    IS_TRUE(governor.level() == 1);
+    IS_TRUE(lastFrom == 2 && lastTo == 1);
+
+    run(governor, 10, LOADGOVERNOR_HOLD, HEAP_PLENTY);
+    IS_TRUE(governor.level() == 1);
+    run(governor, 10, 10, HEAP_PLENTY);
+    IS_TRUE(governor.level() == LOAD_NORMAL);
+    IS_TRUE(changeCount == 3);
+    IS_TRUE(governor.transitions() == 3);
+
+    END_IT
+}
+
+int test_governor_hysteresis() {
+    IT("stays at a level while the heap is within the margin above its threshold");
+    LoadGovernor governor;
+    advance(10);
+    governor.update(11000);
+    IS_TRUE(governor.level() == 1);
+
+    // above the threshold, which no longer calls for level 1, but not by
+    // LOADGOVERNOR_HEAP_MARGIN
+    run(governor, 10, 3 * LOADGOVERNOR_HOLD, 12000 + LOADGOVERNOR_HEAP_MARGIN - 1);
+    IS_TRUE(governor.level() == 1);
+
+    run(governor, 10, LOADGOVERNOR_HOLD + 10, 12000 + LOADGOVERNOR_HEAP_MARGIN);
+    IS_TRUE(governor.level() == LOAD_NORMAL);
+
+    END_IT
+}
+
+int test_governor_calm_restarts() {
+    IT("restarts the hold when the inputs stop being calm");
+    LoadGovernor governor;
+    advance(10);
+    governor.update(5000);
+
+    run(governor, 10, LOADGOVERNOR_HOLD - 100, HEAP_PLENTY);
+    advance(10);
+    governor.update(7000);
+    IS_TRUE(governor.level() == 2);
+
+    run(governor, 10, LOADGOVERNOR_HOLD - 100, HEAP_PLENTY);
+    IS_TRUE(governor.level() == 2);
+    run(governor, 10, 200, HEAP_PLENTY);
+    IS_TRUE(governor.level() == 1);
+
+    END_IT
+}
+
+int test_governor_peak() {
+    IT("reports the worst latency since the last call to peakLatency()");
+    LoadGovernor governor;
+    run(governor, 10, 100, HEAP_PLENTY);
+    advance(250);
+    governor.update(HEAP_PLENTY);
+    run(governor, 10, 100, HEAP_PLENTY);
+
+    IS_TRUE(governor.peakLatency() == 250);
+    IS_TRUE(governor.peakLatency() == 0);
+    advance(10);
+    governor.update(HEAP_PLENTY);
+    IS_TRUE(governor.peakLatency() == 10);
+
+    END_IT
+}
+
+int test_governor_thresholds() {
+    IT("uses the thresholds given, and ignores LOAD_NORMAL and levels out of range");
+    LoadGovernor governor;
+    governor.setThresholds(1, 20, 0);
+    governor.setThresholds(LOAD_NORMAL, 1, 100000);
+    governor.setThresholds(LOADGOVERNOR_LEVELS, 1, 100000);
+
+    run(governor, 10, 1000, HEAP_PLENTY);
+    IS_TRUE(governor.level() == LOAD_NORMAL);
+    run(governor, 30, 3000, HEAP_PLENTY);
+    IS_TRUE(governor.level() == 1);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("LoadGovernor");
+    test_governor_normal();
+    test_governor_heap_rise();
+    test_governor_latency_rise();
+    test_governor_fall();
+    test_governor_hysteresis();
+    test_governor_calm_restarts();
+    test_governor_peak();
+    test_governor_thresholds();
+
+    FINISH
+}
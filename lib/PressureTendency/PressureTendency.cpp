@@ -0,0 +1,149 @@
+/*
+ * PressureTendency.cpp
+ *
+ * PressureTendency - the barometric tendency (rising, falling or steady)
+ * and its rate, from the last three hours of pressure readings.
+ */
+
+
+#include "PressureTendency.h"
+
+
+PressureTendency::PressureTendency() {
+    clear();
+}
+
+
+void PressureTendency::clear() {
+    for (int i = 0; i < PRESSURETENDENCY_MINUTES; i++) {
+        offsets[i] = PRESSURETENDENCY_EMPTY;
+    }
+
+    base = 0;
+    count = 0;
+    sumX = 0;
+    sumXX = 0;
+    sumY = 0;
+    sumXY = 0;
+    minute = 0;
+    minuteStart = 0;
+    minuteSum = 0;
+    minuteReadings = 0;
+    newest = 0;
+}
+
+
+void PressureTendency::add(int32_t pressure, unsigned long time) {
+    if (minuteReadings == 0) {
+        minuteStart = time;
+    }
+    else if (time - minuteStart >= 60000) {
+        addMinute(minuteSum / minuteReadings);
+        // minutes without readings are skipped, not closed up
+        unsigned long elapsed = (time - minuteStart) / 60000;
+        minute += elapsed;
+        minuteStart += elapsed * 60000;
+        minuteSum = 0;
+        minuteReadings = 0;
+    }
+
+    minuteSum += pressure;
+    minuteReadings++;
+}
+
+
+void PressureTendency::addMinute(int32_t pressure) {
+    // the minutes since the newest one take the slots of those that fall
+    // out of the window
+    if (count > 0 && minute - newest >= PRESSURETENDENCY_MINUTES) {
+        // a gap as long as the window drops every minute
+        for (int i = 0; i < PRESSURETENDENCY_MINUTES; i++) {
+            offsets[i] = PRESSURETENDENCY_EMPTY;
+        }
+        count = 0;
+        sumX = 0;
+        sumXX = 0;
+        sumY = 0;
+        sumXY = 0;
+    }
+    else if (count > 0) {
+        for (unsigned long m = newest + 1; m <= minute; m++) {
+            dropMinute(m);
+        }
+    }
+
+    if (count == 0) {
+        base = pressure;
+    }
+
+    int32_t offset = pressure - base;
+    if (offset > 32767) {
+        offset = 32767;
+    }
+    else if (offset < -32767) {
+        offset = -32767;
+    }
+
+    offsets[minute % PRESSURETENDENCY_MINUTES] = offset;
+    int64_t x = minute;
+    sumX += x;
+    sumXX += x * x;
+    sumY += offset;
+    sumXY += x * offset;
+    count++;
+    newest = minute;
+}
+
+
+void PressureTendency::dropMinute(unsigned long m) {
+    int16_t& slot = offsets[m % PRESSURETENDENCY_MINUTES];
+    if (slot == PRESSURETENDENCY_EMPTY) {
+        return;
+    }
+
+    int64_t x = m - PRESSURETENDENCY_MINUTES;
+    sumX -= x;
+    sumXX -= x * x;
+    sumY -= slot;
+    sumXY -= x * slot;
+    count--;
+    slot = PRESSURETENDENCY_EMPTY;
+}
+
+
+boolean PressureTendency::ready() {
+    return count >= PRESSURETENDENCY_MIN_MINUTES && count >= 2;
+}
+
+
+int32_t PressureTendency::rate() {
+    if (!ready()) {
+        return 0;
+    }
+
+    // least-squares slope:
+    // (n * sumXY - sumX * sumY) / (n * sumXX - sumX^2), in Pa per minute
+    int64_t n = count;
+    int64_t num = (n * sumXY - sumX * sumY) * 60;
+    int64_t den = n * sumXX - sumX * sumX;
+
+    return (int32_t)((num + (num < 0 ? -den / 2 : den / 2)) / den);
+}
+
+
+int8_t PressureTendency::tendency() {
+    int32_t r = rate();
+
+    if (r > PRESSURETENDENCY_STEADY) {
+        return TENDENCY_RISING;
+    }
+    if (r < -PRESSURETENDENCY_STEADY) {
+        return TENDENCY_FALLING;
+    }
+    return TENDENCY_STEADY;
+}
+
+
+int PressureTendency::minutes() {
+    return count;
+}
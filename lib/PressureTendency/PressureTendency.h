@@ -0,0 +1,104 @@
+/*
+ * PressureTendency.h
+ *
+ * PressureTendency - the barometric tendency (rising, falling or steady)
+ * and its rate, from the last three hours of pressure readings.
+ *
+ * add() takes every pressure reading. The readings of each minute, counted
+ * by their time from the first reading, are averaged, and the means of the
+ * last PRESSURETENDENCY_MINUTES minutes are kept as 16-bit offsets from the
+ * first one, 2 bytes a minute. The rate is the slope of a least-squares
+ * line through them against their minute, so a minute without readings is
+ * left out rather than closing up the gap. The sums the slope needs are
+ * updated as each minute comes in and the oldest goes out, so a minute
+ * costs the same whatever the length of the history.
+ */
+
+
+#ifndef PRESSURETENDENCY_H
+#define PRESSURETENDENCY_H
+
+#include <Arduino.h>
+
+// PRESSURETENDENCY_MINUTES : minutes of history the rate is fitted to
+#ifndef PRESSURETENDENCY_MINUTES
+#define PRESSURETENDENCY_MINUTES 180
+#endif
+
+// PRESSURETENDENCY_MIN_MINUTES : minutes of history needed for a tendency
+#ifndef PRESSURETENDENCY_MIN_MINUTES
+#define PRESSURETENDENCY_MIN_MINUTES 60
+#endif
+
+// PRESSURETENDENCY_STEADY : largest rate, in Pa per hour, still steady;
+//  the default is the usual 1 hPa in 3 hours
+#ifndef PRESSURETENDENCY_STEADY
+#define PRESSURETENDENCY_STEADY 33
+#endif
+
+// offsets slot of a minute without readings
+#define PRESSURETENDENCY_EMPTY -32768
+
+#define TENDENCY_FALLING    -1
+#define TENDENCY_STEADY     0
+#define TENDENCY_RISING     1
+
+class PressureTendency {
+
+public:
+    // constructor
+    PressureTendency();
+
+    // add a pressure reading in Pa, taken at time, as a value of millis()
+    void add(int32_t pressure, unsigned long time);
+
+    // returns true once PRESSURETENDENCY_MIN_MINUTES minutes are held
+    boolean ready();
+
+    // rate of change in Pa per hour, which is 0.01 hPa per hour; 0 until
+    // ready()
+    int32_t rate();
+
+    // TENDENCY_RISING, TENDENCY_FALLING or TENDENCY_STEADY
+    int8_t tendency();
+
+    // number of minutes held, leaving out those without readings
+    int minutes();
+
+    // forget the history
+    void clear();
+
+private:
+    // add the mean of the finished minute
+    void addMinute(int32_t pressure);
+
+    // forget the minute held in the slot of minute m, the one
+    // PRESSURETENDENCY_MINUTES before it
+    void dropMinute(unsigned long m);
+
+    // minute means, as offsets from base, each in the slot of its minute
+    // modulo PRESSURETENDENCY_MINUTES; PRESSURETENDENCY_EMPTY where a
+    // minute had no readings
+    int16_t offsets[PRESSURETENDENCY_MINUTES];
+    int32_t base;
+    int count;
+
+    // sums over the minutes held of x, their minute, of x * x, of y,
+    // their offset, and of x * y
+    int64_t sumX;
+    int64_t sumXX;
+    int32_t sumY;
+    int64_t sumXY;
+
+    // the minute in progress, counted from the first reading, the value
+    // of millis() it started at, and its readings
+    unsigned long minute;
+    unsigned long minuteStart;
+    int32_t minuteSum;
+    int minuteReadings;
+
+    // the newest minute held
+    unsigned long newest;
+};
+
+#endif
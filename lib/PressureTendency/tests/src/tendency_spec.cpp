@@ -0,0 +1,219 @@
+#include "PressureTendency.h"
+#include "BDDTest.h"
+#include "trace.h"
+#include <math.h>
+
+// a repeatable pseudo-random sequence
+uint32_t seed = 12345;
+
+int32_t next(int32_t range) {
+    seed = seed * 1103515245 + 12345;
+    return (int32_t)((seed >> 8) % range) - range / 2;
+}
+
+// The minute means PressureTendency should hold, kept in full; a minute is
+// held once a reading of a later minute comes in
+struct Reference {
+    unsigned long minutes[2000];
+    int32_t means[2000];
+    int n;
+    bool pending;
+
+    Reference() : n(0), pending(false) {}
+
+    void add(unsigned long minute, int32_t mean) {
+        if (pending && minutes[n] != minute) {
+            n++;
+        }
+        minutes[n] = minute;
+        means[n] = mean;
+        pending = true;
+    }
+
+    // least-squares slope through the minutes held in the window, in Pa
+    // per hour, and how many there are
+    double rate(int* held) {
+        double sx = 0, sy = 0, sxx = 0, sxy = 0;
+        int k = 0;
+        for (int i = 0; i < n; i++) {
+            if (minutes[i] + PRESSURETENDENCY_MINUTES > minutes[n - 1]) {
+                double x = minutes[i];
+                sx += x;
+                sy += means[i];
+                sxx += x * x;
+                sxy += x * means[i];
+                k++;
+            }
+        }
+        *held = k;
+        return (k * sxy - sx * sy) / (k * sxx - sx * sx) * 60;
+    }
+};
+
+// two readings in the given minute from start, averaging mean
+void feed(PressureTendency& tendency, Reference& reference, unsigned long start, unsigned long minute, int32_t mean) {
+    tendency.add(mean - 3, start + minute * 60000);
+    tendency.add(mean + 3, start + minute * 60000 + 30000);
+    reference.add(minute, mean);
+}
+
+// true if tendency agrees with the reference, to the rounding of the rate
+bool matches(PressureTendency& tendency, Reference& reference) {
+    int held;
+    double expected = reference.rate(&held);
+    if (tendency.minutes() != held) {
+        TRACE(tendency.minutes() << " minutes, not " << held << " ");
+        return false;
+    }
+    if (held < PRESSURETENDENCY_MIN_MINUTES) {
+        return !tendency.ready() && tendency.rate() == 0;
+    }
+    if (fabs(tendency.rate() - expected) > 0.5 + 1e-6) {
+        TRACE(tendency.rate() << " Pa/h, not " << expected << " ");
+        return false;
+    }
+    return true;
+}
+
+
+int test_tendency_ready() {
+    IT("has no rate until PRESSURETENDENCY_MIN_MINUTES minutes are held");
+    PressureTendency tendency;
+    Reference reference;
+
+    for (unsigned long m = 0; m <= PRESSURETENDENCY_MIN_MINUTES; m++) {
+        IS_FALSE(tendency.ready());
+        IS_TRUE(tendency.rate() == 0);
+        IS_TRUE(tendency.tendency() == TENDENCY_STEADY);
+        feed(tendency, reference, 0, m, 100000 + 10 * m);
+    }
+    IS_TRUE(tendency.ready());
+    IS_TRUE(tendency.minutes() == PRESSURETENDENCY_MIN_MINUTES);
+    IS_TRUE(tendency.rate() == 600);
+
+    END_IT
+}
+
+int test_tendency_lines() {
+    IT("gives the slope of a straight line and its tendency");
+    PressureTendency rising, falling, steady;
+    Reference reference;
+
+    for (unsigned long m = 0; m <= 100; m++) {
+        feed(rising, reference, 0, m, 100000 + m);
+        feed(falling, reference, 0, m, 100000 - m);
+        feed(steady, reference, 0, m, 100000 + (m & 1));
+    }
+    IS_TRUE(rising.rate() == 60);
+    IS_TRUE(rising.tendency() == TENDENCY_RISING);
+    IS_TRUE(falling.rate() == -60);
+    IS_TRUE(falling.tendency() == TENDENCY_FALLING);
+    IS_TRUE(steady.rate() == 0);
+    IS_TRUE(steady.tendency() == TENDENCY_STEADY);
+
+    END_IT
+}
+
+int test_tendency_reference() {
+    IT("matches a least-squares fit from scratch on every minute, across the wrap");
+    PressureTendency tendency;
+    Reference reference;
+    int32_t pressure = 101325;
+
+    for (unsigned long m = 0; m < 3 * PRESSURETENDENCY_MINUTES; m++) {
+        pressure += next(41);
+        feed(tendency, reference, 5000, m, pressure);
+        IS_TRUE(matches(tendency, reference));
+    }
+
+    END_IT
+}
+
+int test_tendency_gap() {
+    IT("leaves out the minutes of a gap in the readings instead of closing it up");
+    PressureTendency tendency;
+    Reference reference;
+
+    for (unsigned long m = 0; m < 90; m++) {
+        feed(tendency, reference, 0, m, 100000 + m);
+    }
+    // nothing for 30 minutes while the pressure keeps rising
+    for (unsigned long m = 120; m < 150; m++) {
+        feed(tendency, reference, 0, m, 100000 + m);
+        IS_TRUE(matches(tendency, reference));
+    }
+    IS_TRUE(tendency.rate() == 60);
+    IS_TRUE(tendency.minutes() == 119);
+
+    // and drops them as they leave the window
+    for (unsigned long m = 150; m < 400; m++) {
+        feed(tendency, reference, 0, m, 100000 + m + next(21));
+        IS_TRUE(matches(tendency, reference));
+    }
+
+    END_IT
+}
+
+int test_tendency_long_gap() {
+    IT("starts over after a gap as long as the window");
+    PressureTendency tendency;
+    Reference reference;
+
+    for (unsigned long m = 0; m < 100; m++) {
+        feed(tendency, reference, 0, m, 100000 + m);
+    }
+    unsigned long resume = 99 + PRESSURETENDENCY_MINUTES;
+    for (unsigned long m = resume; m < resume + 80; m++) {
+        feed(tendency, reference, 0, m, 90000 - m);
+        IS_TRUE(matches(tendency, reference));
+    }
+    IS_TRUE(tendency.minutes() == 79);
+    IS_TRUE(tendency.rate() == -60);
+
+    END_IT
+}
+
+int test_tendency_wrap() {
+    IT("keeps counting minutes across the wrap of millis()");
+    PressureTendency tendency;
+    Reference reference;
+    unsigned long start = (unsigned long)0 - 30 * 60000UL;
+
+    for (unsigned long m = 0; m < 100; m++) {
+        feed(tendency, reference, start, m, 100000 + 2 * m);
+    }
+    IS_TRUE(matches(tendency, reference));
+    IS_TRUE(tendency.rate() == 120);
+
+    END_IT
+}
+
+int test_tendency_clear() {
+    IT("forgets the history after clear()");
+    PressureTendency tendency;
+    Reference reference;
+
+    for (unsigned long m = 0; m < 100; m++) {
+        feed(tendency, reference, 0, m, 100000 + m);
+    }
+    tendency.clear();
+    IS_TRUE(tendency.minutes() == 0);
+    IS_FALSE(tendency.ready());
+    IS_TRUE(tendency.rate() == 0);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("PressureTendency");
+    test_tendency_ready();
+    test_tendency_lines();
+    test_tendency_reference();
+    test_tendency_gap();
+    test_tendency_long_gap();
+    test_tendency_wrap();
+    test_tendency_clear();
+
+    FINISH
+}
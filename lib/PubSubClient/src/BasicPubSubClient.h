@@ -0,0 +1,97 @@
+/*
+ BasicPubSubClient.h - A header-only MQTT client with compile-time transport
+  and callback types.
+
+  BasicPubSubClient<Transport, BufferSize, Handler> speaks exactly the same
+  protocol as PubSubClient, but the network client and the message callback
+  are template parameters rather than a Client* and a callback pointer. With
+  a concrete (non-virtual) Transport and a functor Handler the compiler can
+  inline every read, write and callback.
+
+  Transport must provide connect(IPAddress,uint16_t), connect(const char*,uint16_t),
+  write(const uint8_t*,size_t), available(), read(), connected(), flush() and stop().
+  Handler is called as handler(char* topic, uint8_t* payload, unsigned int length).
+
+  Both clients are built on PubSubClientCore, which holds the protocol code;
+  this class only writes packets straight to the transport and passes
+  messages to the handler. PubSubClient additionally supports streaming
+  payloads, PROGMEM payloads, the send and receive queues and failover
+  between servers.
+*/
+
+#ifndef BasicPubSubClient_h
+#define BasicPubSubClient_h
+
+#include "PubSubClient.h"
+
+// Default Handler: ignores inbound messages
+struct MQTTNoHandler {
+   void operator()(char*, uint8_t*, unsigned int) {}
+};
+
+template <class Transport, uint16_t BufferSize = MQTT_MAX_PACKET_SIZE, class Handler = MQTTNoHandler>
+class BasicPubSubClient : public PubSubClientCore<BasicPubSubClient<Transport, BufferSize, Handler>, Transport, BufferSize> {
+private:
+   typedef PubSubClientCore<BasicPubSubClient<Transport, BufferSize, Handler>, Transport, BufferSize> Core;
+   friend class PubSubClientCore<BasicPubSubClient<Transport, BufferSize, Handler>, Transport, BufferSize>;
+
+   Handler callback;
+
+   boolean write(uint8_t header, uint8_t* buf, uint16_t length) {
+      uint8_t start = this->frame(header,buf,length);
+      return this->send(buf+start,length+5-start);
+   }
+
+   boolean sendQueued() {
+      return true;
+   }
+
+   boolean deliver(char* topic, uint8_t* payload, unsigned int length) {
+      callback(topic,payload,length);
+      return true;
+   }
+
+public:
+   BasicPubSubClient(Transport& client) : callback() {
+      this->_client = &client;
+   }
+   BasicPubSubClient(Transport& client, Handler callback) : callback(callback) {
+      this->_client = &client;
+   }
+
+   BasicPubSubClient& setCallback(Handler callback) {
+      this->callback = callback;
+      return *this;
+   }
+
+   using Core::connect;
+   boolean connect(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage) {
+      if (this->connected()) {
+         return true;
+      }
+      return this->open() && this->handshake(id,user,pass,willTopic,willQos,willRetain,willMessage);
+   }
+
+   void disconnect() {
+      write(MQTTDISCONNECT,this->buffer,0);
+      this->_state = MQTT_DISCONNECTED;
+      this->_client->stop();
+      this->lastInActivity = this->lastOutActivity = millis();
+   }
+
+   boolean loop() {
+      if (!this->connected()) {
+         return false;
+      }
+      unsigned long t = millis();
+      if (!this->keepAlive(t)) {
+         return false;
+      }
+      if (this->_client->available()) {
+         this->handlePacket(t);
+      }
+      return true;
+   }
+};
+
+#endif
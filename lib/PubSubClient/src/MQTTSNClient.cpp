@@ -0,0 +1,454 @@
+/*
+  MQTTSNClient.cpp - An MQTT-SN client over UDP.
+*/
+
+#include "MQTTSNClient.h"
+#include "Arduino.h"
+
+MQTTSNClient::MQTTSNClient() {
+    this->_state = MQTT_DISCONNECTED;
+    this->_udp = NULL;
+    this->port = 0;
+    this->topicCount = 0;
+    this->qos = 0;
+    this->nextMsgId = 1;
+    setCallback(NULL);
+}
+
+MQTTSNClient::MQTTSNClient(UDP& udp) {
+    this->_state = MQTT_DISCONNECTED;
+    this->port = 0;
+    this->topicCount = 0;
+    this->qos = 0;
+    this->nextMsgId = 1;
+    setCallback(NULL);
+    setUDP(udp);
+}
+
+MQTTSNClient::MQTTSNClient(IPAddress addr, uint16_t port, UDP& udp) {
+    this->_state = MQTT_DISCONNECTED;
+    this->topicCount = 0;
+    this->qos = 0;
+    this->nextMsgId = 1;
+    setCallback(NULL);
+    setGateway(addr, port);
+    setUDP(udp);
+}
+
+boolean MQTTSNClient::connect(const char *id) {
+    if (_state == MQTT_CONNECTED) {
+        return true;
+    }
+    if (_udp == NULL) {
+        _state = MQTT_CONNECT_FAILED;
+        return false;
+    }
+    uint8_t flags = 0;
+    if (_state != MQTTSN_ASLEEP) {
+        // A clean session forgets registered topic ids; predefined ids stay
+        uint8_t kept = 0;
+        for (uint8_t i = 0; i < topicCount; i++) {
+            if (topics[i].type == MQTTSN_TOPIC_PREDEFINED) {
+                topics[kept++] = topics[i];
+            }
+        }
+        topicCount = kept;
+        flags = MQTTSN_FLAG_CLEAN;
+    }
+    this->clientId = id;
+
+    // Leave room in the buffer for the length and type fields
+    uint16_t length = 4;
+    buffer[length++] = flags;
+    buffer[length++] = 0x01; // protocol id
+    buffer[length++] = ((MQTTSN_KEEPALIVE) >> 8);
+    buffer[length++] = ((MQTTSN_KEEPALIVE) & 0xFF);
+    length = appendString(id,buffer,length);
+
+    uint8_t hlen;
+    uint16_t len = request(MQTTSN_CONNECT,length-4,MQTTSN_CONNACK,0,&hlen);
+    if (len == 0) {
+        _state = MQTT_CONNECTION_TIMEOUT;
+        return false;
+    }
+    if (inbound[hlen] != MQTTSN_RC_ACCEPTED) {
+        _state = inbound[hlen];
+        return false;
+    }
+    lastInActivity = lastOutActivity = millis();
+    pingOutstanding = false;
+    _state = MQTT_CONNECTED;
+    return true;
+}
+
+void MQTTSNClient::disconnect() {
+    if (_udp != NULL && (_state == MQTT_CONNECTED || _state == MQTTSN_ASLEEP)) {
+        write(MQTTSN_DISCONNECT,buffer,0);
+    }
+    _state = MQTT_DISCONNECTED;
+}
+
+boolean MQTTSNClient::sleep(uint16_t duration) {
+    if (_state != MQTT_CONNECTED) {
+        return false;
+    }
+    buffer[4] = (duration >> 8);
+    buffer[5] = (duration & 0xFF);
+    uint8_t hlen;
+    if (request(MQTTSN_DISCONNECT,2,MQTTSN_DISCONNECT,0,&hlen) == 0) {
+        _state = MQTT_CONNECTION_TIMEOUT;
+        return false;
+    }
+    _state = MQTTSN_ASLEEP;
+    return true;
+}
+
+boolean MQTTSNClient::wake() {
+    if (_state != MQTTSN_ASLEEP) {
+        return false;
+    }
+    // PINGREQ with our client id: the gateway sends any buffered messages,
+    // which waitFor() passes to handlePacket(), and then a PINGRESP
+    uint16_t length = appendString(clientId,buffer,4);
+    uint8_t hlen;
+    return request(MQTTSN_PINGREQ,length-4,MQTTSN_PINGRESP,0,&hlen) > 0;
+}
+
+boolean MQTTSNClient::registerTopic(const char* topic) {
+    if (findTopic(topic)) {
+        return true;
+    }
+    if (_state != MQTT_CONNECTED || topicCount >= MQTTSN_MAX_TOPICS) {
+        return false;
+    }
+    if (MQTTSN_MAX_PACKET_SIZE < 8 + strlen(topic)) {
+        // Too long
+        return false;
+    }
+    uint16_t id = msgId();
+    uint16_t length = 4;
+    buffer[length++] = 0;
+    buffer[length++] = 0;
+    buffer[length++] = (id >> 8);
+    buffer[length++] = (id & 0xFF);
+    length = appendString(topic,buffer,length);
+
+    uint8_t hlen;
+    uint16_t len = request(MQTTSN_REGISTER,length-4,MQTTSN_REGACK,id,&hlen);
+    if (len == 0 || inbound[hlen+4] != MQTTSN_RC_ACCEPTED) {
+        return false;
+    }
+    topics[topicCount].name = topic;
+    topics[topicCount].id = (inbound[hlen]<<8)+inbound[hlen+1];
+    topics[topicCount].type = MQTTSN_TOPIC_NORMAL;
+    topicCount++;
+    return true;
+}
+
+boolean MQTTSNClient::setPredefinedTopic(const char* topic, uint16_t id) {
+    Topic* t = findTopic(topic);
+    if (t == NULL) {
+        if (topicCount >= MQTTSN_MAX_TOPICS) {
+            return false;
+        }
+        t = &topics[topicCount++];
+        t->name = topic;
+    }
+    t->id = id;
+    t->type = MQTTSN_TOPIC_PREDEFINED;
+    return true;
+}
+
+boolean MQTTSNClient::publish(const char* topic, const char* payload) {
+    return publish(topic,(const uint8_t*)payload,strlen(payload),false,this->qos);
+}
+
+boolean MQTTSNClient::publish(const char* topic, const char* payload, boolean retained) {
+    return publish(topic,(const uint8_t*)payload,strlen(payload),retained,this->qos);
+}
+
+boolean MQTTSNClient::publish(const char* topic, const uint8_t* payload, unsigned int plength) {
+    return publish(topic,payload,plength,false,this->qos);
+}
+
+boolean MQTTSNClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained) {
+    return publish(topic,payload,plength,retained,this->qos);
+}
+
+boolean MQTTSNClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained, int8_t qos) {
+    if (qos < -1 || qos > 1 || _udp == NULL) {
+        return false;
+    }
+    if (MQTTSN_MAX_PACKET_SIZE < 9 + plength) {
+        // Too long
+        return false;
+    }
+    Topic* t = findTopic(topic);
+    if (qos == -1) {
+        // QoS -1 needs neither a connection nor a registration
+        if (t == NULL || t->type != MQTTSN_TOPIC_PREDEFINED) {
+            return false;
+        }
+    } else {
+        if (_state != MQTT_CONNECTED) {
+            return false;
+        }
+        if (t == NULL) {
+            if (!registerTopic(topic)) {
+                return false;
+            }
+            t = findTopic(topic);
+        }
+    }
+
+    uint8_t flags = t->type;
+    if (qos == -1) {
+        flags |= MQTTSN_FLAG_QOSM1;
+    } else if (qos == 1) {
+        flags |= MQTTSN_FLAG_QOS1;
+    }
+    if (retained) {
+        flags |= MQTTSN_FLAG_RETAIN;
+    }
+    uint16_t id = (qos == 1) ? msgId() : 0;
+
+    uint16_t length = 4;
+    buffer[length++] = flags;
+    buffer[length++] = (t->id >> 8);
+    buffer[length++] = (t->id & 0xFF);
+    buffer[length++] = (id >> 8);
+    buffer[length++] = (id & 0xFF);
+    memcpy(buffer+length,payload,plength);
+    length += plength;
+
+    if (qos == 1) {
+        uint8_t hlen;
+        uint16_t len = request(MQTTSN_PUBLISH,length-4,MQTTSN_PUBACK,id,&hlen);
+        return len > 0 && inbound[hlen+4] == MQTTSN_RC_ACCEPTED;
+    }
+    return write(MQTTSN_PUBLISH,buffer,length-4);
+}
+
+boolean MQTTSNClient::loop() {
+    if (_state != MQTT_CONNECTED) {
+        return false;
+    }
+    unsigned long t = millis();
+    if ((t - lastInActivity > MQTTSN_KEEPALIVE*1000UL) || (t - lastOutActivity > MQTTSN_KEEPALIVE*1000UL)) {
+        if (pingOutstanding) {
+            _state = MQTT_CONNECTION_TIMEOUT;
+            return false;
+        }
+        write(MQTTSN_PINGREQ,buffer,0);
+        lastOutActivity = t;
+        lastInActivity = t;
+        pingOutstanding = true;
+    }
+    uint8_t hlen;
+    uint16_t len;
+    while ((len = readPacket(&hlen)) > 0) {
+        handlePacket(hlen,len);
+    }
+    return _state == MQTT_CONNECTED;
+}
+
+// Frames the message body at buf+4 with its length and type fields and sends
+// it as one datagram. Bodies up to 253 bytes use the 1 byte length form.
+boolean MQTTSNClient::write(uint8_t type, uint8_t* buf, uint16_t length) {
+    uint8_t* start;
+    uint16_t total;
+    if (length + 2 <= 255) {
+        total = length + 2;
+        buf[2] = total;
+        buf[3] = type;
+        start = buf+2;
+    } else {
+        total = length + 4;
+        buf[0] = 0x01;
+        buf[1] = (total >> 8);
+        buf[2] = (total & 0xFF);
+        buf[3] = type;
+        start = buf;
+    }
+    if (!_udp->beginPacket(gateway,port)) {
+        return false;
+    }
+    uint16_t rc = _udp->write(start,total);
+    if (!_udp->endPacket()) {
+        return false;
+    }
+    lastOutActivity = millis();
+    return rc == total;
+}
+
+// Reads the next datagram into inbound. Returns its length, with the
+// offset of the message body in headerLength, or 0 if there is none.
+uint16_t MQTTSNClient::readPacket(uint8_t* headerLength) {
+    int size = _udp->parsePacket();
+    if (size <= 0 || size > MQTTSN_MAX_PACKET_SIZE) {
+        return 0;
+    }
+    _udp->read(inbound,size);
+    uint16_t length;
+    if (inbound[0] == 0x01) {
+        length = (inbound[1]<<8)+inbound[2];
+        *headerLength = 4;
+    } else {
+        length = inbound[0];
+        *headerLength = 2;
+    }
+    if (length != size || length < *headerLength) {
+        return 0;
+    }
+    lastInActivity = millis();
+    return length;
+}
+
+// Waits up to MQTTSN_RETRY_TIMEOUT for a reply of the given type (and
+// message id, if not 0). Anything else that arrives meanwhile is handled.
+uint16_t MQTTSNClient::waitFor(uint8_t type, uint16_t msgId, uint8_t* headerLength) {
+    unsigned long start = millis();
+    while (millis() - start < MQTTSN_RETRY_TIMEOUT*1000UL) {
+        uint16_t len = readPacket(headerLength);
+        if (len > 0) {
+            uint8_t* body = inbound+*headerLength;
+            if (inbound[*headerLength-1] == type &&
+                (msgId == 0 || (len - *headerLength >= 4 && ((body[2]<<8)+body[3]) == msgId))) {
+                return len;
+            }
+            handlePacket(*headerLength,len);
+        }
+    }
+    return 0;
+}
+
+// Sends the message in buffer and waits for its acknowledgement,
+// retransmitting up to MQTTSN_RETRIES times.
+uint16_t MQTTSNClient::request(uint8_t type, uint16_t length, uint8_t replyType, uint16_t msgId, uint8_t* headerLength) {
+    for (uint8_t attempt = 0; attempt <= MQTTSN_RETRIES; attempt++) {
+        if (attempt > 0 && type == MQTTSN_PUBLISH) {
+            buffer[4] |= MQTTSN_FLAG_DUP;
+        }
+        if (write(type,buffer,length)) {
+            uint16_t len = waitFor(replyType,msgId,headerLength);
+            if (len > 0) {
+                return len;
+            }
+        }
+    }
+    return 0;
+}
+
+void MQTTSNClient::handlePacket(uint8_t headerLength, uint16_t length) {
+    uint8_t type = inbound[headerLength-1];
+    uint8_t* body = inbound+headerLength;
+    uint16_t blen = length-headerLength;
+    uint8_t reply[9];
+
+    if (type == MQTTSN_PUBLISH && blen >= 5) {
+        // The callback may publish, which reuses inbound, so take what
+        // the PUBACK needs first
+        uint8_t flags = body[0];
+        uint16_t topicId = (body[1]<<8)+body[2];
+        uint8_t msgIdHigh = body[3];
+        uint8_t msgIdLow = body[4];
+        Topic* t = findTopic(topicId);
+        if (t && callback) {
+            callback((char*)t->name,body+5,blen-5);
+        }
+        if ((flags & MQTTSN_FLAG_QOSM1) == MQTTSN_FLAG_QOS1) {
+            reply[4] = (topicId >> 8);
+            reply[5] = (topicId & 0xFF);
+            reply[6] = msgIdHigh;
+            reply[7] = msgIdLow;
+            reply[8] = t ? MQTTSN_RC_ACCEPTED : MQTTSN_RC_INVALID_TOPIC;
+            write(MQTTSN_PUBACK,reply,5);
+        }
+    } else if (type == MQTTSN_REGISTER && blen >= 4) {
+        // The gateway names a topic it is about to publish to us. Only
+        // topics the sketch already knows by name can be accepted.
+        uint8_t rc = MQTTSN_RC_NOT_SUPPORTED;
+        for (uint8_t i = 0; i < topicCount; i++) {
+            if (strlen(topics[i].name) == blen-4u && memcmp(topics[i].name,body+4,blen-4) == 0) {
+                topics[i].id = (body[0]<<8)+body[1];
+                topics[i].type = MQTTSN_TOPIC_NORMAL;
+                rc = MQTTSN_RC_ACCEPTED;
+                break;
+            }
+        }
+        memcpy(reply+4,body,4);
+        reply[8] = rc;
+        write(MQTTSN_REGACK,reply,5);
+    } else if (type == MQTTSN_PINGREQ) {
+        write(MQTTSN_PINGRESP,reply,0);
+    } else if (type == MQTTSN_PINGRESP) {
+        pingOutstanding = false;
+    } else if (type == MQTTSN_DISCONNECT) {
+        if (_state == MQTT_CONNECTED) {
+            _state = MQTT_CONNECTION_LOST;
+        }
+    }
+}
+
+MQTTSNClient::Topic* MQTTSNClient::findTopic(const char* topic) {
+    for (uint8_t i = 0; i < topicCount; i++) {
+        if (strcmp(topics[i].name,topic) == 0) {
+            return &topics[i];
+        }
+    }
+    return NULL;
+}
+
+MQTTSNClient::Topic* MQTTSNClient::findTopic(uint16_t id) {
+    for (uint8_t i = 0; i < topicCount; i++) {
+        if (topics[i].id == id) {
+            return &topics[i];
+        }
+    }
+    return NULL;
+}
+
+// MQTT-SN strings are not length prefixed; they run to the end of the message
+uint16_t MQTTSNClient::appendString(const char* string, uint8_t* buf, uint16_t pos) {
+    while (*string && pos < MQTTSN_MAX_PACKET_SIZE) {
+        buf[pos++] = *string++;
+    }
+    return pos;
+}
+
+uint16_t MQTTSNClient::msgId() {
+    uint16_t id = nextMsgId++;
+    if (nextMsgId == 0) {
+        nextMsgId = 1;
+    }
+    return id;
+}
+
+boolean MQTTSNClient::connected() {
+    return _state == MQTT_CONNECTED;
+}
+
+MQTTSNClient& MQTTSNClient::setGateway(IPAddress ip, uint16_t port) {
+    this->gateway = ip;
+    this->port = port;
+    return *this;
+}
+
+MQTTSNClient& MQTTSNClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
+    this->callback = callback;
+    return *this;
+}
+
+MQTTSNClient& MQTTSNClient::setUDP(UDP& udp) {
+    this->_udp = &udp;
+    return *this;
+}
+
+MQTTSNClient& MQTTSNClient::setQos(int8_t qos) {
+    this->qos = qos;
+    return *this;
+}
+
+int MQTTSNClient::state() {
+    return this->_state;
+}
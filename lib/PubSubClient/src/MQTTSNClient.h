@@ -0,0 +1,142 @@
+/*
+ MQTTSNClient.h - An MQTT-SN client over UDP.
+
+  MQTT-SN (MQTT for Sensor Networks, v1.2) replaces the TCP connection and
+  topic strings of MQTT with datagrams and 16 bit topic ids. A publish to a
+  registered topic costs 7 bytes of header, there is no TCP handshake, and a
+  sleeping client only talks to the gateway when it has something to say.
+
+  The publish API matches PubSubClient. Topics are registered with the gateway
+  the first time they are published, or up front with registerTopic(). Topic
+  strings are referenced, not copied, so they must outlive the client.
+
+  The UDP instance must already have been started with udp.begin(localPort).
+*/
+
+#ifndef MQTTSNClient_h
+#define MQTTSNClient_h
+
+#include <Arduino.h>
+#include "IPAddress.h"
+#include "Udp.h"
+#include "PubSubClient.h"
+
+// MQTTSN_MAX_PACKET_SIZE : Maximum datagram size
+#ifndef MQTTSN_MAX_PACKET_SIZE
+#define MQTTSN_MAX_PACKET_SIZE 64
+#endif
+
+// MQTTSN_MAX_TOPICS : Number of registered and predefined topics remembered
+#ifndef MQTTSN_MAX_TOPICS
+#define MQTTSN_MAX_TOPICS 8
+#endif
+
+// MQTTSN_KEEPALIVE : keepAlive (CONNECT duration) in Seconds
+#ifndef MQTTSN_KEEPALIVE
+#define MQTTSN_KEEPALIVE 60
+#endif
+
+// MQTTSN_RETRY_TIMEOUT : seconds to wait for an acknowledgement (T_retry)
+#ifndef MQTTSN_RETRY_TIMEOUT
+#define MQTTSN_RETRY_TIMEOUT 3
+#endif
+
+// MQTTSN_RETRIES : retransmissions before giving up (N_retry)
+#ifndef MQTTSN_RETRIES
+#define MQTTSN_RETRIES 2
+#endif
+
+// Additional value for client.state(); the other values match PubSubClient
+#define MQTTSN_ASLEEP               -5
+
+#define MQTTSN_ADVERTISE     0x00
+#define MQTTSN_SEARCHGW      0x01
+#define MQTTSN_GWINFO        0x02
+#define MQTTSN_CONNECT       0x04
+#define MQTTSN_CONNACK       0x05
+#define MQTTSN_REGISTER      0x0A
+#define MQTTSN_REGACK        0x0B
+#define MQTTSN_PUBLISH       0x0C
+#define MQTTSN_PUBACK        0x0D
+#define MQTTSN_PINGREQ       0x16
+#define MQTTSN_PINGRESP      0x17
+#define MQTTSN_DISCONNECT    0x18
+
+#define MQTTSN_FLAG_DUP         0x80
+#define MQTTSN_FLAG_QOS0        (0 << 5)
+#define MQTTSN_FLAG_QOS1        (1 << 5)
+#define MQTTSN_FLAG_QOSM1       (3 << 5)
+#define MQTTSN_FLAG_RETAIN      0x10
+#define MQTTSN_FLAG_CLEAN       0x04
+#define MQTTSN_TOPIC_NORMAL     0x00
+#define MQTTSN_TOPIC_PREDEFINED 0x01
+
+#define MQTTSN_RC_ACCEPTED          0x00
+#define MQTTSN_RC_INVALID_TOPIC     0x02
+#define MQTTSN_RC_NOT_SUPPORTED     0x03
+
+class MQTTSNClient {
+private:
+   struct Topic {
+      const char* name;
+      uint16_t id;
+      uint8_t type;
+   };
+   UDP* _udp;
+   IPAddress gateway;
+   uint16_t port;
+   uint8_t buffer[MQTTSN_MAX_PACKET_SIZE];
+   uint8_t inbound[MQTTSN_MAX_PACKET_SIZE];
+   Topic topics[MQTTSN_MAX_TOPICS];
+   uint8_t topicCount;
+   uint16_t nextMsgId;
+   const char* clientId;
+   unsigned long lastOutActivity;
+   unsigned long lastInActivity;
+   bool pingOutstanding;
+   int8_t qos;
+   int _state;
+   MQTT_CALLBACK_SIGNATURE;
+   boolean write(uint8_t type, uint8_t* buf, uint16_t length);
+   uint16_t readPacket(uint8_t* headerLength);
+   uint16_t waitFor(uint8_t type, uint16_t msgId, uint8_t* headerLength);
+   uint16_t request(uint8_t type, uint16_t length, uint8_t replyType, uint16_t msgId, uint8_t* headerLength);
+   void handlePacket(uint8_t headerLength, uint16_t length);
+   Topic* findTopic(const char* topic);
+   Topic* findTopic(uint16_t id);
+   uint16_t appendString(const char* string, uint8_t* buf, uint16_t pos);
+   uint16_t msgId();
+public:
+   MQTTSNClient();
+   MQTTSNClient(UDP& udp);
+   MQTTSNClient(IPAddress, uint16_t, UDP& udp);
+
+   MQTTSNClient& setGateway(IPAddress ip, uint16_t port);
+   MQTTSNClient& setCallback(MQTT_CALLBACK_SIGNATURE);
+   MQTTSNClient& setUDP(UDP& udp);
+   // QoS used by the PubSubClient style publish() calls: -1, 0 or 1
+   MQTTSNClient& setQos(int8_t qos);
+
+   boolean connect(const char* id);
+   void disconnect();
+   // enter the sleeping state for duration seconds
+   boolean sleep(uint16_t duration);
+   // check in with the gateway while asleep; buffered messages are
+   // passed to the callback before returning
+   boolean wake();
+
+   boolean registerTopic(const char* topic);
+   // topic ids agreed with the gateway out of band; required for QoS -1
+   boolean setPredefinedTopic(const char* topic, uint16_t id);
+
+   boolean publish(const char* topic, const char* payload);
+   boolean publish(const char* topic, const char* payload, boolean retained);
+   boolean publish(const char* topic, const uint8_t * payload, unsigned int plength);
+   boolean publish(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained);
+   boolean publish(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained, int8_t qos);
+   boolean loop();
+   boolean connected();
+   int state();
+};
+
+#endif
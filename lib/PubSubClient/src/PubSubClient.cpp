@@ -8,39 +8,52 @@
 #include "Arduino.h"
 
 PubSubClient::PubSubClient() {
-    this->_state = MQTT_DISCONNECTED;
-    this->_client = NULL;
-    this->stream = NULL;
+    setReceiveQueue(NULL,0);
+    setSendQueue(NULL,0);
+    this->probeClient = NULL;
+    clearServers();
     setCallback(NULL);
 }
 
 PubSubClient::PubSubClient(Client& client) {
-    this->_state = MQTT_DISCONNECTED;
+    setReceiveQueue(NULL,0);
+    setSendQueue(NULL,0);
+    this->probeClient = NULL;
+    clearServers();
     setClient(client);
-    this->stream = NULL;
 }
 
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, Client& client) {
-    this->_state = MQTT_DISCONNECTED;
+    setReceiveQueue(NULL,0);
+    setSendQueue(NULL,0);
+    this->probeClient = NULL;
+    clearServers();
     setServer(addr, port);
     setClient(client);
-    this->stream = NULL;
 }
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, Client& client, Stream& stream) {
-    this->_state = MQTT_DISCONNECTED;
+    setReceiveQueue(NULL,0);
+    setSendQueue(NULL,0);
+    this->probeClient = NULL;
+    clearServers();
     setServer(addr,port);
     setClient(client);
     setStream(stream);
 }
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client) {
-    this->_state = MQTT_DISCONNECTED;
+    setReceiveQueue(NULL,0);
+    setSendQueue(NULL,0);
+    this->probeClient = NULL;
+    clearServers();
     setServer(addr, port);
     setCallback(callback);
     setClient(client);
-    this->stream = NULL;
 }
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client, Stream& stream) {
-    this->_state = MQTT_DISCONNECTED;
+    setReceiveQueue(NULL,0);
+    setSendQueue(NULL,0);
+    this->probeClient = NULL;
+    clearServers();
     setServer(addr,port);
     setCallback(callback);
     setClient(client);
@@ -48,26 +61,36 @@ PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATUR
 }
 
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, Client& client) {
-    this->_state = MQTT_DISCONNECTED;
+    setReceiveQueue(NULL,0);
+    setSendQueue(NULL,0);
+    this->probeClient = NULL;
+    clearServers();
     setServer(ip, port);
     setClient(client);
-    this->stream = NULL;
 }
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, Client& client, Stream& stream) {
-    this->_state = MQTT_DISCONNECTED;
+    setReceiveQueue(NULL,0);
+    setSendQueue(NULL,0);
+    this->probeClient = NULL;
+    clearServers();
     setServer(ip,port);
     setClient(client);
     setStream(stream);
 }
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client) {
-    this->_state = MQTT_DISCONNECTED;
+    setReceiveQueue(NULL,0);
+    setSendQueue(NULL,0);
+    this->probeClient = NULL;
+    clearServers();
     setServer(ip, port);
     setCallback(callback);
     setClient(client);
-    this->stream = NULL;
 }
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client, Stream& stream) {
-    this->_state = MQTT_DISCONNECTED;
+    setReceiveQueue(NULL,0);
+    setSendQueue(NULL,0);
+    this->probeClient = NULL;
+    clearServers();
     setServer(ip,port);
     setCallback(callback);
     setClient(client);
@@ -75,266 +98,105 @@ PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE,
 }
 
 PubSubClient::PubSubClient(const char* domain, uint16_t port, Client& client) {
-    this->_state = MQTT_DISCONNECTED;
+    setReceiveQueue(NULL,0);
+    setSendQueue(NULL,0);
+    this->probeClient = NULL;
+    clearServers();
     setServer(domain,port);
     setClient(client);
-    this->stream = NULL;
 }
 PubSubClient::PubSubClient(const char* domain, uint16_t port, Client& client, Stream& stream) {
-    this->_state = MQTT_DISCONNECTED;
+    setReceiveQueue(NULL,0);
+    setSendQueue(NULL,0);
+    this->probeClient = NULL;
+    clearServers();
     setServer(domain,port);
     setClient(client);
     setStream(stream);
 }
 PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client) {
-    this->_state = MQTT_DISCONNECTED;
+    setReceiveQueue(NULL,0);
+    setSendQueue(NULL,0);
+    this->probeClient = NULL;
+    clearServers();
     setServer(domain,port);
     setCallback(callback);
     setClient(client);
-    this->stream = NULL;
 }
 PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client, Stream& stream) {
-    this->_state = MQTT_DISCONNECTED;
+    setReceiveQueue(NULL,0);
+    setSendQueue(NULL,0);
+    this->probeClient = NULL;
+    clearServers();
     setServer(domain,port);
     setCallback(callback);
     setClient(client);
     setStream(stream);
 }
 
-boolean PubSubClient::connect(const char *id) {
-    return connect(id,NULL,NULL,0,0,0,0);
-}
-
-boolean PubSubClient::connect(const char *id, const char *user, const char *pass) {
-    return connect(id,user,pass,0,0,0,0);
-}
-
-boolean PubSubClient::connect(const char *id, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage) {
-    return connect(id,NULL,NULL,willTopic,willQos,willRetain,willMessage);
-}
-
 boolean PubSubClient::connect(const char *id, const char *user, const char *pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage) {
-    if (!connected()) {
-        int result = 0;
-
-        if (domain != NULL) {
-            result = _client->connect(this->domain, this->port);
-        } else {
-            result = _client->connect(this->ip, this->port);
-        }
-        if (result == 1) {
-            nextMsgId = 1;
-            // Leave room in the buffer for header and variable length field
-            uint16_t length = 5;
-            unsigned int j;
-
-#if MQTT_VERSION == MQTT_VERSION_3_1
-            uint8_t d[9] = {0x00,0x06,'M','Q','I','s','d','p', MQTT_VERSION};
-#define MQTT_HEADER_VERSION_LENGTH 9
-#elif MQTT_VERSION == MQTT_VERSION_3_1_1
-            uint8_t d[7] = {0x00,0x04,'M','Q','T','T',MQTT_VERSION};
-#define MQTT_HEADER_VERSION_LENGTH 7
-#endif
-            for (j = 0;j<MQTT_HEADER_VERSION_LENGTH;j++) {
-                buffer[length++] = d[j];
-            }
-
-            uint8_t v;
-            if (willTopic) {
-                v = 0x06|(willQos<<3)|(willRetain<<5);
-            } else {
-                v = 0x02;
-            }
-
-            if(user != NULL) {
-                v = v|0x80;
-
-                if(pass != NULL) {
-                    v = v|(0x80>>1);
-                }
-            }
-
-            buffer[length++] = v;
-
-            buffer[length++] = ((MQTT_KEEPALIVE) >> 8);
-            buffer[length++] = ((MQTT_KEEPALIVE) & 0xFF);
-            length = writeString(id,buffer,length);
-            if (willTopic) {
-                length = writeString(willTopic,buffer,length);
-                length = writeString(willMessage,buffer,length);
-            }
-
-            if(user != NULL) {
-                length = writeString(user,buffer,length);
-                if(pass != NULL) {
-                    length = writeString(pass,buffer,length);
-                }
-            }
-
-            write(MQTTCONNECT,buffer,length-5);
-
-            lastInActivity = lastOutActivity = millis();
-
-            while (!_client->available()) {
-                unsigned long t = millis();
-                if (t-lastInActivity >= ((int32_t) MQTT_SOCKET_TIMEOUT*1000UL)) {
-                    _state = MQTT_CONNECTION_TIMEOUT;
-                    _client->stop();
-                    return false;
-                }
-            }
-            uint8_t llen;
-            uint16_t len = readPacket(&llen);
-
-            if (len == 4) {
-                if (buffer[3] == 0) {
-                    lastInActivity = millis();
-                    pingOutstanding = false;
-                    _state = MQTT_CONNECTED;
-                    return true;
-                } else {
-                    _state = buffer[3];
-                }
-            }
-            _client->stop();
-        } else {
-            _state = MQTT_CONNECT_FAILED;
+    if (this->brokerCount == 0 || connected()) {
+        return connectServer(id,user,pass,willTopic,willQos,willRetain,willMessage);
+    }
+    // Give each server at most one attempt, best candidate first
+    for (uint8_t attempt = 0; attempt < this->brokerCount; attempt++) {
+        this->currentBroker = selectBroker();
+        Broker* b = &this->brokers[this->currentBroker];
+        this->ip = b->ip;
+        this->domain = b->domain;
+        this->port = b->port;
+        if (connectServer(id,user,pass,willTopic,willQos,willRetain,willMessage)) {
+            b->failed = false;
+            this->brokerCheckedAt = millis();
+            endProbe();
+            return true;
         }
-        return false;
+        b->failed = true;
+        b->failedAt = millis();
     }
-    return true;
-}
-
-// reads a byte into result
-boolean PubSubClient::readByte(uint8_t * result) {
-   uint32_t previousMillis = millis();
-   while(!_client->available()) {
-     uint32_t currentMillis = millis();
-     if(currentMillis - previousMillis >= ((int32_t) MQTT_SOCKET_TIMEOUT * 1000)){
-       return false;
-     }
-   }
-   *result = _client->read();
-   return true;
-}
-
-// reads a byte into result[*index] and increments index
-boolean PubSubClient::readByte(uint8_t * result, uint16_t * index){
-  uint16_t current_index = *index;
-  uint8_t * write_address = &(result[current_index]);
-  if(readByte(write_address)){
-    *index = current_index + 1;
-    return true;
-  }
-  return false;
+    return false;
 }
 
-uint16_t PubSubClient::readPacket(uint8_t* lengthLength) {
-    uint16_t len = 0;
-    if(!readByte(buffer, &len)) return 0;
-    bool isPublish = (buffer[0]&0xF0) == MQTTPUBLISH;
-    uint32_t multiplier = 1;
-    uint16_t length = 0;
-    uint8_t digit = 0;
-    uint16_t skip = 0;
-    uint8_t start = 0;
-
-    do {
-        if(!readByte(&digit)) return 0;
-        buffer[len++] = digit;
-        length += (digit & 127) * multiplier;
-        multiplier *= 128;
-    } while ((digit & 128) != 0);
-    *lengthLength = len-1;
-
-    if (isPublish) {
-        // Read in topic length to calculate bytes to skip over for Stream writing
-        if(!readByte(buffer, &len)) return 0;
-        if(!readByte(buffer, &len)) return 0;
-        skip = (buffer[*lengthLength+1]<<8)+buffer[*lengthLength+2];
-        start = 2;
-        if (buffer[0]&MQTTQOS1) {
-            // skip message id
-            skip += 2;
-        }
+boolean PubSubClient::connectServer(const char *id, const char *user, const char *pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage) {
+    if (connected()) {
+        return true;
     }
-
-    for (uint16_t i = start;i<length;i++) {
-        if(!readByte(&digit)) return 0;
-        if (this->stream) {
-            if (isPublish && len-*lengthLength-2>skip) {
-                this->stream->write(digit);
-            }
-        }
-        if (len < MQTT_MAX_PACKET_SIZE) {
-            buffer[len] = digit;
-        }
-        len++;
+    if (!open()) {
+        return false;
     }
-
-    if (!this->stream && len > MQTT_MAX_PACKET_SIZE) {
-        len = 0; // This will cause the packet to be ignored.
+    // Anything still queued belongs to the previous session
+    discardQueued();
+    unsigned long start = millis();
+    if (!handshake(id,user,pass,willTopic,willQos,willRetain,willMessage)) {
+        return false;
     }
-
-    return len;
+    recordRtt(this->currentBroker,millis()-start);
+    return true;
 }
 
 boolean PubSubClient::loop() {
     if (connected()) {
+        sendQueued();
         unsigned long t = millis();
-        if ((t - lastInActivity > MQTT_KEEPALIVE*1000UL) || (t - lastOutActivity > MQTT_KEEPALIVE*1000UL)) {
-            if (pingOutstanding) {
-                this->_state = MQTT_CONNECTION_TIMEOUT;
-                _client->stop();
-                return false;
-            } else {
-                buffer[0] = MQTTPINGREQ;
-                buffer[1] = 0;
-                _client->write(buffer,2);
-                lastOutActivity = t;
-                lastInActivity = t;
-                pingOutstanding = true;
+        if (!keepAlive(t)) {
+            if (this->currentBroker >= 0) {
+                this->brokers[this->currentBroker].failed = true;
+                this->brokers[this->currentBroker].failedAt = t;
+            }
+            return false;
+        }
+        uint8_t burst = this->rxQueue ? MQTT_RX_BURST : 1;
+        while (burst-- > 0 && _client->available()) {
+            if (handlePacket(t) == MQTTPINGRESP) {
+                recordRtt(this->currentBroker,millis()-pingSentAt);
             }
         }
-        if (_client->available()) {
-            uint8_t llen;
-            uint16_t len = readPacket(&llen);
-            uint16_t msgId = 0;
-            uint8_t *payload;
-            if (len > 0) {
-                lastInActivity = t;
-                uint8_t type = buffer[0]&0xF0;
-                if (type == MQTTPUBLISH) {
-                    if (callback) {
-                        uint16_t tl = (buffer[llen+1]<<8)+buffer[llen+2]; /* topic length in bytes */
-                        memmove(buffer+llen+2,buffer+llen+3,tl); /* move topic inside buffer 1 byte to front */
-                        buffer[llen+2+tl] = 0; /* end the topic as a 'C' string with \x00 */
-                        char *topic = (char*) buffer+llen+2;
-                        // msgId only present for QOS>0
-                        if ((buffer[0]&0x06) == MQTTQOS1) {
-                            msgId = (buffer[llen+3+tl]<<8)+buffer[llen+3+tl+1];
-                            payload = buffer+llen+3+tl+2;
-                            callback(topic,payload,len-llen-3-tl-2);
-
-                            buffer[0] = MQTTPUBACK;
-                            buffer[1] = 2;
-                            buffer[2] = (msgId >> 8);
-                            buffer[3] = (msgId & 0xFF);
-                            _client->write(buffer,4);
-                            lastOutActivity = t;
-
-                        } else {
-                            payload = buffer+llen+3+tl;
-                            callback(topic,payload,len-llen-3-tl);
-                        }
-                    }
-                } else if (type == MQTTPINGREQ) {
-                    buffer[0] = MQTTPINGRESP;
-                    buffer[1] = 0;
-                    _client->write(buffer,2);
-                } else if (type == MQTTPINGRESP) {
-                    pingOutstanding = false;
-                }
+        if (this->probeClient && this->brokerCount > 1 && probe(t)) {
+            if (selectBroker() != this->currentBroker) {
+                // A server that just answered is preferred or faster; drop
+                // this connection so the next connect() moves over
+                disconnect();
+                return false;
             }
         }
         return true;
@@ -342,38 +204,92 @@ boolean PubSubClient::loop() {
     return false;
 }
 
-boolean PubSubClient::publish(const char* topic, const char* payload) {
-    return publish(topic,(const uint8_t*)payload,strlen(payload),false);
+// Inbound messages go to the receive queue when there is one, otherwise
+// straight to the callback
+boolean PubSubClient::deliver(char* topic, uint8_t* payload, unsigned int length) {
+    if (this->rxQueue) {
+        return enqueue(topic,strlen(topic),payload,length);
+    }
+    if (callback) {
+        callback(topic,payload,length);
+        return true;
+    }
+    return false;
 }
 
-boolean PubSubClient::publish(const char* topic, const char* payload, boolean retained) {
-    return publish(topic,(const uint8_t*)payload,strlen(payload),retained);
+// Queued messages are stored as contiguous records so that dispatch() can
+// hand the callback pointers straight into the queue:
+//   [topic length:2][payload length:2][topic][\x00][payload]
+// A record never wraps; if it does not fit at the end of the queue a 0xFFFF
+// marker is left behind (when there is room for one) and it starts at 0.
+boolean PubSubClient::enqueue(const char* topic, uint16_t tlength, const uint8_t* payload, uint16_t plength) {
+    uint16_t n = 4+tlength+1+plength;
+    uint16_t pos;
+    if (this->rxCount == 0) {
+        this->rxHead = this->rxTail = 0;
+    }
+    if (this->rxCount == 0 || this->rxTail > this->rxHead) {
+        if (this->rxQueueSize - this->rxTail >= n) {
+            pos = this->rxTail;
+        } else if (this->rxHead >= n) {
+            if (this->rxQueueSize - this->rxTail >= 4) {
+                this->rxQueue[this->rxTail] = 0xFF;
+                this->rxQueue[this->rxTail+1] = 0xFF;
+            }
+            pos = 0;
+        } else {
+            this->rxDropped++;
+            return false;
+        }
+    } else if (this->rxHead - this->rxTail >= n) {
+        pos = this->rxTail;
+    } else {
+        this->rxDropped++;
+        return false;
+    }
+    uint8_t* rec = this->rxQueue+pos;
+    rec[0] = (tlength >> 8);
+    rec[1] = (tlength & 0xFF);
+    rec[2] = (plength >> 8);
+    rec[3] = (plength & 0xFF);
+    memcpy(rec+4,topic,tlength);
+    rec[4+tlength] = 0;
+    memcpy(rec+4+tlength+1,payload,plength);
+    this->rxTail = pos+n;
+    this->rxCount++;
+    return true;
 }
 
-boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength) {
-    return publish(topic, payload, plength, false);
+boolean PubSubClient::dispatch() {
+    if (!this->rxQueue || this->rxCount == 0) {
+        return false;
+    }
+    if (this->rxQueueSize - this->rxHead < 4 ||
+        (this->rxQueue[this->rxHead] == 0xFF && this->rxQueue[this->rxHead+1] == 0xFF)) {
+        this->rxHead = 0;
+    }
+    uint8_t* rec = this->rxQueue+this->rxHead;
+    uint16_t tl = (rec[0]<<8)+rec[1];
+    uint16_t pl = (rec[2]<<8)+rec[3];
+    // The record stays queued until the callback returns, so the callback
+    // may publish, or call loop(), without the message being overwritten.
+    if (callback) {
+        callback((char*)rec+4,rec+4+tl+1,pl);
+    }
+    this->rxHead += 4+tl+1+pl;
+    this->rxCount--;
+    if (this->rxCount == 0) {
+        this->rxHead = this->rxTail = 0;
+    }
+    return true;
 }
 
-boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained) {
-    if (connected()) {
-        if (MQTT_MAX_PACKET_SIZE < 5 + 2+strlen(topic) + plength) {
-            // Too long
-            return false;
-        }
-        // Leave room in the buffer for header and variable length field
-        uint16_t length = 5;
-        length = writeString(topic,buffer,length);
-        uint16_t i;
-        for (i=0;i<plength;i++) {
-            buffer[length++] = payload[i];
-        }
-        uint8_t header = MQTTPUBLISH;
-        if (retained) {
-            header |= 1;
-        }
-        return write(header,buffer,length-5);
-    }
-    return false;
+uint16_t PubSubClient::queued() {
+    return this->rxCount;
+}
+
+uint16_t PubSubClient::dropped() {
+    return this->rxDropped;
 }
 
 boolean PubSubClient::publish_P(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained) {
@@ -410,6 +326,21 @@ boolean PubSubClient::publish_P(const char* topic, const uint8_t* payload, unsig
 
     pos = writeString(topic,buffer,pos);
 
+    if (this->txQueue) {
+        sendQueued();
+        if ((unsigned int)(this->txQueueSize - this->txLength) < pos + plength) {
+            return false;
+        }
+        uint16_t tail = (this->txHead + this->txLength) % this->txQueueSize;
+        for (i=0;i<pos+plength;i++) {
+            this->txQueue[tail] = (i < pos) ? buffer[i] : pgm_read_byte_near(payload + i - pos);
+            tail = (tail + 1) % this->txQueueSize;
+        }
+        this->txLength += pos + plength;
+        sendQueued();
+        return true;
+    }
+
     rc += _client->write(buffer,pos);
 
     for (i=0;i<plength;i++) {
@@ -422,167 +353,296 @@ boolean PubSubClient::publish_P(const char* topic, const uint8_t* payload, unsig
 }
 
 boolean PubSubClient::write(uint8_t header, uint8_t* buf, uint16_t length) {
-    uint8_t lenBuf[4];
-    uint8_t llen = 0;
-    uint8_t digit;
-    uint8_t pos = 0;
-    uint16_t rc;
-    uint16_t len = length;
-    do {
-        digit = len % 128;
-        len = len / 128;
-        if (len > 0) {
-            digit |= 0x80;
+    uint8_t start = frame(header,buf,length);
+    uint16_t n = length+5-start;
+
+    if (this->txQueue) {
+        if (this->txQueueSize - this->txLength < n) {
+            // Try to make room; if the network still will not take the
+            // bytes the caller has to retry later
+            sendQueued();
+            if (this->txQueueSize - this->txLength < n) {
+                return false;
+            }
         }
-        lenBuf[pos++] = digit;
-        llen++;
-    } while(len>0);
-
-    buf[4-llen] = header;
-    for (int i=0;i<llen;i++) {
-        buf[5-llen+i] = lenBuf[i];
+        uint16_t tail = (this->txHead + this->txLength) % this->txQueueSize;
+        for (uint16_t i=0;i<n;i++) {
+            this->txQueue[tail] = buf[start+i];
+            tail = (tail + 1) % this->txQueueSize;
+        }
+        this->txLength += n;
+        sendQueued();
+        return true;
     }
 
-#ifdef MQTT_MAX_TRANSFER_SIZE
-    uint8_t* writeBuf = buf+(4-llen);
-    uint16_t bytesRemaining = length+1+llen;  //Match the length type
-    uint8_t bytesToWrite;
-    boolean result = true;
-    while((bytesRemaining > 0) && result) {
-        bytesToWrite = (bytesRemaining > MQTT_MAX_TRANSFER_SIZE)?MQTT_MAX_TRANSFER_SIZE:bytesRemaining;
-        rc = _client->write(writeBuf,bytesToWrite);
-        result = (rc == bytesToWrite);
-        bytesRemaining -= rc;
-        writeBuf += rc;
-    }
-    return result;
-#else
-    rc = _client->write(buf+(4-llen),length+1+llen);
-    lastOutActivity = millis();
-    return (rc == 1+llen+length);
-#endif
-}
-
-boolean PubSubClient::subscribe(const char* topic) {
-    return subscribe(topic, 0);
+    return send(buf+start,n);
 }
 
-boolean PubSubClient::subscribe(const char* topic, uint8_t qos) {
-    if (qos < 0 || qos > 1) {
-        return false;
-    }
-    if (MQTT_MAX_PACKET_SIZE < 9 + strlen(topic)) {
-        // Too long
-        return false;
+// Writes as much of the send queue as the client will accept without
+// blocking. Returns true once the queue is empty.
+boolean PubSubClient::sendQueued() {
+    if (!this->txQueue) {
+        return true;
     }
-    if (connected()) {
-        // Leave room in the buffer for header and variable length field
-        uint16_t length = 5;
-        nextMsgId++;
-        if (nextMsgId == 0) {
-            nextMsgId = 1;
+    while (this->txLength > 0) {
+        uint16_t chunk = this->txQueueSize - this->txHead;
+        if (chunk > this->txLength) {
+            chunk = this->txLength;
         }
-        buffer[length++] = (nextMsgId >> 8);
-        buffer[length++] = (nextMsgId & 0xFF);
-        length = writeString((char*)topic, buffer,length);
-        buffer[length++] = qos;
-        return write(MQTTSUBSCRIBE|MQTTQOS1,buffer,length-5);
-    }
-    return false;
-}
-
-boolean PubSubClient::unsubscribe(const char* topic) {
-    if (MQTT_MAX_PACKET_SIZE < 9 + strlen(topic)) {
-        // Too long
-        return false;
-    }
-    if (connected()) {
-        uint16_t length = 5;
-        nextMsgId++;
-        if (nextMsgId == 0) {
-            nextMsgId = 1;
+#ifdef MQTT_MAX_TRANSFER_SIZE
+        if (chunk > MQTT_MAX_TRANSFER_SIZE) {
+            chunk = MQTT_MAX_TRANSFER_SIZE;
+        }
+#endif
+        uint16_t rc = _client->write(this->txQueue+this->txHead,chunk);
+        if (rc > 0) {
+            lastOutActivity = millis();
+        }
+        this->txHead = (this->txHead + rc) % this->txQueueSize;
+        this->txLength -= rc;
+        if (rc < chunk) {
+            // The client is congested; resume from here on the next loop()
+            return false;
         }
-        buffer[length++] = (nextMsgId >> 8);
-        buffer[length++] = (nextMsgId & 0xFF);
-        length = writeString(topic, buffer,length);
-        return write(MQTTUNSUBSCRIBE|MQTTQOS1,buffer,length-5);
     }
-    return false;
+    return true;
 }
 
 void PubSubClient::disconnect() {
-    buffer[0] = MQTTDISCONNECT;
-    buffer[1] = 0;
-    _client->write(buffer,2);
+    // Send what the network takes now, then DISCONNECT behind it; whatever
+    // is still queued when the socket closes is counted by discarded()
+    sendQueued();
+    write(MQTTDISCONNECT,buffer,0);
+    discardQueued();
     _state = MQTT_DISCONNECTED;
     _client->stop();
     lastInActivity = lastOutActivity = millis();
 }
 
-uint16_t PubSubClient::writeString(const char* string, uint8_t* buf, uint16_t pos) {
-    const char* idp = string;
-    uint16_t i = 0;
-    pos += 2;
-    while (*idp) {
-        buf[pos++] = *idp++;
-        i++;
-    }
-    buf[pos-i-2] = (i >> 8);
-    buf[pos-i-1] = (i & 0xFF);
-    return pos;
+PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
+    this->callback = callback;
+    return *this;
 }
 
+PubSubClient& PubSubClient::setClient(Client& client){
+    this->_client = &client;
+    return *this;
+}
 
-boolean PubSubClient::connected() {
-    boolean rc;
-    if (_client == NULL ) {
-        rc = false;
-    } else {
-        rc = (int)_client->connected();
-        if (!rc) {
-            if (this->_state == MQTT_CONNECTED) {
-                this->_state = MQTT_CONNECTION_LOST;
-                _client->flush();
-                _client->stop();
-            }
-        }
-    }
-    return rc;
+PubSubClient& PubSubClient::setStream(Stream& stream){
+    this->stream = &stream;
+    return *this;
 }
 
-PubSubClient& PubSubClient::setServer(uint8_t * ip, uint16_t port) {
-    IPAddress addr(ip[0],ip[1],ip[2],ip[3]);
-    return setServer(addr,port);
+PubSubClient& PubSubClient::setReceiveQueue(uint8_t* queue, uint16_t size) {
+    this->rxQueue = queue;
+    this->rxQueueSize = size;
+    this->rxHead = this->rxTail = 0;
+    this->rxCount = 0;
+    this->rxDropped = 0;
+    return *this;
 }
 
-PubSubClient& PubSubClient::setServer(IPAddress ip, uint16_t port) {
-    this->ip = ip;
-    this->port = port;
-    this->domain = NULL;
+PubSubClient& PubSubClient::setSendQueue(uint8_t* queue, uint16_t size) {
+    this->txQueue = queue;
+    this->txQueueSize = size;
+    this->txHead = this->txLength = 0;
+    this->txDiscarded = 0;
     return *this;
 }
 
-PubSubClient& PubSubClient::setServer(const char * domain, uint16_t port) {
-    this->domain = domain;
-    this->port = port;
+uint16_t PubSubClient::pending() {
+    return this->txLength;
+}
+
+uint32_t PubSubClient::discarded() {
+    return this->txDiscarded;
+}
+
+// Empties the send queue, counting the bytes that were never sent
+void PubSubClient::discardQueued() {
+    this->txDiscarded += this->txLength;
+    this->txHead = this->txLength = 0;
+}
+
+PubSubClient& PubSubClient::addServer(uint8_t * ip, uint16_t port) {
+    IPAddress addr(ip[0],ip[1],ip[2],ip[3]);
+    return addServer(addr,port);
+}
+
+PubSubClient& PubSubClient::addServer(IPAddress ip, uint16_t port) {
+    if (this->brokerCount < MQTT_MAX_BROKERS) {
+        Broker* b = &this->brokers[this->brokerCount++];
+        b->ip = ip;
+        b->domain = NULL;
+        b->port = port;
+        b->rtt = 0;
+        b->failed = false;
+    }
     return *this;
 }
 
-PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
-    this->callback = callback;
+PubSubClient& PubSubClient::addServer(const char * domain, uint16_t port) {
+    if (this->brokerCount < MQTT_MAX_BROKERS) {
+        Broker* b = &this->brokers[this->brokerCount++];
+        b->domain = domain;
+        b->port = port;
+        b->rtt = 0;
+        b->failed = false;
+    }
     return *this;
 }
 
-PubSubClient& PubSubClient::setClient(Client& client){
-    this->_client = &client;
+PubSubClient& PubSubClient::clearServers() {
+    endProbe();
+    this->brokerCount = 0;
+    this->currentBroker = -1;
+    this->probeNext = 0;
     return *this;
 }
 
-PubSubClient& PubSubClient::setStream(Stream& stream){
-    this->stream = &stream;
+PubSubClient& PubSubClient::setProbeClient(Client& client) {
+    endProbe();
+    this->probeClient = &client;
     return *this;
 }
 
-int PubSubClient::state() {
-    return this->_state;
+// Servers are listed in order of preference. A server that failed within
+// the last MQTT_BROKER_RETRY seconds is passed over, and a less preferred
+// server is only chosen for speed if its measured round trip time is under
+// half that of the better one.
+int8_t PubSubClient::selectBroker() {
+    unsigned long t = millis();
+    int8_t best = -1;
+    for (uint8_t i = 0; i < this->brokerCount; i++) {
+        Broker* b = &this->brokers[i];
+        if (b->failed && t - b->failedAt < MQTT_BROKER_RETRY*1000UL) {
+            continue;
+        }
+        if (best < 0 || (b->rtt && this->brokers[best].rtt && b->rtt*2 < this->brokers[best].rtt)) {
+            best = i;
+        }
+    }
+    if (best < 0) {
+        // Every server failed recently; retry the one that failed longest ago
+        best = 0;
+        for (uint8_t i = 1; i < this->brokerCount; i++) {
+            if (t - this->brokers[i].failedAt > t - this->brokers[best].failedAt) {
+                best = i;
+            }
+        }
+    }
+    return best;
+}
+
+void PubSubClient::recordRtt(int8_t broker, unsigned long rtt) {
+    if (broker < 0) {
+        return;
+    }
+    Broker* b = &this->brokers[broker];
+    if (rtt == 0) {
+        rtt = 1;
+    } else if (rtt > 0xFFFF) {
+        rtt = 0xFFFF;
+    }
+    if (b->rtt == 0) {
+        b->rtt = rtt;
+    } else {
+        b->rtt = (3UL*b->rtt + rtt) / 4;
+    }
+}
+
+// Every MQTT_BROKER_FAILBACK seconds one of the servers other than the
+// connected one, in turn, is sent a CONNECT through the probe client. Later
+// calls pick up the CONNACK without waiting for it; an answer records the
+// server's round trip time and clears its failure, no answer within
+// MQTT_SOCKET_TIMEOUT seconds marks it failed. Returns true when a probe
+// has just been answered.
+boolean PubSubClient::probe(unsigned long t) {
+    if (this->probeBroker < 0) {
+        if (t - this->brokerCheckedAt <= MQTT_BROKER_FAILBACK*1000UL) {
+            return false;
+        }
+        this->brokerCheckedAt = t;
+        uint8_t i = this->probeNext;
+        if (i == this->currentBroker) {
+            i = (i + 1) % this->brokerCount;
+        }
+        this->probeNext = (i + 1) % this->brokerCount;
+        Broker* b = &this->brokers[i];
+        int result;
+        if (b->domain != NULL) {
+            result = this->probeClient->connect(b->domain, b->port);
+        } else {
+            result = this->probeClient->connect(b->ip, b->port);
+        }
+        if (result != 1) {
+            b->failed = true;
+            b->failedAt = t;
+            return false;
+        }
+        // Clean session with an empty client id, so the probe never takes
+        // over this client's session on that server
+#if MQTT_VERSION == MQTT_VERSION_3_1
+        uint8_t connect[] = {MQTTCONNECT,14,0x00,0x06,'M','Q','I','s','d','p',MQTT_VERSION,0x02,
+                             ((MQTT_KEEPALIVE) >> 8),((MQTT_KEEPALIVE) & 0xFF),0x00,0x00};
+#else
+        uint8_t connect[] = {MQTTCONNECT,12,0x00,0x04,'M','Q','T','T',MQTT_VERSION,0x02,
+                             ((MQTT_KEEPALIVE) >> 8),((MQTT_KEEPALIVE) & 0xFF),0x00,0x00};
+#endif
+        this->probeClient->write(connect,sizeof(connect));
+        this->probeBroker = i;
+        this->probeSentAt = millis();
+        return false;
+    }
+
+    Broker* b = &this->brokers[this->probeBroker];
+    if (this->probeClient->available() >= 4) {
+        uint8_t connack[4];
+        for (uint8_t k = 0; k < 4; k++) {
+            connack[k] = this->probeClient->read();
+        }
+        // The probe carries no credentials, so a server that refuses it
+        // for the client id, the username or the password is still up;
+        // only one that says it is unavailable is not
+        boolean up = connack[0] == MQTTCONNACK && connack[1] == 2 &&
+            connack[3] != MQTT_CONNECT_UNAVAILABLE;
+        if (up) {
+            recordRtt(this->probeBroker,millis()-this->probeSentAt);
+            b->failed = false;
+            if (connack[3] == 0) {
+                uint8_t disconnect[] = {MQTTDISCONNECT,0x00};
+                this->probeClient->write(disconnect,2);
+            }
+        } else {
+            b->failed = true;
+            b->failedAt = t;
+        }
+        endProbe();
+        return up;
+    }
+    if (t - this->probeSentAt >= MQTT_SOCKET_TIMEOUT*1000UL || !this->probeClient->connected()) {
+        b->failed = true;
+        b->failedAt = t;
+        endProbe();
+    }
+    return false;
+}
+
+void PubSubClient::endProbe() {
+    if (this->probeClient && this->probeBroker >= 0) {
+        this->probeClient->stop();
+    }
+    this->probeBroker = -1;
+}
+
+int8_t PubSubClient::server() {
+    return this->currentBroker;
+}
+
+uint16_t PubSubClient::serverRtt(uint8_t index) {
+    if (index >= this->brokerCount) {
+        return 0;
+    }
+    return this->brokers[index].rtt;
 }
@@ -41,6 +41,29 @@
 //  pass the entire MQTT packet in each write call.
 //#define MQTT_MAX_TRANSFER_SIZE 80
 
+// MQTT_RX_BURST : maximum number of packets loop() reads per call once a
+//  receive queue has been attached with setReceiveQueue(). Without a queue
+//  loop() handles a single packet per call.
+#ifndef MQTT_RX_BURST
+#define MQTT_RX_BURST 8
+#endif
+
+// MQTT_MAX_BROKERS : number of servers that can be registered with addServer()
+#ifndef MQTT_MAX_BROKERS
+#define MQTT_MAX_BROKERS 3
+#endif
+
+// MQTT_BROKER_RETRY : seconds a server that failed is passed over by connect()
+#ifndef MQTT_BROKER_RETRY
+#define MQTT_BROKER_RETRY 60
+#endif
+
+// MQTT_BROKER_FAILBACK : seconds between probes, while connected, of the
+//  other servers through the client given to setProbeClient()
+#ifndef MQTT_BROKER_FAILBACK
+#define MQTT_BROKER_FAILBACK 300
+#endif
+
 // Possible values for client.state()
 #define MQTT_CONNECTION_TIMEOUT     -4
 #define MQTT_CONNECTION_LOST        -3
@@ -80,25 +103,49 @@
 #define MQTT_CALLBACK_SIGNATURE void (*callback)(char*, uint8_t*, unsigned int)
 #endif
 
-class PubSubClient {
+#include "PubSubClientCore.h"
+
+class PubSubClient : public PubSubClientCore<PubSubClient, Client, MQTT_MAX_PACKET_SIZE> {
 private:
-   Client* _client;
-   uint8_t buffer[MQTT_MAX_PACKET_SIZE];
-   uint16_t nextMsgId;
-   unsigned long lastOutActivity;
-   unsigned long lastInActivity;
-   bool pingOutstanding;
+   friend class PubSubClientCore<PubSubClient, Client, MQTT_MAX_PACKET_SIZE>;
+   struct Broker {
+      IPAddress ip;
+      const char* domain;
+      uint16_t port;
+      uint16_t rtt;              // smoothed round trip time in ms, 0 until measured
+      bool failed;
+      unsigned long failedAt;
+   };
    MQTT_CALLBACK_SIGNATURE;
-   uint16_t readPacket(uint8_t*);
-   boolean readByte(uint8_t * result);
-   boolean readByte(uint8_t * result, uint16_t * index);
    boolean write(uint8_t header, uint8_t* buf, uint16_t length);
-   uint16_t writeString(const char* string, uint8_t* buf, uint16_t pos);
-   IPAddress ip;
-   const char* domain;
-   uint16_t port;
-   Stream* stream;
-   int _state;
+   boolean sendQueued();
+   boolean deliver(char* topic, uint8_t* payload, unsigned int length);
+   void discardQueued();
+   boolean connectServer(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage);
+   int8_t selectBroker();
+   void recordRtt(int8_t broker, unsigned long rtt);
+   boolean probe(unsigned long t);
+   void endProbe();
+   boolean enqueue(const char* topic, uint16_t tlength, const uint8_t* payload, uint16_t plength);
+   uint8_t* rxQueue;
+   uint16_t rxQueueSize;
+   uint16_t rxHead;
+   uint16_t rxTail;
+   uint16_t rxCount;
+   uint16_t rxDropped;
+   uint8_t* txQueue;
+   uint16_t txQueueSize;
+   uint16_t txHead;
+   uint16_t txLength;
+   uint32_t txDiscarded;
+   Broker brokers[MQTT_MAX_BROKERS];
+   uint8_t brokerCount;
+   int8_t currentBroker;
+   unsigned long brokerCheckedAt;
+   Client* probeClient;
+   int8_t probeBroker;
+   uint8_t probeNext;
+   unsigned long probeSentAt;
 public:
    PubSubClient();
    PubSubClient(Client& client);
@@ -115,29 +162,36 @@ public:
    PubSubClient(const char*, uint16_t, MQTT_CALLBACK_SIGNATURE,Client& client);
    PubSubClient(const char*, uint16_t, MQTT_CALLBACK_SIGNATURE,Client& client, Stream&);
 
-   PubSubClient& setServer(IPAddress ip, uint16_t port);
-   PubSubClient& setServer(uint8_t * ip, uint16_t port);
-   PubSubClient& setServer(const char * domain, uint16_t port);
+   // Servers added here, in order of preference, replace the one given to
+   // setServer(). connect() picks the first healthy one, or a measurably
+   // faster one, and fails over to the next when a connection fails.
+   PubSubClient& addServer(IPAddress ip, uint16_t port);
+   PubSubClient& addServer(uint8_t * ip, uint16_t port);
+   PubSubClient& addServer(const char * domain, uint16_t port);
+   PubSubClient& clearServers();
+   // A second network client, used to probe the other servers while this
+   // one is connected. Only a server that answers a probe is moved over to.
+   PubSubClient& setProbeClient(Client& client);
    PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
    PubSubClient& setClient(Client& client);
    PubSubClient& setStream(Stream& stream);
+   PubSubClient& setReceiveQueue(uint8_t* queue, uint16_t size);
+   PubSubClient& setSendQueue(uint8_t* queue, uint16_t size);
 
-   boolean connect(const char* id);
-   boolean connect(const char* id, const char* user, const char* pass);
-   boolean connect(const char* id, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage);
+   // setServer(), the other connect() calls, publish(), subscribe(),
+   // unsubscribe(), connected() and state() come from PubSubClientCore
+   using PubSubClientCore<PubSubClient, Client, MQTT_MAX_PACKET_SIZE>::connect;
    boolean connect(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage);
    void disconnect();
-   boolean publish(const char* topic, const char* payload);
-   boolean publish(const char* topic, const char* payload, boolean retained);
-   boolean publish(const char* topic, const uint8_t * payload, unsigned int plength);
-   boolean publish(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained);
    boolean publish_P(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained);
-   boolean subscribe(const char* topic);
-   boolean subscribe(const char* topic, uint8_t qos);
-   boolean unsubscribe(const char* topic);
    boolean loop();
-   boolean connected();
-   int state();
+   boolean dispatch();
+   uint16_t queued();
+   uint16_t dropped();
+   uint16_t pending();
+   uint32_t discarded();
+   int8_t server();
+   uint16_t serverRtt(uint8_t index);
 };
 
 
@@ -0,0 +1,450 @@
+/*
+ PubSubClientCore.h - The MQTT protocol code shared by PubSubClient and
+  BasicPubSubClient.
+
+  PubSubClientCore<Derived, Transport, BufferSize> reads, builds and frames
+  packets, runs the CONNECT handshake and the keepalive, and implements the
+  calls both clients have in common. Derived is the client class itself; the
+  core calls three of its members, so that each client decides how packets
+  go out and where inbound messages go:
+
+   boolean write(uint8_t header, uint8_t* buf, uint16_t length)
+      sends a packet whose variable part starts at buf[5], see frame()
+   boolean sendQueued()
+      pushes out whatever write() left unsent; true once nothing is left
+   boolean deliver(char* topic, uint8_t* payload, unsigned int length)
+      hands an inbound message over; false withholds the PUBACK of a QoS 1
+      message
+
+  Include PubSubClient.h rather than this file; it uses the settings there.
+*/
+
+#ifndef PubSubClientCore_h
+#define PubSubClientCore_h
+
+template <class Derived, class Transport, uint16_t BufferSize>
+class PubSubClientCore {
+protected:
+   Transport* _client;
+   uint8_t buffer[BufferSize];
+   uint16_t nextMsgId;
+   unsigned long lastOutActivity;
+   unsigned long lastInActivity;
+   unsigned long pingSentAt;
+   bool pingOutstanding;
+   IPAddress ip;
+   const char* domain;
+   uint16_t port;
+   Stream* stream;
+   int _state;
+
+   PubSubClientCore() {
+      this->_client = NULL;
+      this->domain = NULL;
+      this->port = 0;
+      this->stream = NULL;
+      this->_state = MQTT_DISCONNECTED;
+   }
+
+   Derived& self() {
+      return *static_cast<Derived*>(this);
+   }
+
+   // reads a byte into result
+   boolean readByte(uint8_t * result) {
+      uint32_t previousMillis = millis();
+      while(!_client->available()) {
+         uint32_t currentMillis = millis();
+         if(currentMillis - previousMillis >= ((int32_t) MQTT_SOCKET_TIMEOUT * 1000)){
+            return false;
+         }
+      }
+      *result = _client->read();
+      return true;
+   }
+
+   // reads a byte into result[*index] and increments index
+   boolean readByte(uint8_t * result, uint16_t * index) {
+      uint16_t current_index = *index;
+      uint8_t * write_address = &(result[current_index]);
+      if(readByte(write_address)){
+         *index = current_index + 1;
+         return true;
+      }
+      return false;
+   }
+
+   uint16_t readPacket(uint8_t* lengthLength) {
+      uint16_t len = 0;
+      if(!readByte(buffer, &len)) return 0;
+      bool isPublish = (buffer[0]&0xF0) == MQTTPUBLISH;
+      uint32_t multiplier = 1;
+      uint16_t length = 0;
+      uint8_t digit = 0;
+      uint16_t skip = 0;
+      uint8_t start = 0;
+
+      do {
+         if(!readByte(&digit)) return 0;
+         buffer[len++] = digit;
+         length += (digit & 127) * multiplier;
+         multiplier *= 128;
+      } while ((digit & 128) != 0);
+      *lengthLength = len-1;
+
+      if (isPublish) {
+         // Read in topic length to calculate bytes to skip over for Stream writing
+         if(!readByte(buffer, &len)) return 0;
+         if(!readByte(buffer, &len)) return 0;
+         skip = (buffer[*lengthLength+1]<<8)+buffer[*lengthLength+2];
+         start = 2;
+         if (buffer[0]&MQTTQOS1) {
+            // skip message id
+            skip += 2;
+         }
+      }
+
+      for (uint16_t i = start;i<length;i++) {
+         if(!readByte(&digit)) return 0;
+         if (this->stream) {
+            if (isPublish && len-*lengthLength-2>skip) {
+               this->stream->write(digit);
+            }
+         }
+         if (len < BufferSize) {
+            buffer[len] = digit;
+         }
+         len++;
+      }
+
+      if (!this->stream && len > BufferSize) {
+         len = 0; // This will cause the packet to be ignored.
+      }
+
+      return len;
+   }
+
+   // Puts the fixed header of a packet, whose variable part of length bytes
+   // starts at buf[5], in front of it; returns the offset of the packet in buf
+   uint8_t frame(uint8_t header, uint8_t* buf, uint16_t length) {
+      uint8_t lenBuf[4];
+      uint8_t llen = 0;
+      uint8_t digit;
+      uint16_t len = length;
+      do {
+         digit = len % 128;
+         len = len / 128;
+         if (len > 0) {
+            digit |= 0x80;
+         }
+         lenBuf[llen++] = digit;
+      } while(len>0);
+
+      buf[4-llen] = header;
+      for (int i=0;i<llen;i++) {
+         buf[5-llen+i] = lenBuf[i];
+      }
+      return 4-llen;
+   }
+
+   // Writes a framed packet straight to the transport
+   boolean send(const uint8_t* packet, uint16_t length) {
+#ifdef MQTT_MAX_TRANSFER_SIZE
+      uint16_t bytesRemaining = length;
+      uint8_t bytesToWrite;
+      boolean result = true;
+      while((bytesRemaining > 0) && result) {
+         bytesToWrite = (bytesRemaining > MQTT_MAX_TRANSFER_SIZE)?MQTT_MAX_TRANSFER_SIZE:bytesRemaining;
+         uint16_t rc = _client->write(packet,bytesToWrite);
+         result = (rc == bytesToWrite);
+         bytesRemaining -= rc;
+         packet += rc;
+      }
+      lastOutActivity = millis();
+      return result;
+#else
+      uint16_t rc = _client->write(packet,length);
+      lastOutActivity = millis();
+      return (rc == length);
+#endif
+   }
+
+   static uint16_t writeString(const char* string, uint8_t* buf, uint16_t pos) {
+      const char* idp = string;
+      uint16_t i = 0;
+      pos += 2;
+      while (*idp) {
+         buf[pos++] = *idp++;
+         i++;
+      }
+      buf[pos-i-2] = (i >> 8);
+      buf[pos-i-1] = (i & 0xFF);
+      return pos;
+   }
+
+   // Connects the transport to the server given to setServer()
+   boolean open() {
+      int result;
+      if (domain != NULL) {
+         result = _client->connect(this->domain, this->port);
+      } else {
+         result = _client->connect(this->ip, this->port);
+      }
+      if (result != 1) {
+         _state = MQTT_CONNECT_FAILED;
+         return false;
+      }
+      return true;
+   }
+
+   // Sends CONNECT over the open transport and waits up to
+   // MQTT_SOCKET_TIMEOUT seconds for the CONNACK
+   boolean handshake(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage) {
+      nextMsgId = 1;
+      // Leave room in the buffer for header and variable length field
+      uint16_t length = 5;
+#if MQTT_VERSION == MQTT_VERSION_3_1
+      const uint8_t d[9] = {0x00,0x06,'M','Q','I','s','d','p', MQTT_VERSION};
+#else
+      const uint8_t d[7] = {0x00,0x04,'M','Q','T','T',MQTT_VERSION};
+#endif
+      for (unsigned int j = 0;j<sizeof(d);j++) {
+         buffer[length++] = d[j];
+      }
+
+      uint8_t v;
+      if (willTopic) {
+         v = 0x06|(willQos<<3)|(willRetain<<5);
+      } else {
+         v = 0x02;
+      }
+      if(user != NULL) {
+         v = v|0x80;
+         if(pass != NULL) {
+            v = v|(0x80>>1);
+         }
+      }
+      buffer[length++] = v;
+
+      buffer[length++] = ((MQTT_KEEPALIVE) >> 8);
+      buffer[length++] = ((MQTT_KEEPALIVE) & 0xFF);
+      length = writeString(id,buffer,length);
+      if (willTopic) {
+         length = writeString(willTopic,buffer,length);
+         length = writeString(willMessage,buffer,length);
+      }
+      if(user != NULL) {
+         length = writeString(user,buffer,length);
+         if(pass != NULL) {
+            length = writeString(pass,buffer,length);
+         }
+      }
+
+      self().write(MQTTCONNECT,buffer,length-5);
+
+      lastInActivity = lastOutActivity = millis();
+
+      while (!_client->available()) {
+         self().sendQueued();
+         unsigned long t = millis();
+         if (t-lastInActivity >= ((int32_t) MQTT_SOCKET_TIMEOUT*1000UL)) {
+            _state = MQTT_CONNECTION_TIMEOUT;
+            _client->stop();
+            return false;
+         }
+      }
+      uint8_t llen;
+      uint16_t len = readPacket(&llen);
+
+      if (len == 4) {
+         if (buffer[3] == 0) {
+            lastInActivity = millis();
+            pingOutstanding = false;
+            _state = MQTT_CONNECTED;
+            return true;
+         } else {
+            _state = buffer[3];
+         }
+      }
+      _client->stop();
+      return false;
+   }
+
+   // Pings the server once the connection has been quiet for MQTT_KEEPALIVE
+   // seconds. Returns false, with the connection closed, when the ping goes
+   // unanswered, or write() has had no room for it for twice as long.
+   boolean keepAlive(unsigned long t) {
+      if ((t - lastInActivity > MQTT_KEEPALIVE*1000UL) || (t - lastOutActivity > MQTT_KEEPALIVE*1000UL)) {
+         if (!pingOutstanding && self().write(MQTTPINGREQ,buffer,0)) {
+            pingSentAt = t;
+            lastOutActivity = t;
+            lastInActivity = t;
+            pingOutstanding = true;
+         } else if (pingOutstanding || t - lastInActivity > 2*MQTT_KEEPALIVE*1000UL) {
+            this->_state = MQTT_CONNECTION_TIMEOUT;
+            _client->stop();
+            return false;
+         }
+      }
+      return true;
+   }
+
+   // Reads and handles one inbound packet; returns its type, or 0 if no
+   // packet could be read
+   uint8_t handlePacket(unsigned long t) {
+      uint8_t llen;
+      uint16_t len = readPacket(&llen);
+      if (len == 0) {
+         return 0;
+      }
+      lastInActivity = t;
+      uint8_t type = buffer[0]&0xF0;
+      if (type == MQTTPUBLISH) {
+         uint16_t tl = (buffer[llen+1]<<8)+buffer[llen+2]; /* topic length in bytes */
+         memmove(buffer+llen+2,buffer+llen+3,tl); /* move topic inside buffer 1 byte to front */
+         buffer[llen+2+tl] = 0; /* end the topic as a 'C' string with \x00 */
+         char *topic = (char*) buffer+llen+2;
+         // msgId only present for QOS>0
+         if ((buffer[0]&0x06) == MQTTQOS1) {
+            uint16_t msgId = (buffer[llen+3+tl]<<8)+buffer[llen+3+tl+1];
+            if (self().deliver(topic,buffer+llen+3+tl+2,len-llen-3-tl-2)) {
+               buffer[5] = (msgId >> 8);
+               buffer[6] = (msgId & 0xFF);
+               self().write(MQTTPUBACK,buffer,2);
+               lastOutActivity = t;
+            }
+         } else {
+            self().deliver(topic,buffer+llen+3+tl,len-llen-3-tl);
+         }
+      } else if (type == MQTTPINGREQ) {
+         self().write(MQTTPINGRESP,buffer,0);
+      } else if (type == MQTTPINGRESP) {
+         pingOutstanding = false;
+      }
+      return type;
+   }
+
+public:
+   Derived& setServer(IPAddress ip, uint16_t port) {
+      this->ip = ip;
+      this->port = port;
+      this->domain = NULL;
+      return self();
+   }
+   Derived& setServer(uint8_t * ip, uint16_t port) {
+      IPAddress addr(ip[0],ip[1],ip[2],ip[3]);
+      return setServer(addr,port);
+   }
+   Derived& setServer(const char * domain, uint16_t port) {
+      this->domain = domain;
+      this->port = port;
+      return self();
+   }
+
+   boolean connect(const char* id) {
+      return self().connect(id,NULL,NULL,0,0,0,0);
+   }
+   boolean connect(const char* id, const char* user, const char* pass) {
+      return self().connect(id,user,pass,0,0,0,0);
+   }
+   boolean connect(const char* id, const char* willTopic, uint8_t willQos, boolean willRetain, const char* willMessage) {
+      return self().connect(id,NULL,NULL,willTopic,willQos,willRetain,willMessage);
+   }
+
+   boolean publish(const char* topic, const char* payload) {
+      return publish(topic,(const uint8_t*)payload,strlen(payload),false);
+   }
+   boolean publish(const char* topic, const char* payload, boolean retained) {
+      return publish(topic,(const uint8_t*)payload,strlen(payload),retained);
+   }
+   boolean publish(const char* topic, const uint8_t * payload, unsigned int plength) {
+      return publish(topic,payload,plength,false);
+   }
+   boolean publish(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained) {
+      if (!connected()) {
+         return false;
+      }
+      if (BufferSize < 5 + 2+strlen(topic) + plength) {
+         // Too long
+         return false;
+      }
+      // Leave room in the buffer for header and variable length field
+      uint16_t length = writeString(topic,buffer,5);
+      memcpy(buffer+length,payload,plength);
+      length += plength;
+      uint8_t header = MQTTPUBLISH;
+      if (retained) {
+         header |= 1;
+      }
+      return self().write(header,buffer,length-5);
+   }
+
+   boolean subscribe(const char* topic) {
+      return subscribe(topic, 0);
+   }
+   boolean subscribe(const char* topic, uint8_t qos) {
+      if (qos > 1) {
+         return false;
+      }
+      if (BufferSize < 9 + strlen(topic)) {
+         // Too long
+         return false;
+      }
+      if (!connected()) {
+         return false;
+      }
+      // Leave room in the buffer for header and variable length field
+      uint16_t length = 5;
+      nextMsgId++;
+      if (nextMsgId == 0) {
+         nextMsgId = 1;
+      }
+      buffer[length++] = (nextMsgId >> 8);
+      buffer[length++] = (nextMsgId & 0xFF);
+      length = writeString(topic,buffer,length);
+      buffer[length++] = qos;
+      return self().write(MQTTSUBSCRIBE|MQTTQOS1,buffer,length-5);
+   }
+
+   boolean unsubscribe(const char* topic) {
+      if (BufferSize < 9 + strlen(topic)) {
+         // Too long
+         return false;
+      }
+      if (!connected()) {
+         return false;
+      }
+      uint16_t length = 5;
+      nextMsgId++;
+      if (nextMsgId == 0) {
+         nextMsgId = 1;
+      }
+      buffer[length++] = (nextMsgId >> 8);
+      buffer[length++] = (nextMsgId & 0xFF);
+      length = writeString(topic,buffer,length);
+      return self().write(MQTTUNSUBSCRIBE|MQTTQOS1,buffer,length-5);
+   }
+
+   boolean connected() {
+      boolean rc;
+      if (_client == NULL ) {
+         rc = false;
+      } else {
+         rc = (int)_client->connected();
+         if (!rc) {
+            if (this->_state == MQTT_CONNECTED) {
+               this->_state = MQTT_CONNECTION_LOST;
+               _client->flush();
+               _client->stop();
+            }
+         }
+      }
+      return rc;
+   }
+
+   int state() {
+      return this->_state;
+   }
+};
+
+#endif
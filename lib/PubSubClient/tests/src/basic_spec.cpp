@@ -0,0 +1,149 @@
+#include "BasicPubSubClient.h"
+#include "MemoryTransport.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+
+byte server[] = { 172, 16, 0, 2 };
+
+struct RecordingHandler {
+    bool* called;
+    char* topic;
+    unsigned int* length;
+    void operator()(char* t, uint8_t* payload, unsigned int l) {
+        *called = true;
+        strcpy(topic,t);
+        *length = l;
+    }
+};
+
+typedef BasicPubSubClient<MemoryTransport, MQTT_MAX_PACKET_SIZE, RecordingHandler> TestClient;
+
+bool handlerCalled;
+char handlerTopic[64];
+unsigned int handlerLength;
+
+RecordingHandler handler() {
+    RecordingHandler h = { &handlerCalled, handlerTopic, &handlerLength };
+    handlerCalled = false;
+    handlerTopic[0] = '\0';
+    handlerLength = 0;
+    return h;
+}
+
+int test_basic_connect() {
+    IT("sends the same connect packet as PubSubClient");
+    MemoryTransport transport;
+    byte connect[] = {0x10,0x18,0x0,0x4,0x4d,0x51,0x54,0x54,0x4,0x2,0x0,0xf,0x0,0xc,0x63,0x6c,0x69,0x65,0x6e,0x74,0x5f,0x74,0x65,0x73,0x74,0x31};
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    transport.respond(connack,4);
+
+    TestClient client(transport, handler());
+    client.setServer(server,1883);
+    IS_TRUE(client.state() == MQTT_DISCONNECTED);
+
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    IS_TRUE(client.state() == MQTT_CONNECTED);
+    IS_TRUE(transport.sentLength == 26);
+    IS_TRUE(memcmp(transport.sent,connect,26) == 0);
+
+    END_IT
+}
+
+int test_basic_connect_refused() {
+    IT("reports the connack return code");
+    MemoryTransport transport;
+    byte connack[] = { 0x20, 0x02, 0x00, 0x05 };
+    transport.respond(connack,4);
+
+    TestClient client(transport, handler());
+    client.setServer(server,1883);
+    int rc = client.connect((char*)"client_test1");
+    IS_FALSE(rc);
+    IS_TRUE(client.state() == MQTT_CONNECT_UNAUTHORIZED);
+
+    END_IT
+}
+
+int test_basic_publish() {
+    IT("publishes a null-terminated string");
+    MemoryTransport transport;
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    transport.respond(connack,4);
+
+    TestClient client(transport, handler());
+    client.setServer(server,1883);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    transport.clear();
+    byte publish[] = {0x31,0xe,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    rc = client.publish((char*)"topic",(char*)"payload",true);
+    IS_TRUE(rc);
+    IS_TRUE(transport.sentLength == 16);
+    IS_TRUE(memcmp(transport.sent,publish,16) == 0);
+
+    END_IT
+}
+
+int test_basic_subscribe() {
+    IT("subscribes to a topic at qos 1");
+    MemoryTransport transport;
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    transport.respond(connack,4);
+
+    TestClient client(transport, handler());
+    client.setServer(server,1883);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    transport.clear();
+    byte subscribe[] = { 0x82,0xa,0x0,0x2,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x1 };
+    rc = client.subscribe((char*)"topic",1);
+    IS_TRUE(rc);
+    IS_TRUE(transport.sentLength == 12);
+    IS_TRUE(memcmp(transport.sent,subscribe,12) == 0);
+
+    END_IT
+}
+
+int test_basic_receive_qos1() {
+    IT("calls the handler and acknowledges a qos1 message");
+    MemoryTransport transport;
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    transport.respond(connack,4);
+
+    TestClient client(transport, handler());
+    client.setServer(server,1883);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    transport.clear();
+    byte publish[] = {0x32,0x10,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x12,0x34,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    transport.respond(publish,18);
+    rc = client.loop();
+    IS_TRUE(rc);
+
+    IS_TRUE(handlerCalled);
+    IS_TRUE(strcmp(handlerTopic,"topic") == 0);
+    IS_TRUE(handlerLength == 7);
+
+    byte puback[] = {0x40,0x2,0x12,0x34};
+    IS_TRUE(transport.sentLength == 4);
+    IS_TRUE(memcmp(transport.sent,puback,4) == 0);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("BasicPubSubClient");
+    test_basic_connect();
+    test_basic_connect_refused();
+    test_basic_publish();
+    test_basic_subscribe();
+    test_basic_receive_qos1();
+
+    FINISH
+}
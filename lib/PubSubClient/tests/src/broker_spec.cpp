@@ -0,0 +1,322 @@
+#include "PubSubClient.h"
+#include "ShimClient.h"
+#include "Buffer.h"
+#include "BDDTest.h"
+#include "trace.h"
+#include <unistd.h>
+
+
+byte server[] = { 172, 16, 0, 2 };
+
+void callback(char* topic, byte* payload, unsigned int length) {
+  // handle message arrived
+}
+
+
+int test_broker_fails_over() {
+    IT("connects to the next server when the first refuses");
+    ShimClient shimClient;
+    shimClient.refuseHost("primary");
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(shimClient);
+    client.addServer("primary",1883).addServer("secondary",1883);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    IS_TRUE(client.server() == 1);
+    IS_TRUE(client.state() == MQTT_CONNECTED);
+
+    END_IT
+}
+
+int test_broker_skips_failed() {
+    IT("does not retry a server that recently failed");
+    ShimClient shimClient;
+    shimClient.refuseHost("primary");
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(shimClient);
+    client.addServer("primary",1883).addServer("secondary",1883);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    client.disconnect();
+
+    // Any connect to "primary" would now be a host mismatch
+    shimClient.refuseHost(NULL);
+    shimClient.expectConnect("secondary",1883);
+    shimClient.respond(connack,4);
+    rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    IS_FALSE(shimClient.error());
+    IS_TRUE(client.server() == 1);
+
+    END_IT
+}
+
+int test_broker_all_fail() {
+    IT("fails when every server refuses");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(false);
+
+    PubSubClient client(shimClient);
+    client.addServer(server,1883).addServer("secondary",1883);
+    int rc = client.connect((char*)"client_test1");
+    IS_FALSE(rc);
+    IS_TRUE(client.state() == MQTT_CONNECT_FAILED);
+
+    END_IT
+}
+
+int test_broker_measures_rtt() {
+    IT("measures the round trip time of the connected server");
+    ShimClient shimClient;
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(shimClient);
+    client.addServer("primary",1883).addServer("secondary",1883);
+    IS_TRUE(client.serverRtt(0) == 0);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    IS_TRUE(client.server() == 0);
+    IS_TRUE(client.serverRtt(0) > 0);
+    IS_TRUE(client.serverRtt(1) == 0);
+
+    END_IT
+}
+
+int test_broker_set_server_unchanged() {
+    IT("uses setServer() when no servers are added");
+    ShimClient shimClient;
+    shimClient.expectConnect("localhost",1883);
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client("localhost",1883,callback,shimClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    IS_FALSE(shimClient.error());
+    IS_TRUE(client.server() == -1);
+
+    END_IT
+}
+
+int test_broker_stays_without_probe() {
+    IT("stays on a working server when no probe client is set");
+    ShimClient shimClient;
+    shimClient.refuseHost("primary");
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(shimClient);
+    client.addServer("primary",1883).addServer("secondary",1883);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    IS_TRUE(client.server() == 1);
+
+    shimClient.refuseHost(NULL);
+    sleep(MQTT_BROKER_FAILBACK+1);
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(client.connected());
+    IS_TRUE(client.server() == 1);
+
+    END_IT
+}
+
+int test_broker_keeps_server_when_probe_fails() {
+    IT("keeps the working server while the preferred one does not answer");
+    ShimClient shimClient;
+    shimClient.refuseHost("primary");
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    ShimClient probeClient;
+    probeClient.refuseHost("primary");
+
+    PubSubClient client(shimClient);
+    client.addServer("primary",1883).addServer("secondary",1883);
+    client.setProbeClient(probeClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    IS_TRUE(client.server() == 1);
+
+    sleep(MQTT_BROKER_FAILBACK+1);
+    rc = client.loop();
+    IS_TRUE(rc);
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(client.connected());
+    IS_TRUE(client.server() == 1);
+    IS_TRUE(client.serverRtt(0) == 0);
+
+    END_IT
+}
+
+int test_broker_fails_back_after_probe() {
+    IT("moves back to the preferred server once it answers a probe");
+    ShimClient shimClient;
+    shimClient.refuseHost("primary");
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    ShimClient probeClient;
+    probeClient.expectConnect("primary",1883);
+    byte probe[] = { 0x10,0x0c,0x00,0x04,0x4d,0x51,0x54,0x54,0x04,0x02,0x00,0x0f,0x00,0x00 };
+    byte probeDisconnect[] = { 0xE0,0x00 };
+    probeClient.expect(probe,14);
+    probeClient.expect(probeDisconnect,2);
+
+    PubSubClient client(shimClient);
+    client.addServer("primary",1883).addServer("secondary",1883);
+    client.setProbeClient(probeClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    IS_TRUE(client.server() == 1);
+
+    sleep(MQTT_BROKER_FAILBACK+1);
+    // Sends the probe, and keeps the connection while it is unanswered
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(client.connected());
+    IS_FALSE(probeClient.error());
+
+    probeClient.respond(connack,4);
+    rc = client.loop();
+    IS_FALSE(rc);
+    IS_FALSE(client.connected());
+    IS_TRUE(client.serverRtt(0) > 0);
+    IS_FALSE(probeClient.error());
+    IS_FALSE(probeClient.connected());
+
+    shimClient.refuseHost(NULL);
+    shimClient.expectConnect("primary",1883);
+    shimClient.respond(connack,4);
+    rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    IS_TRUE(client.server() == 0);
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_broker_fails_back_when_probe_unauthorized() {
+    IT("moves back to the preferred server when it refuses the anonymous probe");
+    ShimClient shimClient;
+    shimClient.refuseHost("primary");
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    ShimClient probeClient;
+    probeClient.expectConnect("primary",1883);
+    byte probe[] = { 0x10,0x0c,0x00,0x04,0x4d,0x51,0x54,0x54,0x04,0x02,0x00,0x0f,0x00,0x00 };
+    probeClient.expect(probe,14);
+
+    PubSubClient client(shimClient);
+    client.addServer("primary",1883).addServer("secondary",1883);
+    client.setProbeClient(probeClient);
+    int rc = client.connect((char*)"client_test1","user","pass");
+    IS_TRUE(rc);
+    IS_TRUE(client.server() == 1);
+
+    sleep(MQTT_BROKER_FAILBACK+1);
+    rc = client.loop();
+    IS_TRUE(rc);
+
+    // Not authorized: the server is up, and there is no session to end
+    byte unauthorized[] = { 0x20, 0x02, 0x00, 0x05 };
+    probeClient.respond(unauthorized,4);
+    rc = client.loop();
+    IS_FALSE(rc);
+    IS_TRUE(client.serverRtt(0) > 0);
+    IS_FALSE(probeClient.error());
+
+    shimClient.refuseHost(NULL);
+    shimClient.expectConnect("primary",1883);
+    shimClient.respond(connack,4);
+    rc = client.connect((char*)"client_test1","user","pass");
+    IS_TRUE(rc);
+    IS_TRUE(client.server() == 0);
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_broker_keeps_server_when_probe_unavailable() {
+    IT("keeps the working server while the preferred one says it is unavailable");
+    ShimClient shimClient;
+    shimClient.refuseHost("primary");
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    ShimClient probeClient;
+    byte unavailable[] = { 0x20, 0x02, 0x00, 0x03 };
+
+    PubSubClient client(shimClient);
+    client.addServer("primary",1883).addServer("secondary",1883);
+    client.setProbeClient(probeClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    sleep(MQTT_BROKER_FAILBACK+1);
+    rc = client.loop();
+    IS_TRUE(rc);
+    probeClient.respond(unavailable,4);
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(client.connected());
+    IS_TRUE(client.server() == 1);
+    IS_TRUE(client.serverRtt(0) == 0);
+
+    END_IT
+}
+
+int test_broker_probes_idle_server() {
+    IT("measures the round trip time of an idle server");
+    ShimClient shimClient;
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    ShimClient probeClient;
+    probeClient.expectConnect("secondary",1883);
+    probeClient.respond(connack,4);
+
+    PubSubClient client(shimClient);
+    client.addServer("primary",1883).addServer("secondary",1883);
+    client.setProbeClient(probeClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    IS_TRUE(client.server() == 0);
+    IS_TRUE(client.serverRtt(1) == 0);
+
+    sleep(MQTT_BROKER_FAILBACK+1);
+    rc = client.loop();
+    IS_TRUE(rc);
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(client.connected());
+    IS_TRUE(client.server() == 0);
+    IS_TRUE(client.serverRtt(1) > 0);
+    IS_FALSE(probeClient.error());
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("Broker");
+    test_broker_fails_over();
+    test_broker_skips_failed();
+    test_broker_all_fail();
+    test_broker_measures_rtt();
+    test_broker_set_server_unchanged();
+    test_broker_stays_without_probe();
+    test_broker_keeps_server_when_probe_fails();
+    test_broker_fails_back_after_probe();
+    test_broker_fails_back_when_probe_unauthorized();
+    test_broker_keeps_server_when_probe_unavailable();
+    test_broker_probes_idle_server();
+    FINISH
+}
@@ -172,6 +172,86 @@ int test_keepalive_disconnects_hung() {
     END_IT
 }
 
+int test_keepalive_ping_waits_for_send_queue() {
+    IT("sends the ping once the full send queue drains (takes 16 seconds)");
+
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    uint8_t queue[16];
+    PubSubClient client(server, 1883, callback, shimClient);
+    client.setSendQueue(queue,sizeof(queue));
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte publish[] = {0x30,0xe,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.setWriteLimit(0);
+    rc = client.publish((char*)"topic",(char*)"payload");
+    IS_TRUE(rc);
+    IS_TRUE(client.pending() == 16);
+
+    sleep(16);
+
+    // No room for the ping: the connection is busy, not dead
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(client.pending() == 16);
+
+    byte pingreq[] = { 0xC0,0x0 };
+    shimClient.expect(publish,16);
+    shimClient.expect(pingreq,2);
+    byte pingresp[] = { 0xD0,0x0 };
+    shimClient.respond(pingresp,2);
+    shimClient.setWriteLimit(-1);
+
+    uint16_t sent = shimClient.received();
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(client.pending() == 0);
+    IS_TRUE(shimClient.received() - sent == 18);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_keepalive_disconnects_stuck_send_queue() {
+    IT("disconnects when the send queue never drains (takes 31 seconds)");
+
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    uint8_t queue[16];
+    PubSubClient client(server, 1883, callback, shimClient);
+    client.setSendQueue(queue,sizeof(queue));
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    shimClient.setWriteLimit(0);
+    rc = client.publish((char*)"topic",(char*)"payload");
+    IS_TRUE(rc);
+
+    for (int i = 0; i < 31; i++) {
+        sleep(1);
+        rc = client.loop();
+        if (!rc) {
+            break;
+        }
+    }
+    IS_FALSE(rc);
+
+    int state = client.state();
+    IS_TRUE(state == MQTT_CONNECTION_TIMEOUT);
+
+    END_IT
+}
+
 int main()
 {
     SUITE("Keep-alive");
@@ -180,6 +260,8 @@ int main()
     test_keepalive_pings_with_inbound_qos0();
     test_keepalive_no_pings_inbound_qos1();
     test_keepalive_disconnects_hung();
+    test_keepalive_ping_waits_for_send_queue();
+    test_keepalive_disconnects_stuck_send_queue();
 
     FINISH
 }
@@ -11,6 +11,10 @@ bool Buffer::available() {
     return this->pos < this->length;
 }
 
+uint16_t Buffer::remaining() {
+    return this->length - this->pos;
+}
+
 uint8_t Buffer::next() {
     if (this->available()) {
         return this->buffer[this->pos++];
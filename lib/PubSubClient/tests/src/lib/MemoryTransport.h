@@ -0,0 +1,70 @@
+#ifndef memorytransport_h
+#define memorytransport_h
+
+#include "Arduino.h"
+#include "Client.h"
+#include "IPAddress.h"
+
+// A concrete, non-virtual in-memory network client. Bytes queued with
+// respond() are returned by read(); bytes written are kept in sent[].
+class MemoryTransport {
+public:
+    uint8_t inbound[1024];
+    uint16_t inPos;
+    uint16_t inLength;
+    uint8_t sent[1024];
+    uint16_t sentLength;
+    bool _connected;
+
+    MemoryTransport() : inPos(0), inLength(0), sentLength(0), _connected(false) {}
+
+    int connect(IPAddress ip, uint16_t port) { _connected = true; return 1; }
+    int connect(const char *host, uint16_t port) { _connected = true; return 1; }
+    size_t write(uint8_t b) { return write(&b,1); }
+    size_t write(const uint8_t *buf, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            sent[sentLength++ % sizeof(sent)] = buf[i];
+        }
+        return size;
+    }
+    int available() { return inLength - inPos; }
+    int read() { return inPos < inLength ? inbound[inPos++] : -1; }
+    void flush() {}
+    void stop() { _connected = false; }
+    uint8_t connected() { return _connected; }
+
+    void respond(const uint8_t *buf, size_t size) {
+        if (inPos == inLength) {
+            inPos = inLength = 0;
+        }
+        memcpy(inbound+inLength,buf,size);
+        inLength += size;
+    }
+    void clear() { sentLength = 0; }
+};
+
+// The same transport behind the virtual Client interface used by PubSubClient
+class MemoryClient : public Client {
+public:
+    MemoryTransport transport;
+
+    virtual int connect(IPAddress ip, uint16_t port) { return transport.connect(ip,port); }
+    virtual int connect(const char *host, uint16_t port) { return transport.connect(host,port); }
+    virtual size_t write(uint8_t b) { return transport.write(b); }
+    virtual size_t write(const uint8_t *buf, size_t size) { return transport.write(buf,size); }
+    virtual int available() { return transport.available(); }
+    virtual int read() { return transport.read(); }
+    virtual int read(uint8_t *buf, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            buf[i] = transport.read();
+        }
+        return size;
+    }
+    virtual int peek() { return 0; }
+    virtual void flush() { transport.flush(); }
+    virtual void stop() { transport.stop(); }
+    virtual uint8_t connected() { return transport.connected(); }
+    virtual operator bool() { return true; }
+};
+
+#endif
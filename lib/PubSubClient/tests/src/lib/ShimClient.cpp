@@ -19,6 +19,8 @@ ShimClient::ShimClient() {
     this->expectAnything = true;
     this->_received = 0;
     this->_expectedPort = 0;
+    this->_writeLimit = -1;
+    this->_refusedHost = NULL;
 }
 
 int ShimClient::connect(IPAddress ip, uint16_t port) {
@@ -38,6 +40,9 @@ int ShimClient::connect(IPAddress ip, uint16_t port) {
     return this->_connected;
 }
 int ShimClient::connect(const char *host, uint16_t port)  {
+    if (this->_refusedHost != NULL && strcmp(host,this->_refusedHost) == 0) {
+        return 0;
+    }
     if (this->_allowConnect) {
         this->_connected = true;
     }
@@ -55,6 +60,9 @@ int ShimClient::connect(const char *host, uint16_t port)  {
     return this->_connected;
 }
 size_t ShimClient::write(uint8_t b)  {
+    if (this->_writeLimit == 0) {
+        return 0;
+    }
     this->_received += 1;
     TRACE(std::hex << (unsigned int)b);
     if (!this->expectAnything) {
@@ -72,6 +80,9 @@ size_t ShimClient::write(uint8_t b)  {
     return 1;
 }
 size_t ShimClient::write(const uint8_t *buf, size_t size)  {
+    if (this->_writeLimit >= 0 && size > (size_t)this->_writeLimit) {
+        size = this->_writeLimit;
+    }
     this->_received += size;
     TRACE( "[" << std::dec << (unsigned int)(size) << "] ");
     uint16_t i=0;
@@ -97,7 +108,7 @@ size_t ShimClient::write(const uint8_t *buf, size_t size)  {
     return size;
 }
 int ShimClient::available()  {
-    return this->responseBuffer->available();
+    return this->responseBuffer->remaining();
 }
 int ShimClient::read()  { return this->responseBuffer->next(); }
 int ShimClient::read(uint8_t *buf, size_t size) {
@@ -130,6 +141,12 @@ ShimClient* ShimClient::expect(uint8_t *buf, size_t size) {
 void ShimClient::setConnected(bool b) {
     this->_connected = b;
 }
+void ShimClient::setWriteLimit(int n) {
+    this->_writeLimit = n;
+}
+void ShimClient::refuseHost(const char *host) {
+    this->_refusedHost = host;
+}
 void ShimClient::setAllowConnect(bool b) {
     this->_allowConnect = b;
 }
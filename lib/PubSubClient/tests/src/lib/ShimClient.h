@@ -16,9 +16,11 @@ private:
     bool expectAnything;
     bool _error;
     uint16_t _received;
+    int _writeLimit;
     IPAddress _expectedIP;
     uint16_t _expectedPort;
     const char* _expectedHost;
+    const char* _refusedHost;
     
 public:
   ShimClient();
@@ -46,6 +48,10 @@ public:
   
   virtual void setAllowConnect(bool b);
   virtual void setConnected(bool b);
+  // Accept at most n bytes per write call; -1 (the default) accepts everything
+  virtual void setWriteLimit(int n);
+  // Fail connect() calls to this host name
+  virtual void refuseHost(const char *host);
 };
 
 #endif
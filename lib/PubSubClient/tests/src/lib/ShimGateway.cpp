@@ -0,0 +1,170 @@
+#include "ShimGateway.h"
+#include "trace.h"
+
+ShimGateway::ShimGateway() {
+    this->outLength = 0;
+    this->replyHead = 0;
+    this->replyCount = 0;
+    this->heldCount = 0;
+    this->currentLength = 0;
+    this->currentPos = 0;
+    this->nextTopicId = 1;
+    this->_silent = false;
+    this->_asleep = false;
+    this->datagrams = 0;
+    this->bytes = 0;
+    this->lastLength = 0;
+    this->lastType = 0;
+    this->lastFlags = 0;
+    this->lastTopicId = 0;
+    this->lastPayloadLength = 0;
+    this->lastPubAckTopicId = 0;
+    this->lastPubAckMsgId = 0;
+}
+
+uint8_t ShimGateway::begin(uint16_t port) { return 1; }
+void ShimGateway::stop() {}
+int ShimGateway::beginPacket(IPAddress ip, uint16_t port) {
+    this->outLength = 0;
+    return 1;
+}
+int ShimGateway::beginPacket(const char *host, uint16_t port) {
+    this->outLength = 0;
+    return 1;
+}
+size_t ShimGateway::write(uint8_t b) {
+    return this->write(&b,1);
+}
+size_t ShimGateway::write(const uint8_t *buf, size_t size) {
+    for (size_t i = 0; i < size && this->outLength < SHIM_GATEWAY_PACKET; i++) {
+        this->outgoing[this->outLength++] = buf[i];
+    }
+    return size;
+}
+
+int ShimGateway::endPacket() {
+    uint8_t* msg = this->outgoing;
+    uint16_t len = this->outLength;
+    this->datagrams++;
+    this->bytes += len;
+    memcpy(this->last,msg,len);
+    this->lastLength = len;
+    this->lastType = msg[1];
+    TRACE("MQTT-SN [" << std::dec << len << "] type " << std::hex << (unsigned int)msg[1] << "\n" << std::dec);
+
+    uint8_t* body = msg+2;
+    uint16_t blen = len-2;
+    uint8_t out[SHIM_GATEWAY_PACKET];
+
+    switch (msg[1]) {
+    case 0x04: // CONNECT
+        this->_asleep = false;
+        out[0] = 3; out[1] = 0x05; out[2] = 0;
+        reply(out,3);
+        break;
+    case 0x0A: // REGISTER
+        out[0] = 7; out[1] = 0x0B;
+        out[2] = (this->nextTopicId >> 8); out[3] = (this->nextTopicId & 0xFF);
+        out[4] = body[2]; out[5] = body[3]; out[6] = 0;
+        this->nextTopicId++;
+        reply(out,7);
+        break;
+    case 0x0C: // PUBLISH
+        this->lastFlags = body[0];
+        this->lastTopicId = (body[1]<<8)+body[2];
+        this->lastPayloadLength = blen-5;
+        memcpy(this->lastPayload,body+5,blen-5);
+        this->lastPayload[blen-5] = 0;
+        if ((body[0] & 0x60) == 0x20) {
+            out[0] = 7; out[1] = 0x0D;
+            out[2] = body[1]; out[3] = body[2]; out[4] = body[3]; out[5] = body[4]; out[6] = 0;
+            reply(out,7);
+        }
+        break;
+    case 0x0D: // PUBACK
+        this->lastPubAckTopicId = (body[0]<<8)+body[1];
+        this->lastPubAckMsgId = (body[2]<<8)+body[3];
+        break;
+    case 0x16: // PINGREQ
+        if (this->_asleep && blen > 0) {
+            for (uint8_t i = 0; i < this->heldCount; i++) {
+                reply(this->held[i],this->heldLength[i]);
+            }
+            this->heldCount = 0;
+        }
+        out[0] = 2; out[1] = 0x17;
+        reply(out,2);
+        break;
+    case 0x18: // DISCONNECT
+        this->_asleep = (blen == 2);
+        out[0] = 2; out[1] = 0x18;
+        reply(out,2);
+        break;
+    }
+    return 1;
+}
+
+void ShimGateway::reply(const uint8_t* buf, uint16_t size) {
+    if (this->_silent || this->replyCount >= SHIM_GATEWAY_QUEUE) {
+        return;
+    }
+    uint8_t slot = (this->replyHead + this->replyCount) % SHIM_GATEWAY_QUEUE;
+    memcpy(this->replies[slot],buf,size);
+    this->replyLength[slot] = size;
+    this->replyCount++;
+}
+
+int ShimGateway::parsePacket() {
+    if (this->replyCount == 0) {
+        return 0;
+    }
+    memcpy(this->current,this->replies[this->replyHead],this->replyLength[this->replyHead]);
+    this->currentLength = this->replyLength[this->replyHead];
+    this->currentPos = 0;
+    this->replyHead = (this->replyHead + 1) % SHIM_GATEWAY_QUEUE;
+    this->replyCount--;
+    return this->currentLength;
+}
+int ShimGateway::available() {
+    return this->currentLength - this->currentPos;
+}
+int ShimGateway::read() {
+    if (this->currentPos < this->currentLength) {
+        return this->current[this->currentPos++];
+    }
+    return -1;
+}
+int ShimGateway::read(unsigned char* buf, size_t len) {
+    size_t i = 0;
+    for (; i < len && this->currentPos < this->currentLength; i++) {
+        buf[i] = this->current[this->currentPos++];
+    }
+    return i;
+}
+int ShimGateway::peek() { return 0; }
+void ShimGateway::flush() {}
+IPAddress ShimGateway::remoteIP() { return IPAddress(172,16,0,2); }
+uint16_t ShimGateway::remotePort() { return 1884; }
+
+void ShimGateway::setSilent(bool b) {
+    this->_silent = b;
+}
+
+bool ShimGateway::asleep() {
+    return this->_asleep;
+}
+
+void ShimGateway::deliver(uint16_t topicId, const char* payload, uint8_t qos, uint16_t msgId) {
+    uint8_t msg[SHIM_GATEWAY_PACKET];
+    uint16_t plen = strlen(payload);
+    msg[0] = 7+plen; msg[1] = 0x0C; msg[2] = (qos == 1) ? 0x20 : 0;
+    msg[3] = (topicId >> 8); msg[4] = (topicId & 0xFF);
+    msg[5] = (msgId >> 8); msg[6] = (msgId & 0xFF);
+    memcpy(msg+7,payload,plen);
+    if (this->_asleep) {
+        memcpy(this->held[this->heldCount],msg,7+plen);
+        this->heldLength[this->heldCount++] = 7+plen;
+    } else {
+        reply(msg,7+plen);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef shimgateway_h
+#define shimgateway_h
+
+#include "Arduino.h"
+#include "Udp.h"
+#include "IPAddress.h"
+
+#define SHIM_GATEWAY_QUEUE 8
+#define SHIM_GATEWAY_PACKET 64
+
+// A stand-in MQTT-SN gateway. Every datagram the client sends is decoded
+// and answered the way a gateway would: CONNACK, REGACK, PUBACK, PINGRESP
+// and DISCONNECT. Messages delivered while the client sleeps are buffered
+// until it checks in with a PINGREQ.
+class ShimGateway : public UDP {
+private:
+    uint8_t outgoing[SHIM_GATEWAY_PACKET];
+    uint16_t outLength;
+    uint8_t replies[SHIM_GATEWAY_QUEUE][SHIM_GATEWAY_PACKET];
+    uint16_t replyLength[SHIM_GATEWAY_QUEUE];
+    uint8_t replyHead;
+    uint8_t replyCount;
+    uint8_t held[SHIM_GATEWAY_QUEUE][SHIM_GATEWAY_PACKET];
+    uint16_t heldLength[SHIM_GATEWAY_QUEUE];
+    uint8_t heldCount;
+    uint8_t current[SHIM_GATEWAY_PACKET];
+    uint16_t currentLength;
+    uint16_t currentPos;
+    uint16_t nextTopicId;
+    bool _silent;
+    bool _asleep;
+
+    void reply(const uint8_t* buf, uint16_t size);
+
+public:
+    // traffic sent by the client
+    uint16_t datagrams;
+    uint32_t bytes;
+    // the last datagram sent by the client
+    uint8_t last[SHIM_GATEWAY_PACKET];
+    uint16_t lastLength;
+    uint8_t lastType;
+    // the last PUBLISH sent by the client
+    uint8_t lastFlags;
+    uint16_t lastTopicId;
+    char lastPayload[SHIM_GATEWAY_PACKET];
+    uint16_t lastPayloadLength;
+    // the last PUBACK sent by the client
+    uint16_t lastPubAckTopicId;
+    uint16_t lastPubAckMsgId;
+
+    ShimGateway();
+    virtual uint8_t begin(uint16_t);
+    virtual void stop();
+    virtual int beginPacket(IPAddress ip, uint16_t port);
+    virtual int beginPacket(const char *host, uint16_t port);
+    virtual int endPacket();
+    virtual size_t write(uint8_t);
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    virtual int parsePacket();
+    virtual int available();
+    virtual int read();
+    virtual int read(unsigned char* buffer, size_t len);
+    virtual int peek();
+    virtual void flush();
+    virtual IPAddress remoteIP();
+    virtual uint16_t remotePort();
+
+    // stop answering, as if the gateway were unreachable
+    virtual void setSilent(bool b);
+    virtual bool asleep();
+    // publish a message to the client, held while it is asleep; a QoS 1
+    // message carries msgId
+    virtual void deliver(uint16_t topicId, const char* payload, uint8_t qos = 0, uint16_t msgId = 0);
+};
+
+#endif
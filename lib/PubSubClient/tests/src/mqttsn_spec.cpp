@@ -0,0 +1,226 @@
+#include "MQTTSNClient.h"
+#include "ShimGateway.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+
+IPAddress gateway(172, 16, 0, 2);
+
+bool callback_called = false;
+char lastTopic[64];
+char lastPayload[64];
+unsigned int lastLength;
+
+void reset_callback() {
+    callback_called = false;
+    lastTopic[0] = '\0';
+    lastPayload[0] = '\0';
+    lastLength = 0;
+}
+
+void callback(char* topic, byte* payload, unsigned int length) {
+    callback_called = true;
+    strcpy(lastTopic,topic);
+    memcpy(lastPayload,payload,length);
+    lastLength = length;
+}
+
+MQTTSNClient* replier;
+
+// publishes a reply from inside the callback
+void reply_callback(char* topic, byte* payload, unsigned int length) {
+    callback(topic,payload,length);
+    replier->publish("cmd/reply","done");
+}
+
+int test_mqttsn_connect() {
+    IT("sends a properly formatted connect datagram and succeeds");
+    ShimGateway udp;
+    MQTTSNClient client(gateway, 1884, udp);
+    IS_TRUE(client.state() == MQTT_DISCONNECTED);
+
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    IS_TRUE(client.state() == MQTT_CONNECTED);
+
+    byte connect[] = {0x12,0x4,0x4,0x1,0x0,0x3c,0x63,0x6c,0x69,0x65,0x6e,0x74,0x5f,0x74,0x65,0x73,0x74,0x31};
+    IS_TRUE(udp.lastLength == 18);
+    IS_TRUE(memcmp(udp.last,connect,18) == 0);
+
+    END_IT
+}
+
+int test_mqttsn_connect_timeout() {
+    IT("gives up after retrying an unanswered connect (takes 9 seconds)");
+    ShimGateway udp;
+    udp.setSilent(true);
+    MQTTSNClient client(gateway, 1884, udp);
+
+    int rc = client.connect((char*)"client_test1");
+    IS_FALSE(rc);
+    IS_TRUE(client.state() == MQTT_CONNECTION_TIMEOUT);
+    IS_TRUE(udp.datagrams == 1 + MQTTSN_RETRIES);
+
+    END_IT
+}
+
+int test_mqttsn_register_once() {
+    IT("registers a topic on first publish and reuses the topic id");
+    ShimGateway udp;
+    MQTTSNClient client(gateway, 1884, udp);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    rc = client.publish("home/outside/temperature","72.34");
+    IS_TRUE(rc);
+    IS_TRUE(udp.datagrams == 3);
+    IS_TRUE(udp.lastType == MQTTSN_PUBLISH);
+    IS_TRUE(udp.lastTopicId == 1);
+    IS_TRUE(strcmp(udp.lastPayload,"72.34") == 0);
+
+    rc = client.publish("home/outside/temperature","72.36");
+    IS_TRUE(rc);
+    IS_TRUE(udp.datagrams == 4);
+    // 7 byte header: length, type, flags, topic id, message id
+    IS_TRUE(udp.lastLength == 12);
+    IS_TRUE(strcmp(udp.lastPayload,"72.36") == 0);
+
+    END_IT
+}
+
+int test_mqttsn_publish_qos1() {
+    IT("publishes at qos 1 and waits for the puback");
+    ShimGateway udp;
+    MQTTSNClient client(gateway, 1884, udp);
+    client.setQos(1);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    rc = client.publish("topic","payload");
+    IS_TRUE(rc);
+    IS_TRUE((udp.lastFlags & MQTTSN_FLAG_QOSM1) == MQTTSN_FLAG_QOS1);
+
+    END_IT
+}
+
+int test_mqttsn_publish_qos_minus_one() {
+    IT("publishes at qos -1 to a predefined topic without connecting");
+    ShimGateway udp;
+    MQTTSNClient client(gateway, 1884, udp);
+    client.setPredefinedTopic("topic",5);
+
+    int rc = client.publish("topic",(const uint8_t*)"payload",7,false,-1);
+    IS_TRUE(rc);
+    IS_TRUE(udp.datagrams == 1);
+    IS_TRUE(udp.lastFlags == (MQTTSN_FLAG_QOSM1|MQTTSN_TOPIC_PREDEFINED));
+    IS_TRUE(udp.lastTopicId == 5);
+
+    rc = client.publish("other",(const uint8_t*)"payload",7,false,-1);
+    IS_FALSE(rc);
+
+    rc = client.publish("topic","payload");
+    IS_FALSE(rc);
+
+    END_IT
+}
+
+int test_mqttsn_sleep_and_wake() {
+    IT("receives messages held by the gateway when waking from sleep");
+    reset_callback();
+    ShimGateway udp;
+    MQTTSNClient client(gateway, 1884, udp);
+    client.setCallback(callback);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    rc = client.registerTopic("cmd");
+    IS_TRUE(rc);
+
+    rc = client.sleep(300);
+    IS_TRUE(rc);
+    IS_TRUE(client.state() == MQTTSN_ASLEEP);
+    IS_TRUE(udp.asleep());
+
+    udp.deliver(1,"on");
+    IS_FALSE(callback_called);
+
+    rc = client.wake();
+    IS_TRUE(rc);
+    IS_TRUE(callback_called);
+    IS_TRUE(strcmp(lastTopic,"cmd") == 0);
+    IS_TRUE(lastLength == 2);
+    IS_TRUE(memcmp(lastPayload,"on",2) == 0);
+    IS_TRUE(client.state() == MQTTSN_ASLEEP);
+
+    // Reconnecting from sleep keeps the session and its topic ids
+    rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    IS_TRUE(udp.last[2] == 0);
+    uint16_t datagrams = udp.datagrams;
+    rc = client.publish("cmd","off");
+    IS_TRUE(rc);
+    IS_TRUE(udp.datagrams == datagrams + 1);
+
+    END_IT
+}
+
+int test_mqttsn_receive() {
+    IT("passes a publish for a registered topic to the callback");
+    reset_callback();
+    ShimGateway udp;
+    MQTTSNClient client(gateway, 1884, udp);
+    client.setCallback(callback);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    rc = client.registerTopic("cmd");
+    IS_TRUE(rc);
+
+    udp.deliver(1,"payload");
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(callback_called);
+    IS_TRUE(strcmp(lastTopic,"cmd") == 0);
+    IS_TRUE(lastLength == 7);
+
+    END_IT
+}
+
+int test_mqttsn_receive_qos1_publish_in_callback() {
+    IT("acknowledges a qos 1 publish with its own message id when the callback publishes");
+    reset_callback();
+    ShimGateway udp;
+    MQTTSNClient client(gateway, 1884, udp);
+    replier = &client;
+    client.setQos(1);
+    client.setCallback(reply_callback);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    rc = client.registerTopic("cmd");
+    IS_TRUE(rc);
+
+    udp.deliver(1,"payload",1,0x1234);
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(callback_called);
+    // the reply was registered and published before the PUBACK went out
+    IS_TRUE(strcmp(udp.lastPayload,"done") == 0);
+    IS_TRUE(udp.lastType == MQTTSN_PUBACK);
+    IS_TRUE(udp.lastPubAckTopicId == 1);
+    IS_TRUE(udp.lastPubAckMsgId == 0x1234);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("MQTT-SN");
+    test_mqttsn_connect();
+    test_mqttsn_register_once();
+    test_mqttsn_publish_qos1();
+    test_mqttsn_publish_qos_minus_one();
+    test_mqttsn_sleep_and_wake();
+    test_mqttsn_receive();
+    test_mqttsn_receive_qos1_publish_in_callback();
+    test_mqttsn_connect_timeout();
+
+    FINISH
+}
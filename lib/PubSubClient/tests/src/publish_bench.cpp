@@ -0,0 +1,46 @@
+// Compares the cost of publishing through PubSubClient (virtual Client,
+// callback pointer) with BasicPubSubClient over a concrete transport.
+#include "PubSubClient.h"
+#include "BasicPubSubClient.h"
+#include "MemoryTransport.h"
+#include "trace.h"
+#include <ctime>
+
+#define ITERATIONS 2000000
+
+byte server[] = { 172, 16, 0, 2 };
+byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+
+static double elapsedNs(clock_t start) {
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / ITERATIONS;
+}
+
+int main()
+{
+    MemoryClient memoryClient;
+    memoryClient.transport.respond(connack,4);
+    PubSubClient client(server, 1883, memoryClient);
+    client.connect("bench");
+
+    clock_t start = clock();
+    for (long i = 0; i < ITERATIONS; i++) {
+        memoryClient.transport.clear();
+        client.publish("home/outside/temperature","72.34");
+    }
+    LOG("PubSubClient:      " << elapsedNs(start) << " ns/publish\n");
+
+    MemoryTransport transport;
+    transport.respond(connack,4);
+    BasicPubSubClient<MemoryTransport> basic(transport);
+    basic.setServer(server,1883);
+    basic.connect("bench");
+
+    start = clock();
+    for (long i = 0; i < ITERATIONS; i++) {
+        transport.clear();
+        basic.publish("home/outside/temperature","72.34");
+    }
+    LOG("BasicPubSubClient: " << elapsedNs(start) << " ns/publish\n");
+
+    return 0;
+}
@@ -175,6 +175,198 @@ int test_publish_P() {
 
 
 
+int test_publish_resumes_partial_write() {
+    IT("resumes a partially written publish on later loops");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    uint8_t queue[64];
+    PubSubClient client(server, 1883, callback, shimClient);
+    client.setSendQueue(queue,sizeof(queue));
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte publish[] = {0x30,0xe,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.expect(publish,16);
+    shimClient.setWriteLimit(5);
+
+    rc = client.publish((char*)"topic",(char*)"payload");
+    IS_TRUE(rc);
+    IS_TRUE(client.pending() == 11);
+
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(client.pending() == 6);
+
+    rc = client.loop();
+    IS_TRUE(rc);
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(client.pending() == 0);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_backpressure() {
+    IT("refuses to publish while the send queue is full");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    uint8_t queue[20];
+    PubSubClient client(server, 1883, callback, shimClient);
+    client.setSendQueue(queue,sizeof(queue));
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte publish[] = {0x30,0xe,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.expect(publish,16);
+    shimClient.expect(publish,16);
+    shimClient.setWriteLimit(0);
+
+    rc = client.publish((char*)"topic",(char*)"payload");
+    IS_TRUE(rc);
+    IS_TRUE(client.pending() == 16);
+
+    rc = client.publish((char*)"topic",(char*)"payload");
+    IS_FALSE(rc);
+    IS_TRUE(client.pending() == 16);
+
+    shimClient.setWriteLimit(-1);
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(client.pending() == 0);
+
+    rc = client.publish((char*)"topic",(char*)"payload");
+    IS_TRUE(rc);
+    IS_TRUE(client.pending() == 0);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_P_queued() {
+    IT("queues a PROGMEM publish behind pending data");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    uint8_t queue[64];
+    PubSubClient client(server, 1883, callback, shimClient);
+    client.setSendQueue(queue,sizeof(queue));
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte publish[] = {0x30,0xe,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    byte publishRetained[] = {0x31,0xe,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.expect(publish,16);
+    shimClient.expect(publishRetained,16);
+    shimClient.setWriteLimit(3);
+
+    rc = client.publish((char*)"topic",(char*)"payload");
+    IS_TRUE(rc);
+    rc = client.publish_P((char*)"topic",(const uint8_t*)"payload",7,true);
+    IS_TRUE(rc);
+    IS_TRUE(client.pending() > 0);
+
+    shimClient.setWriteLimit(-1);
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(client.pending() == 0);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_disconnect_flushes_queue() {
+    IT("sends queued data and DISCONNECT before closing");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    uint8_t queue[20];
+    PubSubClient client(server, 1883, callback, shimClient);
+    client.setSendQueue(queue,sizeof(queue));
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte publish[] = {0x30,0xe,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    byte disconnect[] = { 0xE0,0x00 };
+    shimClient.expect(publish,16);
+    shimClient.expect(disconnect,2);
+    shimClient.setWriteLimit(0);
+
+    rc = client.publish((char*)"topic",(char*)"payload");
+    IS_TRUE(rc);
+    rc = client.publish((char*)"topic",(char*)"payload");
+    IS_FALSE(rc);
+
+    shimClient.setWriteLimit(-1);
+    uint16_t sent = shimClient.received();
+    client.disconnect();
+    IS_TRUE(shimClient.received() - sent == 18);
+    IS_TRUE(client.pending() == 0);
+    IS_TRUE(client.discarded() == 0);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_counts_discarded() {
+    IT("counts queued bytes that are never sent");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    uint8_t queue[64];
+    PubSubClient client(server, 1883, callback, shimClient);
+    client.setSendQueue(queue,sizeof(queue));
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    shimClient.setWriteLimit(0);
+    rc = client.publish((char*)"topic",(char*)"payload");
+    IS_TRUE(rc);
+
+    // The network takes nothing more: the publish and DISCONNECT are lost
+    client.disconnect();
+    IS_TRUE(client.pending() == 0);
+    IS_TRUE(client.discarded() == 18);
+
+    // A connection that drops with data queued loses it on reconnect
+    shimClient.setWriteLimit(-1);
+    shimClient.respond(connack,4);
+    rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    shimClient.setWriteLimit(0);
+    rc = client.publish((char*)"topic",(char*)"payload");
+    IS_TRUE(rc);
+    shimClient.setConnected(false);
+    shimClient.setWriteLimit(-1);
+    shimClient.respond(connack,4);
+    rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    IS_TRUE(client.discarded() == 34);
+
+    END_IT
+}
+
 int main()
 {
     SUITE("Publish");
@@ -185,6 +377,11 @@ int main()
     test_publish_not_connected();
     test_publish_too_long();
     test_publish_P();
+    test_publish_resumes_partial_write();
+    test_publish_backpressure();
+    test_publish_P_queued();
+    test_publish_disconnect_flushes_queue();
+    test_publish_counts_discarded();
 
     FINISH
 }
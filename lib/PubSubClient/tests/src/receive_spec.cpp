@@ -3,6 +3,7 @@
 #include "Buffer.h"
 #include "BDDTest.h"
 #include "trace.h"
+#include <new>
 
 
 byte server[] = { 172, 16, 0, 2 };
@@ -235,6 +236,216 @@ int test_receive_qos1() {
     END_IT
 }
 
+PubSubClient* queueClient;
+bool payloadIntact = false;
+
+void republish_callback(char* topic, byte* payload, unsigned int length) {
+    callback(topic,payload,length);
+    queueClient->publish((char*)"out",(char*)"overwritten-by-publish");
+    payloadIntact = (length == 7 && memcmp(payload,"payload",7) == 0 && strcmp(topic,"topic") == 0);
+}
+
+int test_receive_queued() {
+    IT("queues a message until dispatched");
+    reset_callback();
+
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    uint8_t queue[64];
+    PubSubClient client(server, 1883, callback, shimClient);
+    client.setReceiveQueue(queue,sizeof(queue));
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte publish[] = {0x30,0xe,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.respond(publish,16);
+
+    rc = client.loop();
+    IS_TRUE(rc);
+
+    IS_FALSE(callback_called);
+    IS_TRUE(client.queued() == 1);
+
+    rc = client.dispatch();
+    IS_TRUE(rc);
+
+    IS_TRUE(callback_called);
+    IS_TRUE(strcmp(lastTopic,"topic")==0);
+    IS_TRUE(memcmp(lastPayload,"payload",7)==0);
+    IS_TRUE(lastLength == 7);
+    IS_TRUE(client.queued() == 0);
+
+    rc = client.dispatch();
+    IS_FALSE(rc);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_receive_queued_burst() {
+    IT("queues a burst of messages in one loop and dispatches them in order");
+    reset_callback();
+
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    // Room for two 17 byte records; the third has to wrap around
+    uint8_t queue[40];
+    PubSubClient client(server, 1883, callback, shimClient);
+    client.setReceiveQueue(queue,sizeof(queue));
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte publish1[] = {0x30,0xe,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x31};
+    byte publish2[] = {0x30,0xe,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x32};
+    byte publish3[] = {0x30,0xe,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x33};
+    shimClient.respond(publish1,16);
+    shimClient.respond(publish2,16);
+
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(client.queued() == 2);
+
+    rc = client.dispatch();
+    IS_TRUE(rc);
+    IS_TRUE(memcmp(lastPayload,"payloa1",7)==0);
+
+    shimClient.respond(publish3,16);
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(client.queued() == 2);
+    IS_TRUE(client.dropped() == 0);
+
+    rc = client.dispatch();
+    IS_TRUE(rc);
+    IS_TRUE(memcmp(lastPayload,"payloa2",7)==0);
+
+    rc = client.dispatch();
+    IS_TRUE(rc);
+    IS_TRUE(strcmp(lastTopic,"topic")==0);
+    IS_TRUE(memcmp(lastPayload,"payloa3",7)==0);
+    IS_TRUE(client.queued() == 0);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_receive_queued_publish_in_callback() {
+    IT("lets a dispatched callback publish without corrupting the message");
+    reset_callback();
+
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    uint8_t queue[64];
+    PubSubClient client(server, 1883, republish_callback, shimClient);
+    client.setReceiveQueue(queue,sizeof(queue));
+    queueClient = &client;
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte publish[] = {0x30,0xe,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.respond(publish,16);
+
+    rc = client.loop();
+    IS_TRUE(rc);
+
+    payloadIntact = false;
+    rc = client.dispatch();
+    IS_TRUE(rc);
+    IS_TRUE(callback_called);
+    IS_TRUE(payloadIntact);
+
+    END_IT
+}
+
+int test_receive_queue_full() {
+    IT("drops qos0 and withholds the puback for qos1 when the queue is full");
+    reset_callback();
+
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    uint8_t queue[20];
+    PubSubClient client(server, 1883, callback, shimClient);
+    client.setReceiveQueue(queue,sizeof(queue));
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte publish[] = {0x30,0xe,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    byte publishQos1[] = {0x32,0x10,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x12,0x34,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.respond(publish,16);
+    shimClient.respond(publish,16);
+    shimClient.respond(publishQos1,18);
+
+    // Nothing may be written: no PUBACK for the message that did not fit
+    byte nothing[] = { 0 };
+    shimClient.expect(nothing,0);
+
+    rc = client.loop();
+    IS_TRUE(rc);
+
+    IS_TRUE(client.queued() == 1);
+    IS_TRUE(client.dropped() == 2);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_receive_without_queue() {
+    IT("reports an empty queue when none is attached");
+    reset_callback();
+
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    // Build the client over dirty memory, as a local or heap client would be
+    static uint8_t storage[sizeof(PubSubClient)];
+    memset(storage,0xA5,sizeof(storage));
+    PubSubClient* client = new (storage) PubSubClient(server, 1883, callback, shimClient);
+
+    IS_TRUE(client->queued() == 0);
+    IS_TRUE(client->dropped() == 0);
+    IS_FALSE(client->dispatch());
+
+    int rc = client->connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte publish[] = {0x30,0xe,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.respond(publish,16);
+
+    rc = client->loop();
+    IS_TRUE(rc);
+    IS_TRUE(callback_called);
+    IS_TRUE(client->queued() == 0);
+    IS_FALSE(client->dispatch());
+
+    IS_FALSE(shimClient.error());
+
+    client->~PubSubClient();
+
+    END_IT
+}
+
 int main()
 {
     SUITE("Receive");
@@ -244,6 +455,11 @@ int main()
     test_receive_oversized_message();
     test_receive_oversized_stream_message();
     test_receive_qos1();
+    test_receive_queued();
+    test_receive_queued_burst();
+    test_receive_queued_publish_in_callback();
+    test_receive_queue_full();
+    test_receive_without_queue();
 
     FINISH
 }
@@ -0,0 +1,184 @@
+/*
+ * Reactor.cpp
+ *
+ * Reactor - an event loop for Arduino sketches built on SimpleTimer.
+ */
+
+
+#include "Reactor.h"
+
+#if REACTOR_HAS_POLL
+#include <poll.h>
+#endif
+
+
+Reactor::Reactor(SimpleTimerBase& timer) {
+    this->timer = &timer;
+    maxSleep = REACTOR_MAX_SLEEP;
+}
+
+
+int Reactor::addSource(reactor_ready ready, int fd, TimerTask handler) {
+    if (!handler) {
+        return -1;
+    }
+
+    for (int i = 0; i < REACTOR_MAX_SOURCES; i++) {
+        if (!sources[i].handler) {
+            sources[i].handler = handler;
+            sources[i].ready = ready;
+            sources[i].fd = fd;
+            sources[i].notified = false;
+            return i;
+        }
+    }
+
+    // all sources are used
+    return -1;
+}
+
+
+int Reactor::watch(reactor_ready ready, TimerTask handler) {
+    if (ready == NULL) {
+        return -1;
+    }
+
+    return addSource(ready, -1, handler);
+}
+
+
+int Reactor::watch(TimerTask handler) {
+    return addSource(NULL, -1, handler);
+}
+
+
+#if REACTOR_HAS_POLL
+int Reactor::watchFd(int fd, TimerTask handler) {
+    if (fd < 0) {
+        return -1;
+    }
+
+    return addSource(NULL, fd, handler);
+}
+#endif
+
+
+void Reactor::unwatch(int id) {
+    if (id < 0 || id >= REACTOR_MAX_SOURCES) {
+        return;
+    }
+
+    sources[id].handler.clear();
+    sources[id].ready = NULL;
+    sources[id].fd = -1;
+    sources[id].notified = false;
+}
+
+
+void Reactor::notify(int id) {
+    if (id < 0 || id >= REACTOR_MAX_SOURCES) {
+        return;
+    }
+
+    sources[id].notified = true;
+}
+
+
+void Reactor::setMaxSleep(unsigned long ms) {
+    maxSleep = ms;
+}
+
+
+int Reactor::dispatch() {
+    int handled = 0;
+
+#if REACTOR_HAS_POLL
+    pollFds(0);
+#endif
+
+    for (int i = 0; i < REACTOR_MAX_SOURCES; i++) {
+        Source& s = sources[i];
+        if (!s.handler) {
+            continue;
+        }
+
+        // only clear a notify that was seen; one from an interrupt after
+        // this test stays set for the next pass instead of being lost
+        boolean ready = false;
+        if (s.notified) {
+            s.notified = false;
+            ready = true;
+        }
+        if (!ready && s.ready != NULL) {
+            ready = s.ready();
+        }
+
+        if (ready) {
+            // call a copy, the handler may unwatch its own source
+            TimerTask handler = s.handler;
+            handler();
+            handled++;
+        }
+    }
+
+    return handled;
+}
+
+
+void Reactor::runOnce() {
+    int handled = dispatch();
+
+    timer->run();
+
+    // a handler that ran may have more to do
+    if (handled) {
+        return;
+    }
+
+    long wait = (long)(timer->nextDeadline() - millis());
+    if (wait <= 0) {
+        return;
+    }
+    if ((unsigned long)wait > maxSleep) {
+        wait = maxSleep;
+    }
+
+    sleep(wait);
+}
+
+
+void Reactor::sleep(unsigned long ms) {
+#if REACTOR_HAS_POLL
+    pollFds(ms);
+#else
+    delay(ms);
+#endif
+}
+
+
+#if REACTOR_HAS_POLL
+void Reactor::pollFds(unsigned long timeout) {
+    struct pollfd fds[REACTOR_MAX_SOURCES];
+    int ids[REACTOR_MAX_SOURCES];
+    int n = 0;
+
+    for (int i = 0; i < REACTOR_MAX_SOURCES; i++) {
+        if (sources[i].handler && sources[i].fd >= 0) {
+            fds[n].fd = sources[i].fd;
+            fds[n].events = POLLIN;
+            fds[n].revents = 0;
+            ids[n++] = i;
+        }
+    }
+
+    if (poll(fds, n, timeout) <= 0) {
+        return;
+    }
+
+    for (int k = 0; k < n; k++) {
+        if (fds[k].revents & (POLLIN | POLLHUP | POLLERR)) {
+            sources[ids[k]].notified = true;
+        }
+    }
+}
+#endif
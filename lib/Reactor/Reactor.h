@@ -0,0 +1,110 @@
+/*
+ * Reactor.h
+ *
+ * Reactor - an event loop for Arduino sketches built on SimpleTimer.
+ *
+ * Instead of polling every subsystem on every pass of loop(), handlers
+ * are registered for the events they care about:
+ *
+ *  - watch(ready, handler) calls handler on a pass where ready() is true,
+ *    for sources such as WiFiServer::hasClient() or Serial.available();
+ *  - notify(id), safe to call from an interrupt or a network stack
+ *    callback, calls the handler of id on the next pass;
+ *  - timers set on the SimpleTimer cover everything periodic.
+ *
+ * When no handler ran and no timer is due, runOnce() sleeps until the next
+ * timer deadline, but at most setMaxSleep() milliseconds, since ready()
+ * predicates can only be checked when awake. On the ESP8266 the sleep is
+ * delay(), which hands the CPU to the SDK and, with
+ * WiFi.setSleepMode(WIFI_LIGHT_SLEEP), lets the chip light sleep. On a
+ * host build, watchFd() sources are waited on with poll() instead.
+ */
+
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <Arduino.h>
+#include <SimpleTimer.h>
+
+// REACTOR_MAX_SOURCES : number of watch() and watchFd() sources
+#ifndef REACTOR_MAX_SOURCES
+#define REACTOR_MAX_SOURCES 8
+#endif
+
+// REACTOR_MAX_SLEEP : default for setMaxSleep(), in milliseconds
+#ifndef REACTOR_MAX_SLEEP
+#define REACTOR_MAX_SLEEP 10
+#endif
+
+// file descriptors and poll() are only available on a host build
+#if defined(__unix__) || defined(__APPLE__)
+#define REACTOR_HAS_POLL 1
+#else
+#define REACTOR_HAS_POLL 0
+#endif
+
+typedef boolean (*reactor_ready)(void);
+
+class Reactor {
+
+public:
+    // constructor; timer is run by runOnce()
+    Reactor(SimpleTimerBase& timer);
+
+    // call handler on every pass where ready() returns true;
+    // returns the source id, or -1 if all sources are in use
+    int watch(reactor_ready ready, TimerTask handler);
+
+    // call handler on the next pass after notify(id)
+    int watch(TimerTask handler);
+
+#if REACTOR_HAS_POLL
+    // call handler when fd is readable
+    int watchFd(int fd, TimerTask handler);
+#endif
+
+    // remove the specified source
+    void unwatch(int id);
+
+    // mark the specified source ready; safe from an interrupt
+    void notify(int id);
+
+    // longest time runOnce() sleeps, which bounds how late a ready()
+    // predicate is noticed
+    void setMaxSleep(unsigned long ms);
+
+    // this function must be called inside loop(): calls the handlers of
+    // the ready sources, runs the timer, then sleeps if nothing happened
+    void runOnce();
+
+private:
+    struct Source {
+        Source() : ready(0), fd(-1), notified(false) {}
+
+        // the handler; an empty task means the source is free
+        TimerTask handler;
+        reactor_ready ready;
+        int fd;
+        volatile boolean notified;
+    };
+
+    // call the handlers of the ready sources, returns how many ran
+    int dispatch();
+
+    // wait up to ms milliseconds for an event
+    void sleep(unsigned long ms);
+
+#if REACTOR_HAS_POLL
+    // mark readable watchFd() sources notified, waiting up to timeout ms
+    void pollFds(unsigned long timeout);
+#endif
+
+    int addSource(reactor_ready ready, int fd, TimerTask handler);
+
+    SimpleTimerBase* timer;
+    Source sources[REACTOR_MAX_SOURCES];
+    unsigned long maxSleep;
+};
+
+#endif
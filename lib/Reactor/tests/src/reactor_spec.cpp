@@ -0,0 +1,222 @@
+#include "Reactor.h"
+#include "BDDTest.h"
+#include "trace.h"
+#include <unistd.h>
+#include <time.h>
+#include <thread>
+
+int handled;
+
+void handler() { handled++; }
+
+boolean readyFlag;
+
+boolean isReady() { return readyFlag; }
+
+// real time, since poll() waits in real time
+unsigned long realMillis() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000UL;
+}
+
+int fds[2];
+
+// handler of the read end of the pipe: drain it
+void readPipe() {
+    char c;
+    if (read(fds[0], &c, 1) == 1) {
+        handled++;
+    }
+}
+
+
+int test_reactor_watch() {
+    IT("calls a watch() handler on each pass its predicate is true");
+    SimpleTimer timer;
+    Reactor reactor(timer);
+    handled = 0;
+    readyFlag = false;
+
+    IS_TRUE(reactor.watch(isReady, handler) >= 0);
+    reactor.setMaxSleep(0);
+    reactor.runOnce();
+    IS_TRUE(handled == 0);
+
+    readyFlag = true;
+    reactor.runOnce();
+    reactor.runOnce();
+    IS_TRUE(handled == 2);
+
+    END_IT
+}
+
+int test_reactor_notify() {
+    IT("calls a notify() source once per notify()");
+    SimpleTimer timer;
+    Reactor reactor(timer);
+    reactor.setMaxSleep(0);
+    handled = 0;
+
+    int id = reactor.watch(handler);
+    reactor.notify(id);
+    reactor.runOnce();
+    reactor.runOnce();
+    IS_TRUE(handled == 1);
+
+    reactor.unwatch(id);
+    reactor.notify(id);
+    reactor.runOnce();
+    IS_TRUE(handled == 1);
+
+    END_IT
+}
+
+int test_reactor_runs_timer() {
+    IT("runs the timer on each pass");
+    SimpleTimer timer;
+    Reactor reactor(timer);
+    reactor.setMaxSleep(0);
+    handled = 0;
+
+    timer.setInterval(10, handler);
+    advance(10);
+    reactor.runOnce();
+    IS_TRUE(handled == 1);
+
+    END_IT
+}
+
+int test_reactor_fd_readable() {
+    IT("calls a watchFd() handler when its descriptor is readable");
+    SimpleTimer timer;
+    Reactor reactor(timer);
+    handled = 0;
+    IS_TRUE(pipe(fds) == 0);
+
+    IS_TRUE(reactor.watchFd(fds[0], readPipe) >= 0);
+    IS_TRUE(reactor.watchFd(-1, readPipe) == -1);
+
+    reactor.setMaxSleep(0);
+    reactor.runOnce();
+    IS_TRUE(handled == 0);
+
+    IS_TRUE(write(fds[1], "xy", 2) == 2);
+    reactor.runOnce();
+    IS_TRUE(handled == 1);
+    reactor.runOnce();
+    IS_TRUE(handled == 2);
+
+    close(fds[0]);
+    close(fds[1]);
+
+    END_IT
+}
+
+int test_reactor_fd_sleep() {
+    IT("waits in poll() for up to setMaxSleep() when nothing is ready");
+    SimpleTimer timer;
+    Reactor reactor(timer);
+    handled = 0;
+    IS_TRUE(pipe(fds) == 0);
+    reactor.watchFd(fds[0], readPipe);
+
+    reactor.setMaxSleep(50);
+    unsigned long start = realMillis();
+    reactor.runOnce();
+    unsigned long waited = realMillis() - start;
+    IS_TRUE(waited >= 50);
+    IS_TRUE(waited < 500);
+    IS_TRUE(handled == 0);
+
+    close(fds[0]);
+    close(fds[1]);
+
+    END_IT
+}
+
+int test_reactor_fd_wakes() {
+    IT("wakes from poll() as soon as a descriptor becomes readable");
+    SimpleTimer timer;
+    Reactor reactor(timer);
+    handled = 0;
+    IS_TRUE(pipe(fds) == 0);
+    reactor.watchFd(fds[0], readPipe);
+
+    reactor.setMaxSleep(5000);
+    std::thread writer([] {
+        usleep(20000);
+        if (write(fds[1], "x", 1) != 1) {
+            abort();
+        }
+    });
+    unsigned long start = realMillis();
+    reactor.runOnce();
+    unsigned long waited = realMillis() - start;
+    writer.join();
+    IS_TRUE(waited < 2000);
+
+    // woken by the descriptor, which is handled on the next pass
+    reactor.setMaxSleep(0);
+    reactor.runOnce();
+    IS_TRUE(handled == 1);
+
+    close(fds[0]);
+    close(fds[1]);
+
+    END_IT
+}
+
+int test_reactor_fd_hangup() {
+    IT("calls a watchFd() handler when the other end closes");
+    SimpleTimer timer;
+    Reactor reactor(timer);
+    handled = 0;
+    IS_TRUE(pipe(fds) == 0);
+
+    int id = reactor.watchFd(fds[0], handler);
+    close(fds[1]);
+    reactor.setMaxSleep(0);
+    reactor.runOnce();
+    IS_TRUE(handled == 1);
+
+    reactor.unwatch(id);
+    reactor.runOnce();
+    IS_TRUE(handled == 1);
+
+    close(fds[0]);
+
+    END_IT
+}
+
+int test_reactor_sleep_to_deadline() {
+    IT("sleeps no longer than the next timer deadline");
+    SimpleTimer timer;
+    Reactor reactor(timer);
+    reactor.setMaxSleep(5000);
+
+    // the fake clock does not move, so this is a 30ms real wait
+    timer.setTimeout(30, handler);
+    unsigned long start = realMillis();
+    reactor.runOnce();
+    unsigned long waited = realMillis() - start;
+    IS_TRUE(waited >= 30);
+    IS_TRUE(waited < 2000);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("Reactor");
+    test_reactor_watch();
+    test_reactor_notify();
+    test_reactor_runs_timer();
+    test_reactor_fd_readable();
+    test_reactor_fd_sleep();
+    test_reactor_fd_wakes();
+    test_reactor_fd_hangup();
+    test_reactor_sleep_to_deadline();
+
+    FINISH
+}
@@ -0,0 +1,153 @@
+/*
+ * SampleBus.cpp
+ *
+ * SampleBus - a fixed-memory publish/subscribe bus between sensor readers
+ * and the sinks that report their samples.
+ */
+
+
+#include "SampleBus.h"
+
+
+SampleBus::SampleBus() {
+    for (int i = 0; i < SAMPLEBUS_MAX_KINDS; i++) {
+        values[i] = 0;
+        timestamps[i] = 0;
+        published[i] = 0;
+    }
+
+    sequence = 0;
+    next = 0;
+}
+
+
+void SampleBus::publish(uint8_t kind, int32_t value) {
+    if (kind >= SAMPLEBUS_MAX_KINDS) {
+        return;
+    }
+
+    values[kind] = value;
+    timestamps[kind] = millis();
+    published[kind] = ++sequence;
+}
+
+
+boolean SampleBus::has(uint8_t kind) {
+    if (kind >= SAMPLEBUS_MAX_KINDS) {
+        return false;
+    }
+
+    return published[kind] != 0;
+}
+
+
+int32_t SampleBus::value(uint8_t kind) {
+    if (kind >= SAMPLEBUS_MAX_KINDS) {
+        return 0;
+    }
+
+    return values[kind];
+}
+
+
+unsigned long SampleBus::timestamp(uint8_t kind) {
+    if (kind >= SAMPLEBUS_MAX_KINDS) {
+        return 0;
+    }
+
+    return timestamps[kind];
+}
+
+
+int SampleBus::subscribe(uint16_t mask, unsigned long minInterval, TimerTask handler) {
+    if (!handler || mask == 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < SAMPLEBUS_MAX_SUBSCRIBERS; i++) {
+        Subscriber& s = subscribers[i];
+        if (!s.handler) {
+            s.handler = handler;
+            s.mask = mask;
+            s.minInterval = minInterval;
+            s.lastRun = millis() - minInterval;
+            // samples published before subscribing count as new
+            s.seen = 0;
+            return i;
+        }
+    }
+
+    // all subscribers are used
+    return -1;
+}
+
+
+void SampleBus::setInterval(int id, unsigned long minInterval) {
+    if (id < 0 || id >= SAMPLEBUS_MAX_SUBSCRIBERS) {
+        return;
+    }
+
+    subscribers[id].minInterval = minInterval;
+}
+
+
+void SampleBus::unsubscribe(int id) {
+    if (id < 0 || id >= SAMPLEBUS_MAX_SUBSCRIBERS) {
+        return;
+    }
+
+    subscribers[id].handler.clear();
+    subscribers[id].mask = 0;
+}
+
+
+boolean SampleBus::ready(Subscriber& s, unsigned long now) {
+    if (!s.handler || now - s.lastRun < s.minInterval) {
+        return false;
+    }
+
+    for (int k = 0; k < SAMPLEBUS_MAX_KINDS; k++) {
+        if ((s.mask & SAMPLE_MASK(k)) && published[k] > s.seen) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+boolean SampleBus::pending() {
+    unsigned long now = millis();
+
+    for (int i = 0; i < SAMPLEBUS_MAX_SUBSCRIBERS; i++) {
+        if (ready(subscribers[i], now)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+boolean SampleBus::dispatch() {
+    unsigned long now = millis();
+
+    for (int n = 0; n < SAMPLEBUS_MAX_SUBSCRIBERS; n++) {
+        int i = (next + n) % SAMPLEBUS_MAX_SUBSCRIBERS;
+        Subscriber& s = subscribers[i];
+        if (!ready(s, now)) {
+            continue;
+        }
+
+        next = (i + 1) % SAMPLEBUS_MAX_SUBSCRIBERS;
+        s.lastRun = now;
+        s.seen = sequence;
+
+        // call a copy, the handler may unsubscribe itself
+        TimerTask handler = s.handler;
+        handler();
+        return true;
+    }
+
+    return false;
+}
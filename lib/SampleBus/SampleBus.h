@@ -0,0 +1,108 @@
+/*
+ * SampleBus.h
+ *
+ * SampleBus - a fixed-memory publish/subscribe bus between sensor readers
+ * and the sinks that report their samples.
+ *
+ * Readers publish(kind, value) each sample; kinds are small integers the
+ * sketch assigns, below SAMPLEBUS_MAX_KINDS, and values are integers in a
+ * fixed-point scale the sketch picks for each kind (such as 0.01 deg C),
+ * so no float math is needed on the way. The bus keeps the latest value
+ * of each kind. Sinks subscribe to a set of kinds with a minimum
+ * interval, and dispatch() calls a sink only once something it subscribed
+ * to was published since its last call and the interval has passed. The
+ * sink then reads whatever values it needs with value().
+ *
+ * dispatch() calls one sink at a time, round robin, so that a burst of
+ * new samples is spread over several passes of loop().
+ */
+
+
+#ifndef SAMPLEBUS_H
+#define SAMPLEBUS_H
+
+#include <Arduino.h>
+#include <SimpleTimer.h>
+
+// SAMPLEBUS_MAX_KINDS : number of sample kinds, at most 16
+#ifndef SAMPLEBUS_MAX_KINDS
+#define SAMPLEBUS_MAX_KINDS 8
+#endif
+
+// SAMPLEBUS_MAX_SUBSCRIBERS : number of subscribers
+#ifndef SAMPLEBUS_MAX_SUBSCRIBERS
+#define SAMPLEBUS_MAX_SUBSCRIBERS 6
+#endif
+
+// subscribe() mask of a single kind
+#define SAMPLE_MASK(kind) ((uint16_t)1 << (kind))
+
+class SampleBus {
+
+public:
+    // constructor
+    SampleBus();
+
+    // record a new sample of kind
+    void publish(uint8_t kind, int32_t value);
+
+    // returns true once a sample of kind has been published
+    boolean has(uint8_t kind);
+
+    // latest sample of kind, 0 if there is none
+    int32_t value(uint8_t kind);
+
+    // value of millis() when the latest sample of kind was published
+    unsigned long timestamp(uint8_t kind);
+
+    // call handler when a kind in mask has a new sample, at most once
+    // every minInterval milliseconds; returns the subscriber id, or -1
+    // if all subscribers are in use
+    int subscribe(uint16_t mask, unsigned long minInterval, TimerTask handler);
+
+    // change the minimum interval of the specified subscriber
+    void setInterval(int id, unsigned long minInterval);
+
+    // remove the specified subscriber
+    void unsubscribe(int id);
+
+    // returns true if dispatch() has a subscriber to call
+    boolean pending();
+
+    // call the next subscriber with new samples whose interval has
+    // passed; returns false if there was none
+    boolean dispatch();
+
+private:
+    struct Subscriber {
+        Subscriber() : mask(0), minInterval(0), lastRun(0), seen(0) {}
+
+        // the handler; an empty task means the subscriber is free
+        TimerTask handler;
+        uint16_t mask;
+        unsigned long minInterval;
+        unsigned long lastRun;
+
+        // value of sequence when the handler was last called
+        unsigned long seen;
+    };
+
+    // returns true if the subscriber has new samples and may run now
+    boolean ready(Subscriber& s, unsigned long now);
+
+    int32_t values[SAMPLEBUS_MAX_KINDS];
+    unsigned long timestamps[SAMPLEBUS_MAX_KINDS];
+
+    // value of sequence when each kind was last published, 0 if never
+    unsigned long published[SAMPLEBUS_MAX_KINDS];
+
+    // counts publish() calls
+    unsigned long sequence;
+
+    Subscriber subscribers[SAMPLEBUS_MAX_SUBSCRIBERS];
+
+    // subscriber dispatch() looks at first
+    int next;
+};
+
+#endif
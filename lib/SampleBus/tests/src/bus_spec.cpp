@@ -0,0 +1,223 @@
+#include "SampleBus.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+#define KIND_A 0
+#define KIND_B 1
+#define KIND_C 2
+
+// order the handlers ran in, as their letters
+char calls[16];
+int callCount;
+
+void reset_calls() {
+    callCount = 0;
+    calls[0] = '\0';
+}
+
+void record(char c) {
+    if (callCount < 15) {
+        calls[callCount++] = c;
+        calls[callCount] = '\0';
+    }
+}
+
+void sinkA() { record('a'); }
+void sinkB() { record('b'); }
+void sinkC() { record('c'); }
+
+// runs dispatch() until it has nothing to call
+int drain(SampleBus& bus) {
+    int n = 0;
+    while (bus.dispatch()) {
+        n++;
+    }
+    return n;
+}
+
+
+int test_bus_values() {
+    IT("keeps the latest value and timestamp of each kind");
+    SampleBus bus;
+
+    IS_FALSE(bus.has(KIND_A));
+    IS_TRUE(bus.value(KIND_A) == 0);
+
+    advance(100);
+    bus.publish(KIND_A, 2345);
+    bus.publish(KIND_A, -1200);
+    IS_TRUE(bus.has(KIND_A));
+    IS_FALSE(bus.has(KIND_B));
+    IS_TRUE(bus.value(KIND_A) == -1200);
+    IS_TRUE(bus.timestamp(KIND_A) == millis());
+
+    // out of range kinds are ignored
+    bus.publish(SAMPLEBUS_MAX_KINDS, 1);
+    IS_FALSE(bus.has(SAMPLEBUS_MAX_KINDS));
+    IS_TRUE(bus.value(SAMPLEBUS_MAX_KINDS) == 0);
+
+    END_IT
+}
+
+int test_bus_subscribe_mask() {
+    IT("calls a subscriber only for the kinds in its mask");
+    reset_calls();
+    SampleBus bus;
+    bus.subscribe(SAMPLE_MASK(KIND_A), 0, sinkA);
+    bus.subscribe(SAMPLE_MASK(KIND_B) | SAMPLE_MASK(KIND_C), 0, sinkB);
+
+    IS_FALSE(bus.pending());
+    bus.publish(KIND_C, 1);
+    IS_TRUE(bus.pending());
+    IS_TRUE(drain(bus) == 1);
+    IS_TRUE(strcmp(calls, "b") == 0);
+
+    // each subscriber once, however many of its kinds are new
+    bus.publish(KIND_A, 1);
+    bus.publish(KIND_B, 1);
+    bus.publish(KIND_C, 1);
+    IS_TRUE(drain(bus) == 2);
+    IS_TRUE(strcmp(calls, "bab") == 0);
+    IS_FALSE(bus.pending());
+
+    END_IT
+}
+
+int test_bus_subscribe_earlier() {
+    IT("counts samples published before subscribing as new");
+    reset_calls();
+    SampleBus bus;
+    bus.publish(KIND_A, 1);
+
+    bus.subscribe(SAMPLE_MASK(KIND_A), 1000, sinkA);
+    IS_TRUE(drain(bus) == 1);
+    IS_TRUE(strcmp(calls, "a") == 0);
+
+    END_IT
+}
+
+int test_bus_interval() {
+    IT("calls a subscriber at most once every minimum interval");
+    reset_calls();
+    SampleBus bus;
+    int id = bus.subscribe(SAMPLE_MASK(KIND_A), 1000, sinkA);
+
+    bus.publish(KIND_A, 1);
+    IS_TRUE(drain(bus) == 1);
+
+    advance(999);
+    bus.publish(KIND_A, 2);
+    IS_FALSE(bus.pending());
+    IS_TRUE(drain(bus) == 0);
+
+    advance(1);
+    IS_TRUE(drain(bus) == 1);
+    IS_TRUE(callCount == 2);
+
+    // and at the new interval once it is changed
+    bus.setInterval(id, 10);
+    advance(10);
+    bus.publish(KIND_A, 3);
+    IS_TRUE(drain(bus) == 1);
+    IS_TRUE(callCount == 3);
+
+    END_IT
+}
+
+int test_bus_round_robin() {
+    IT("calls one subscriber per dispatch, round robin");
+    reset_calls();
+    SampleBus bus;
+    bus.subscribe(SAMPLE_MASK(KIND_A), 0, sinkA);
+    bus.subscribe(SAMPLE_MASK(KIND_A), 0, sinkB);
+    bus.subscribe(SAMPLE_MASK(KIND_A), 0, sinkC);
+
+    bus.publish(KIND_A, 1);
+    IS_TRUE(bus.dispatch());
+    IS_TRUE(strcmp(calls, "a") == 0);
+
+    // a new sample before the others ran does not put the first back
+    // in front of them
+    bus.publish(KIND_A, 2);
+    IS_TRUE(drain(bus) == 3);
+    IS_TRUE(strcmp(calls, "abca") == 0);
+
+    END_IT
+}
+
+int test_bus_unsubscribe() {
+    IT("stops calling a subscriber once it is removed, and reuses its slot");
+    reset_calls();
+    SampleBus bus;
+    int a = bus.subscribe(SAMPLE_MASK(KIND_A), 0, sinkA);
+    bus.subscribe(SAMPLE_MASK(KIND_A), 0, sinkB);
+
+    bus.unsubscribe(a);
+    bus.publish(KIND_A, 1);
+    IS_TRUE(drain(bus) == 1);
+    IS_TRUE(strcmp(calls, "b") == 0);
+
+    int c = bus.subscribe(SAMPLE_MASK(KIND_A), 0, sinkC);
+    IS_TRUE(c == a);
+
+    // out of range ids are ignored
+    bus.unsubscribe(-1);
+    bus.unsubscribe(SAMPLEBUS_MAX_SUBSCRIBERS);
+
+    END_IT
+}
+
+SampleBus* selfBus;
+int selfId;
+
+void sinkOnce() {
+    record('o');
+    selfBus->unsubscribe(selfId);
+}
+
+int test_bus_unsubscribe_self() {
+    IT("lets a handler unsubscribe itself");
+    reset_calls();
+    SampleBus bus;
+    selfBus = &bus;
+    selfId = bus.subscribe(SAMPLE_MASK(KIND_A), 0, sinkOnce);
+
+    bus.publish(KIND_A, 1);
+    IS_TRUE(drain(bus) == 1);
+    bus.publish(KIND_A, 2);
+    IS_TRUE(drain(bus) == 0);
+    IS_TRUE(strcmp(calls, "o") == 0);
+
+    END_IT
+}
+
+int test_bus_full() {
+    IT("refuses a subscriber when all are in use, or with no kinds or handler");
+    SampleBus bus;
+
+    for (int i = 0; i < SAMPLEBUS_MAX_SUBSCRIBERS; i++) {
+        IS_TRUE(bus.subscribe(SAMPLE_MASK(KIND_A), 0, sinkA) == i);
+    }
+    IS_TRUE(bus.subscribe(SAMPLE_MASK(KIND_A), 0, sinkA) == -1);
+
+    SampleBus empty;
+    IS_TRUE(empty.subscribe(0, 0, sinkA) == -1);
+    IS_TRUE(empty.subscribe(SAMPLE_MASK(KIND_A), 0, TimerTask()) == -1);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("SampleBus");
+    test_bus_values();
+    test_bus_subscribe_mask();
+    test_bus_subscribe_earlier();
+    test_bus_interval();
+    test_bus_round_robin();
+    test_bus_unsubscribe();
+    test_bus_unsubscribe_self();
+    test_bus_full();
+
+    FINISH
+}
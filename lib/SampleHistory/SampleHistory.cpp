@@ -0,0 +1,170 @@
+/*
+ * SampleHistory.cpp
+ *
+ * SampleHistory - a fixed-capacity history of timestamped multi-channel
+ * samples, with oversampling and a sliding median per channel.
+ */
+
+
+#include "SampleHistory.h"
+
+
+SlidingMedianBase::SlidingMedianBase(int32_t* data, int* pos, int* heap, int capacity) {
+    this->data = data;
+    this->pos = pos;
+    // the max-heap grows to negative indexes, the min-heap to positive ones
+    this->heap = heap + capacity / 2;
+    this->capacity = capacity;
+    clear();
+}
+
+
+void SlidingMedianBase::clear() {
+    index = 0;
+    held = 0;
+
+    // fill pattern while filling up: median, max, min, max, min...
+    for (int i = 0; i < capacity; i++) {
+        data[i] = 0;
+        pos[i] = ((i + 1) / 2) * ((i & 1) ? -1 : 1);
+        heap[pos[i]] = i;
+    }
+}
+
+
+void SlidingMedianBase::push(int32_t value) {
+    boolean filling = held < capacity;
+    int p = pos[index];
+    int32_t old = data[index];
+
+    data[index] = value;
+    index = (index + 1) % capacity;
+    if (filling) {
+        held++;
+    }
+
+    if (p > 0) {
+        // the value is in the min-heap
+        if (!filling && old < value) {
+            minSortDown(p * 2);
+        }
+        else if (minSortUp(p)) {
+            maxSortDown(-1);
+        }
+    }
+    else if (p < 0) {
+        // the value is in the max-heap
+        if (!filling && value < old) {
+            maxSortDown(p * 2);
+        }
+        else if (maxSortUp(p)) {
+            minSortDown(1);
+        }
+    }
+    else {
+        // the value is the median
+        if (maxCount()) {
+            maxSortDown(-1);
+        }
+        if (minCount()) {
+            minSortDown(1);
+        }
+    }
+}
+
+
+int32_t SlidingMedianBase::median() {
+    if (held == 0) {
+        return 0;
+    }
+
+    int32_t v = data[heap[0]];
+    if ((held & 1) == 0) {
+        // mean of the middle two, without overflow
+        int32_t below = data[heap[-1]];
+        v = below + (v - below) / 2;
+    }
+    return v;
+}
+
+
+int SlidingMedianBase::count() {
+    return held;
+}
+
+
+int SlidingMedianBase::minCount() {
+    return (held - 1) / 2;
+}
+
+
+int SlidingMedianBase::maxCount() {
+    return held / 2;
+}
+
+
+boolean SlidingMedianBase::less(int i, int j) {
+    return data[heap[i]] < data[heap[j]];
+}
+
+
+boolean SlidingMedianBase::exchange(int i, int j) {
+    int t = heap[i];
+    heap[i] = heap[j];
+    heap[j] = t;
+    pos[heap[i]] = i;
+    pos[heap[j]] = j;
+    return true;
+}
+
+
+boolean SlidingMedianBase::cmpExchange(int i, int j) {
+    return less(i, j) && exchange(i, j);
+}
+
+
+// restore the min-heap from index i down, i being the first child of
+// the entry that changed; 1 compares the min-heap's top with the median
+void SlidingMedianBase::minSortDown(int i) {
+    for (; i <= minCount(); i *= 2) {
+        if (i > 1 && i < minCount() && less(i + 1, i)) {
+            ++i;
+        }
+        if (!cmpExchange(i, i / 2)) {
+            break;
+        }
+    }
+}
+
+
+// restore the max-heap from index i down, as minSortDown()
+void SlidingMedianBase::maxSortDown(int i) {
+    for (; i >= -maxCount(); i *= 2) {
+        if (i < -1 && i > -maxCount() && less(i, i - 1)) {
+            --i;
+        }
+        if (!cmpExchange(i / 2, i)) {
+            break;
+        }
+    }
+}
+
+
+// restore the min-heap above index i; returns true if the value moved
+// up to the median
+boolean SlidingMedianBase::minSortUp(int i) {
+    while (i > 0 && cmpExchange(i, i / 2)) {
+        i /= 2;
+    }
+    return i == 0;
+}
+
+
+// restore the max-heap above index i; returns true if the value moved
+// up to the median
+boolean SlidingMedianBase::maxSortUp(int i) {
+    while (i < 0 && cmpExchange(i / 2, i)) {
+        i /= 2;
+    }
+    return i == 0;
+}
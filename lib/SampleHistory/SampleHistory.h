@@ -0,0 +1,220 @@
+/*
+ * SampleHistory.h
+ *
+ * SampleHistory - a fixed-capacity history of timestamped multi-channel
+ * samples, with oversampling and a sliding median per channel.
+ *
+ * Each add() passes one raw reading of every channel, as integers in the
+ * sketch's fixed-point scales. Every setOversampling() readings are
+ * averaged into one entry of the history, which keeps the newest CAPACITY
+ * entries. The entries are stored channel by channel (one array of
+ * values per channel and one of timestamps), so a scan of one channel
+ * reads consecutive memory.
+ *
+ * Each channel also keeps the median of its newest WINDOW entries, which
+ * drops single spikes such as a bad I2C read. It is updated in
+ * O(log WINDOW) as each entry is added, so median() costs nothing to read
+ * however many consumers ask for it.
+ */
+
+
+#ifndef SAMPLEHISTORY_H
+#define SAMPLEHISTORY_H
+
+#include <Arduino.h>
+
+// Running median of the last N values pushed. The values sit in a ring;
+// a max-heap of the values below the median and a min-heap of those
+// above it share one array around the median, and each push only moves
+// the replaced value's heap entry up or down.
+class SlidingMedianBase {
+
+public:
+    // add a value, replacing the oldest one once N values are held
+    void push(int32_t value);
+
+    // median of the values held, the mean of the middle two for an even
+    // count; 0 if there are none
+    int32_t median();
+
+    // number of values held
+    int count();
+
+    // forget all values
+    void clear();
+
+protected:
+    SlidingMedianBase(int32_t* data, int* pos, int* heap, int capacity);
+
+private:
+    SlidingMedianBase(const SlidingMedianBase&);
+    SlidingMedianBase& operator=(const SlidingMedianBase&);
+
+    // heap maintenance; heap indexes are > 0 in the min-heap, < 0 in the
+    // max-heap and 0 for the median
+    boolean less(int i, int j);
+    boolean exchange(int i, int j);
+    boolean cmpExchange(int i, int j);
+    void minSortDown(int i);
+    void maxSortDown(int i);
+    boolean minSortUp(int i);
+    boolean maxSortUp(int i);
+    int minCount();
+    int maxCount();
+
+    // ring of the values
+    int32_t* data;
+
+    // heap index of each value in data
+    int* pos;
+
+    // indexes into data, centered on the median
+    int* heap;
+
+    int capacity;
+
+    // next value of data to replace
+    int index;
+
+    int held;
+};
+
+// A sliding median over N values, all allocated inline.
+template<int N>
+class SlidingMedian : public SlidingMedianBase {
+
+public:
+    SlidingMedian() : SlidingMedianBase(dataStorage, posStorage, heapStorage, N) {}
+
+private:
+    static_assert(N > 0, "SlidingMedian needs a window of at least one value");
+
+    int32_t dataStorage[N];
+    int posStorage[N];
+    int heapStorage[N];
+};
+
+template<int CHANNELS, int CAPACITY, int WINDOW = 5>
+class SampleHistory {
+
+public:
+    // constructor
+    SampleHistory() {
+        oversampling = 1;
+        clear();
+    }
+
+    // average n raw readings into each entry
+    void setOversampling(uint8_t n) {
+        oversampling = n ? n : 1;
+        restart();
+    }
+
+    // add one raw reading of every channel; returns true if it completed
+    // a new entry
+    boolean add(const int32_t* sample) {
+        return add(sample, millis());
+    }
+
+    // same, for a reading taken at time, as a value of millis()
+    boolean add(const int32_t* sample, unsigned long time) {
+        for (int c = 0; c < CHANNELS; c++) {
+            sums[c] += sample[c];
+        }
+        if (++accumulated < oversampling) {
+            return false;
+        }
+
+        head = (head + 1) % CAPACITY;
+        times[head] = time;
+        for (int c = 0; c < CHANNELS; c++) {
+            int32_t average = sums[c] / oversampling;
+            values[c][head] = average;
+            medians[c].push(average);
+        }
+        if (stored < CAPACITY) {
+            stored++;
+        }
+
+        restart();
+        return true;
+    }
+
+    // number of entries held
+    int count() {
+        return stored;
+    }
+
+    // value of millis() when an entry was completed; age 0 is the newest
+    unsigned long time(int age) {
+        return times[slot(age)];
+    }
+
+    // value of a channel in an entry; age 0 is the newest
+    int32_t value(uint8_t channel, int age) {
+        return values[channel][slot(age)];
+    }
+
+    // median of the newest WINDOW entries of a channel
+    int32_t median(uint8_t channel) {
+        return medians[channel].median();
+    }
+
+    // mean of the newest n entries of a channel
+    int32_t average(uint8_t channel, int n) {
+        if (n > stored) {
+            n = stored;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+
+        int64_t sum = 0;
+        for (int age = 0; age < n; age++) {
+            sum += values[channel][slot(age)];
+        }
+        return (int32_t)(sum / n);
+    }
+
+    // forget all entries
+    void clear() {
+        head = CAPACITY - 1;
+        stored = 0;
+        for (int c = 0; c < CHANNELS; c++) {
+            medians[c].clear();
+        }
+        restart();
+    }
+
+private:
+    static_assert(CHANNELS > 0 && CAPACITY > 0, "SampleHistory needs a channel and an entry");
+
+    // start accumulating the next entry
+    void restart() {
+        accumulated = 0;
+        for (int c = 0; c < CHANNELS; c++) {
+            sums[c] = 0;
+        }
+    }
+
+    // array index of the entry age entries before the newest
+    int slot(int age) {
+        return (head - age % CAPACITY + CAPACITY) % CAPACITY;
+    }
+
+    unsigned long times[CAPACITY];
+    int32_t values[CHANNELS][CAPACITY];
+
+    // index of the newest entry
+    int head;
+    int stored;
+
+    // readings summed for the entry in progress
+    int32_t sums[CHANNELS];
+    uint8_t accumulated;
+    uint8_t oversampling;
+
+    SlidingMedian<WINDOW> medians[CHANNELS];
+};
+
+#endif
@@ -0,0 +1,220 @@
+#include "SampleHistory.h"
+#include "BDDTest.h"
+#include "trace.h"
+#include <algorithm>
+
+// a repeatable pseudo-random sequence
+uint32_t seed = 12345;
+
+int32_t next(int32_t range) {
+    seed = seed * 1103515245 + 12345;
+    return (int32_t)((seed >> 8) % range) - range / 2;
+}
+
+// median of the newest min(count, n) values of ring, by sorting them; the
+// mean of the middle two, rounded down, for an even count
+int32_t sortedMedian(const int32_t* ring, int count, int n) {
+    int held = count < n ? count : n;
+    if (held == 0) {
+        return 0;
+    }
+    int32_t sorted[16];
+    for (int i = 0; i < held; i++) {
+        sorted[i] = ring[i];
+    }
+    std::sort(sorted, sorted + held);
+    if (held & 1) {
+        return sorted[held / 2];
+    }
+    int32_t below = sorted[held / 2 - 1];
+    return below + (sorted[held / 2] - below) / 2;
+}
+
+// pushes count values of the given range into a window of N, comparing
+// the median with the sorted one after every push
+template<int N>
+bool slidingMatchesSort(int count, int32_t range) {
+    SlidingMedian<N> median;
+    int32_t ring[N];
+
+    for (int i = 0; i < count; i++) {
+        int32_t v = next(range);
+        median.push(v);
+        ring[i % N] = v;
+        if (median.median() != sortedMedian(ring, i + 1, N)) {
+            TRACE("window " << N << " push " << i << ": " << median.median() << " ");
+            return false;
+        }
+    }
+    return median.count() == (count < N ? count : N);
+}
+
+
+int test_median_sorted() {
+    IT("matches the median of the sorted window on every push, across the wrap");
+
+    IS_TRUE(slidingMatchesSort<1>(100, 1000));
+    IS_TRUE(slidingMatchesSort<2>(1000, 1000));
+    IS_TRUE(slidingMatchesSort<3>(1000, 1000));
+    IS_TRUE(slidingMatchesSort<4>(1000, 1000));
+    IS_TRUE(slidingMatchesSort<5>(2000, 1000000));
+    IS_TRUE(slidingMatchesSort<8>(2000, 1000000));
+    IS_TRUE(slidingMatchesSort<9>(2000, 1000000));
+    IS_TRUE(slidingMatchesSort<16>(2000, 1000000));
+
+    END_IT
+}
+
+int test_median_duplicates() {
+    IT("matches the sorted median with many equal values");
+
+    IS_TRUE(slidingMatchesSort<5>(2000, 3));
+    IS_TRUE(slidingMatchesSort<6>(2000, 3));
+    IS_TRUE(slidingMatchesSort<7>(2000, 1));
+
+    END_IT
+}
+
+int test_median_extremes() {
+    IT("takes the mean of the middle two without overflow");
+    SlidingMedian<2> median;
+
+    median.push(INT32_MAX);
+    median.push(INT32_MAX - 2);
+    IS_TRUE(median.median() == INT32_MAX - 1);
+
+    median.push(INT32_MIN);
+    median.push(INT32_MIN + 2);
+    IS_TRUE(median.median() == INT32_MIN + 1);
+
+    END_IT
+}
+
+int test_median_spike() {
+    IT("drops a single spike from a window of five");
+    SlidingMedian<5> median;
+
+    int32_t readings[] = { 2000, 2001, 9999, 2002, 2001 };
+    for (int i = 0; i < 5; i++) {
+        median.push(readings[i]);
+    }
+    IS_TRUE(median.median() == 2001);
+
+    END_IT
+}
+
+int test_median_clear() {
+    IT("starts over after clear()");
+    SlidingMedian<3> median;
+
+    IS_TRUE(median.median() == 0);
+    median.push(10);
+    median.push(20);
+    median.push(30);
+    median.clear();
+    IS_TRUE(median.count() == 0);
+    IS_TRUE(median.median() == 0);
+    median.push(7);
+    IS_TRUE(median.median() == 7);
+
+    END_IT
+}
+
+int test_history_wrap() {
+    IT("keeps the newest CAPACITY entries, newest first, across the wrap");
+    SampleHistory<2, 4> history;
+
+    for (int32_t i = 0; i < 10; i++) {
+        int32_t sample[2] = { i, -i };
+        IS_TRUE(history.add(sample, 1000 + i));
+        IS_TRUE(history.count() == (i < 4 ? i + 1 : 4));
+    }
+    for (int age = 0; age < 4; age++) {
+        IS_TRUE(history.value(0, age) == 9 - age);
+        IS_TRUE(history.value(1, age) == age - 9);
+        IS_TRUE(history.time(age) == 1009UL - age);
+    }
+    IS_TRUE(history.average(0, 2) == 8);
+    IS_TRUE(history.average(0, 10) == 7);
+
+    END_IT
+}
+
+int test_history_median() {
+    IT("keeps the median of the newest WINDOW entries of each channel");
+    SampleHistory<2, 8, 5> history;
+    int32_t ring[2][5];
+
+    for (int i = 0; i < 500; i++) {
+        int32_t sample[2] = { next(10000), next(10) };
+        history.add(sample);
+        ring[0][i % 5] = sample[0];
+        ring[1][i % 5] = sample[1];
+        IS_TRUE(history.median(0) == sortedMedian(ring[0], i + 1, 5));
+        IS_TRUE(history.median(1) == sortedMedian(ring[1], i + 1, 5));
+    }
+
+    END_IT
+}
+
+int test_history_oversampling() {
+    IT("averages setOversampling() readings into each entry");
+    SampleHistory<1, 4> history;
+    history.setOversampling(3);
+
+    int32_t readings[] = { 10, 20, 30, 1, 2, 4 };
+    for (int i = 0; i < 6; i++) {
+        int32_t sample[1] = { readings[i] };
+        IS_TRUE(history.add(sample, 100 + i) == (i % 3 == 2));
+    }
+    IS_TRUE(history.count() == 2);
+    IS_TRUE(history.value(0, 1) == 20);
+    IS_TRUE(history.value(0, 0) == 2);
+    // the entry takes the time of its last reading
+    IS_TRUE(history.time(0) == 105);
+
+    // a change drops the entry in progress
+    int32_t sample[1] = { 1000 };
+    history.add(sample);
+    history.setOversampling(2);
+    sample[0] = 50;
+    IS_FALSE(history.add(sample));
+    IS_TRUE(history.add(sample));
+    IS_TRUE(history.value(0, 0) == 50);
+
+    // 0 means 1
+    history.setOversampling(0);
+    IS_TRUE(history.add(sample));
+
+    END_IT
+}
+
+int test_history_clear() {
+    IT("forgets every entry and median after clear()");
+    SampleHistory<1, 4> history;
+    int32_t sample[1] = { 42 };
+
+    history.add(sample);
+    history.clear();
+    IS_TRUE(history.count() == 0);
+    IS_TRUE(history.median(0) == 0);
+    IS_TRUE(history.average(0, 4) == 0);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("SampleHistory");
+    test_median_sorted();
+    test_median_duplicates();
+    test_median_extremes();
+    test_median_spike();
+    test_median_clear();
+    test_history_wrap();
+    test_history_median();
+    test_history_oversampling();
+    test_history_clear();
+
+    FINISH
+}
@@ -32,96 +32,272 @@
 static inline unsigned long elapsed() { return millis(); }
 
 
-SimpleTimer::SimpleTimer() {
-    unsigned long current_millis = elapsed();
-
-    for (int i = 0; i < MAX_TIMERS; i++) {
-        enabled[i] = false;
-        callbacks[i] = 0;                   // if the callback pointer is zero, the slot is free, i.e. doesn't "contain" any timer
-        prev_millis[i] = current_millis;
-        numRuns[i] = 0;
-    }
+SimpleTimerBase::SimpleTimerBase(Slot* slots, int* heap, int* due, int capacity) {
+    // the slots themselves are initialized by their constructor
+    this->slots = slots;
+    this->heap = heap;
+    this->due = due;
+    this->capacity = capacity;
 
     numTimers = 0;
+    heapSize = 0;
+    budget = 0;
+    runningPriority = 0xFF;
 }
 
 
-void SimpleTimer::run() {
+void SimpleTimerBase::run() {
     int i;
+    int numDue;
     unsigned long current_millis;
+    unsigned long start;
 
     // get current time
     current_millis = elapsed();
 
-    for (i = 0; i < MAX_TIMERS; i++) {
+    // nothing is due before the earliest deadline
+    // see http://arduino.cc/forum/index.php/topic,124048.msg932592.html#msg932592
+    if (heapSize == 0 || (long)(current_millis - slots[heap[0]].deadline) < 0) {
+        return;
+    }
+
+    // take every due timer off the heap first, so that a timer that is
+    // several periods late is still only handled once per run()
+    numDue = 0;
+    while (heapSize > 0 && (long)(current_millis - slots[heap[0]].deadline) >= 0) {
+        i = heap[0];
+        heapRemove(i);
+
+        // most important first, earliest deadline first within a priority,
+        // but never ahead of the timer it runs after
+        int k = numDue++;
+        while (k > 0 && due[k - 1] != slots[i].runsAfter &&
+                (slots[due[k - 1]].priority > slots[i].priority || slots[due[k - 1]].runsAfter == i)) {
+            due[k] = due[k - 1];
+            k--;
+        }
+        due[k] = i;
+    }
+
+    start = micros();
+    for (int k = 0; k < numDue; k++) {
+        i = due[k];
+
+        // an earlier callback deleted this timer, or deleted it and set a
+        // new one in its slot
+        if (!slots[i].callback || slots[i].heapPos >= 0) {
+            continue;
+        }
 
-        toBeCalled[i] = DEFCALL_DONTRUN;
+        // over budget: leave the timer due for the next run()
+        if (budget && slots[i].priority > PRIORITY_HIGH && micros() - start >= budget) {
+            heapInsert(i);
+            continue;
+        }
 
-        // no callback == no timer, i.e. jump over empty slots
-        if (callbacks[i]) {
+        runSlot(i, current_millis);
+    }
+}
 
-            // is it time to process this timer ?
-            // see http://arduino.cc/forum/index.php/topic,124048.msg932592.html#msg932592
 
-            if (current_millis - prev_millis[i] >= delays[i]) {
+void SimpleTimerBase::yieldTask(int priority) {
+    unsigned long current_millis = elapsed();
 
-                // update time
-                //prev_millis[i] = current_millis;
-                prev_millis[i] += delays[i];
+    for (int i = 0; i < capacity; i++) {
+        Slot& t = slots[i];
+        if (t.callback && t.heapPos >= 0 && t.priority < runningPriority && t.priority <= priority &&
+                (long)(current_millis - t.deadline) >= 0) {
+            heapRemove(i);
+            runSlot(i, current_millis);
+        }
+    }
+}
 
-                // check if the timer callback has to be executed
-                if (enabled[i]) {
 
-                    // "run forever" timers must always be executed
-                    if (maxNumRuns[i] == RUN_FOREVER) {
-                        toBeCalled[i] = DEFCALL_RUNONLY;
-                    }
-                    // other timers get executed the specified number of times
-                    else if (numRuns[i] < maxNumRuns[i]) {
-                        toBeCalled[i] = DEFCALL_RUNONLY;
-                        numRuns[i]++;
+// reschedule a due timer that has been taken off the heap, then call it
+void SimpleTimerBase::runSlot(int i, unsigned long current_millis) {
+    Slot& t = slots[i];
+    int toBeCalled = DEFCALL_DONTRUN;
+    t.dueAt = t.deadline;
 
-                        // after the last run, delete the timer
-                        if (numRuns[i] >= maxNumRuns[i]) {
-                            toBeCalled[i] = DEFCALL_RUNANDDEL;
-                        }
-                    }
-                }
+    // update time
+    if (t.delay <= 0) {
+        t.deadline = current_millis;
+    }
+    else if (t.policy == SKIP) {
+        unsigned long missed = (current_millis - t.deadline) / t.delay;
+        t.deadline += (missed + 1) * t.delay;
+        t.missed += missed;
+    }
+    else if (t.policy == COALESCE) {
+        t.missed += (current_millis - t.deadline) / t.delay;
+        t.deadline = current_millis + t.delay;
+    }
+    else {
+        // a tick run when the next one is already due was missed on time,
+        // even though CATCH_UP still makes it up
+        if (current_millis - t.deadline >= (unsigned long)t.delay) {
+            t.missed++;
+        }
+        t.deadline += t.delay;
+    }
+    heapInsert(i);
+
+    // check if the timer callback has to be executed
+    if (t.enabled) {
+
+        // "run forever" timers must always be executed
+        if (t.maxNumRuns == RUN_FOREVER) {
+            toBeCalled = DEFCALL_RUNONLY;
+        }
+        // other timers get executed the specified number of times
+        else if (t.numRuns < t.maxNumRuns) {
+            toBeCalled = DEFCALL_RUNONLY;
+            t.numRuns++;
+
+            // after the last run, delete the timer
+            if (t.numRuns >= t.maxNumRuns) {
+                toBeCalled = DEFCALL_RUNANDDEL;
             }
         }
     }
 
-    for (i = 0; i < MAX_TIMERS; i++) {
-        switch(toBeCalled[i]) {
-            case DEFCALL_DONTRUN:
-                break;
+    if (toBeCalled == DEFCALL_DONTRUN) {
+        return;
+    }
+
+    // call a copy, the callback may delete its own timer
+    TimerTask task = t.callback;
+    uint8_t generation = t.generation;
+    uint8_t previousPriority = runningPriority;
+    unsigned long lateness = elapsed() - t.dueAt;
+    unsigned long start;
+
+    runningPriority = t.priority;
+    if (toBeCalled == DEFCALL_RUNANDDEL) {
+        freeSlot(i);
+        task();
+    }
+    else {
+        start = micros();
+        task();
+        if (t.callback && t.generation == generation) {
+            recordCall(t, micros() - start, lateness);
+        }
+    }
+    runningPriority = previousPriority;
+}
+
+
+void SimpleTimerBase::recordCall(Slot& t, unsigned long duration, unsigned long lateness) {
+    if (t.calls == 0 || duration < t.minMicros) {
+        t.minMicros = duration;
+    }
+    if (duration > t.maxMicros) {
+        t.maxMicros = duration;
+    }
+    if (lateness > t.maxLateness) {
+        t.maxLateness = lateness;
+    }
+    t.totalMicros += duration;
+    t.totalLateness += lateness;
+    t.calls++;
+}
+
+
+unsigned long SimpleTimerBase::nextDeadline() {
+    if (heapSize == 0) {
+        return elapsed() + 0x7FFFFFFFUL;
+    }
+
+    return slots[heap[0]].deadline;
+}
+
+
+// true if slot a is due before slot b, allowing for millis() rollover
+boolean SimpleTimerBase::before(int a, int b) {
+    return (long)(slots[a].deadline - slots[b].deadline) < 0;
+}
+
+
+void SimpleTimerBase::heapSwap(int i, int j) {
+    int t = heap[i];
+    heap[i] = heap[j];
+    heap[j] = t;
+    slots[heap[i]].heapPos = i;
+    slots[heap[j]].heapPos = j;
+}
+
+
+void SimpleTimerBase::heapUp(int pos) {
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!before(heap[pos], heap[parent])) {
+            break;
+        }
+        heapSwap(pos, parent);
+        pos = parent;
+    }
+}
 
-            case DEFCALL_RUNONLY:
-                (*callbacks[i])();
-                break;
 
-            case DEFCALL_RUNANDDEL:
-                (*callbacks[i])();
-                deleteTimer(i);
-                break;
+void SimpleTimerBase::heapDown(int pos) {
+    for (;;) {
+        int child = 2 * pos + 1;
+        if (child >= heapSize) {
+            break;
+        }
+        if (child + 1 < heapSize && before(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!before(heap[child], heap[pos])) {
+            break;
         }
+        heapSwap(pos, child);
+        pos = child;
+    }
+}
+
+
+void SimpleTimerBase::heapInsert(int slot) {
+    heap[heapSize] = slot;
+    slots[slot].heapPos = heapSize;
+    heapSize++;
+    heapUp(heapSize - 1);
+}
+
+
+void SimpleTimerBase::heapRemove(int slot) {
+    int pos = slots[slot].heapPos;
+    if (pos < 0) {
+        return;
+    }
+
+    heapSize--;
+    slots[slot].heapPos = -1;
+    if (pos < heapSize) {
+        int moved = heap[heapSize];
+        heap[pos] = moved;
+        slots[moved].heapPos = pos;
+        heapUp(pos);
+        heapDown(slots[moved].heapPos);
     }
 }
 
 
 // find the first available slot
 // return -1 if none found
-int SimpleTimer::findFirstFreeSlot() {
+int SimpleTimerBase::findFirstFreeSlot() {
     int i;
 
     // all slots are used
-    if (numTimers >= MAX_TIMERS) {
+    if (numTimers >= capacity) {
         return -1;
     }
 
     // return the first slot with no callback (i.e. free)
-    for (i = 0; i < MAX_TIMERS; i++) {
-        if (callbacks[i] == 0) {
+    for (i = 0; i < capacity; i++) {
+        if (!slots[i].callback) {
             return i;
         }
     }
@@ -131,7 +307,23 @@ int SimpleTimer::findFirstFreeSlot() {
 }
 
 
-int SimpleTimer::setTimer(long d, timer_callback f, int n) {
+// return -1 for an invalid id or a timer that has since been deleted
+int SimpleTimerBase::findSlot(int numTimer) {
+    int slot = numTimer & 0xFF;
+
+    if (numTimer < 0 || slot >= capacity) {
+        return -1;
+    }
+
+    if (!slots[slot].callback || slots[slot].generation != (numTimer >> 8)) {
+        return -1;
+    }
+
+    return slot;
+}
+
+
+int SimpleTimerBase::setTimer(long d, TimerTask f, int n) {
     int freeTimer;
 
     freeTimer = findFirstFreeSlot();
@@ -139,50 +331,61 @@ int SimpleTimer::setTimer(long d, timer_callback f, int n) {
         return -1;
     }
 
-    if (f == NULL) {
+    if (!f) {
         return -1;
     }
 
-    delays[freeTimer] = d;
-    callbacks[freeTimer] = f;
-    maxNumRuns[freeTimer] = n;
-    enabled[freeTimer] = true;
-    prev_millis[freeTimer] = elapsed();
+    Slot& t = slots[freeTimer];
+    t.delay = d;
+    t.callback = f;
+    t.maxNumRuns = n;
+    t.numRuns = 0;
+    t.enabled = true;
+    t.policy = CATCH_UP;
+    t.priority = PRIORITY_NORMAL;
+    t.name = NULL;
+    t.resetStats();
+    t.deadline = elapsed() + d;
+    heapInsert(freeTimer);
+
+    // keep ids positive where int is 16 bits
+    t.generation = (t.generation % 0x7F) + 1;
 
     numTimers++;
 
-    return freeTimer;
+    return (t.generation << 8) | freeTimer;
 }
 
 
-int SimpleTimer::setInterval(long d, timer_callback f) {
+int SimpleTimerBase::setInterval(long d, TimerTask f) {
     return setTimer(d, f, RUN_FOREVER);
 }
 
 
-int SimpleTimer::setTimeout(long d, timer_callback f) {
+int SimpleTimerBase::setTimeout(long d, TimerTask f) {
     return setTimer(d, f, RUN_ONCE);
 }
 
 
-void SimpleTimer::deleteTimer(int timerId) {
-    if (timerId >= MAX_TIMERS) {
-        return;
-    }
-
-    // nothing to delete if no timers are in use
-    if (numTimers == 0) {
-        return;
-    }
+void SimpleTimerBase::freeSlot(int slot) {
+    Slot& t = slots[slot];
 
     // don't decrease the number of timers if the
     // specified slot is already empty
-    if (callbacks[timerId] != NULL) {
-        callbacks[timerId] = 0;
-        enabled[timerId] = false;
-        toBeCalled[timerId] = DEFCALL_DONTRUN;
-        delays[timerId] = 0;
-        numRuns[timerId] = 0;
+    if (t.callback) {
+        t.callback.clear();
+        t.enabled = false;
+        t.delay = 0;
+        t.numRuns = 0;
+        t.runsAfter = -1;
+        heapRemove(slot);
+
+        // the timers that ran after this one no longer depend on anything
+        for (int i = 0; i < capacity; i++) {
+            if (slots[i].runsAfter == slot) {
+                slots[i].runsAfter = -1;
+            }
+        }
 
         // update number of timers
         numTimers--;
@@ -190,52 +393,212 @@ void SimpleTimer::deleteTimer(int timerId) {
 }
 
 
+void SimpleTimerBase::deleteTimer(int timerId) {
+    int slot = findSlot(timerId);
+    if (slot < 0) {
+        return;
+    }
+
+    freeSlot(slot);
+}
+
+
 // function contributed by code@rowansimms.com
-void SimpleTimer::restartTimer(int numTimer) {
-    if (numTimer >= MAX_TIMERS) {
+void SimpleTimerBase::restartTimer(int numTimer) {
+    int slot = findSlot(numTimer);
+    if (slot < 0) {
         return;
     }
 
-    prev_millis[numTimer] = elapsed();
+    heapRemove(slot);
+    slots[slot].deadline = elapsed() + slots[slot].delay;
+    heapInsert(slot);
 }
 
 
-boolean SimpleTimer::isEnabled(int numTimer) {
-    if (numTimer >= MAX_TIMERS) {
+boolean SimpleTimerBase::isEnabled(int numTimer) {
+    int slot = findSlot(numTimer);
+    if (slot < 0) {
         return false;
     }
 
-    return enabled[numTimer];
+    return slots[slot].enabled;
+}
+
+
+void SimpleTimerBase::enable(int numTimer) {
+    int slot = findSlot(numTimer);
+    if (slot < 0) {
+        return;
+    }
+
+    slots[slot].enabled = true;
+}
+
+
+void SimpleTimerBase::disable(int numTimer) {
+    int slot = findSlot(numTimer);
+    if (slot < 0) {
+        return;
+    }
+
+    slots[slot].enabled = false;
+}
+
+
+void SimpleTimerBase::toggle(int numTimer) {
+    int slot = findSlot(numTimer);
+    if (slot < 0) {
+        return;
+    }
+
+    slots[slot].enabled = !slots[slot].enabled;
+}
+
+
+void SimpleTimerBase::setMissedTickPolicy(int numTimer, int policy) {
+    int slot = findSlot(numTimer);
+    if (slot < 0) {
+        return;
+    }
+
+    slots[slot].policy = policy;
+}
+
+
+void SimpleTimerBase::setPhase(int numTimer, long offset) {
+    int slot = findSlot(numTimer);
+    if (slot < 0) {
+        return;
+    }
+
+    heapRemove(slot);
+    slots[slot].deadline = elapsed() + offset;
+    heapInsert(slot);
 }
 
 
-void SimpleTimer::enable(int numTimer) {
-    if (numTimer >= MAX_TIMERS) {
+void SimpleTimerBase::runAfter(int numTimer, int producer) {
+    int slot = findSlot(numTimer);
+    int producerSlot = findSlot(producer);
+    if (slot < 0 || producerSlot < 0 || slot == producerSlot) {
         return;
     }
 
-    enabled[numTimer] = true;
+    slots[slot].runsAfter = producerSlot;
+}
+
+
+// number of timers ahead of slot in its runAfter() chain
+int SimpleTimerBase::chainDepth(int slot) {
+    int depth = 0;
+
+    // a chain can't be longer than the number of slots, unless it loops
+    while (slots[slot].runsAfter >= 0 && depth < capacity) {
+        slot = slots[slot].runsAfter;
+        depth++;
+    }
+
+    return depth;
 }
 
 
-void SimpleTimer::disable(int numTimer) {
-    if (numTimer >= MAX_TIMERS) {
+void SimpleTimerBase::stagger() {
+    int n = 0;
+    long period = 0;
+    unsigned long current_millis = elapsed();
+
+    // due[] is only free outside run()
+    if (runningPriority != 0xFF) {
         return;
     }
 
-    enabled[numTimer] = false;
+    // the repeating timers, producers before their consumers, then
+    // shortest period first
+    for (int i = 0; i < capacity; i++) {
+        Slot& t = slots[i];
+        if (!t.callback || t.maxNumRuns != RUN_FOREVER || t.delay <= 0) {
+            continue;
+        }
+        if (period == 0 || t.delay < period) {
+            period = t.delay;
+        }
+
+        int depth = chainDepth(i);
+        int k = n++;
+        while (k > 0 && (chainDepth(due[k - 1]) > depth ||
+                (chainDepth(due[k - 1]) == depth && slots[due[k - 1]].delay > t.delay))) {
+            due[k] = due[k - 1];
+            k--;
+        }
+        due[k] = i;
+    }
+
+    // one evenly spaced phase each within the shortest period
+    for (int k = 0; k < n; k++) {
+        heapRemove(due[k]);
+        slots[due[k]].deadline = current_millis + period * k / n;
+        heapInsert(due[k]);
+    }
 }
 
 
-void SimpleTimer::toggle(int numTimer) {
-    if (numTimer >= MAX_TIMERS) {
+void SimpleTimerBase::setPriority(int numTimer, int priority) {
+    int slot = findSlot(numTimer);
+    if (slot < 0) {
         return;
     }
 
-    enabled[numTimer] = !enabled[numTimer];
+    slots[slot].priority = priority;
 }
 
 
-int SimpleTimer::getNumTimers() {
+void SimpleTimerBase::setBudget(unsigned long micros) {
+    budget = micros;
+}
+
+
+void SimpleTimerBase::setName(int numTimer, const char* name) {
+    int slot = findSlot(numTimer);
+    if (slot < 0) {
+        return;
+    }
+
+    slots[slot].name = name;
+}
+
+
+boolean SimpleTimerBase::getStats(int index, TimerStats& stats) {
+    for (int i = 0; i < capacity; i++) {
+        Slot& t = slots[i];
+        if (!t.callback || index-- > 0) {
+            continue;
+        }
+
+        stats.id = (t.generation << 8) | i;
+        stats.name = t.name;
+        stats.interval = t.delay;
+        stats.calls = t.calls;
+        stats.minMicros = t.minMicros;
+        stats.maxMicros = t.maxMicros;
+        stats.avgMicros = t.calls ? (unsigned long)(t.totalMicros / t.calls) : 0;
+        stats.maxLateness = t.maxLateness;
+        stats.avgLateness = t.calls ? t.totalLateness / t.calls : 0;
+        stats.missed = t.missed;
+        return true;
+    }
+
+    return false;
+}
+
+
+void SimpleTimerBase::resetStats() {
+    for (int i = 0; i < capacity; i++) {
+        slots[i].resetStats();
+    }
+}
+
+
+int SimpleTimerBase::getNumTimers() {
     return numTimers;
-}
\ No newline at end of file
+}
@@ -35,32 +35,166 @@
 #include "application.h"
 #endif
 
+#include <new>
+
 typedef void (*timer_callback)(void);
 
-class SimpleTimer {
+// SIMPLETIMER_TASK_STORAGE : bytes available in a TimerTask for a
+//  callable and its captures, e.g. a lambda capturing this and one more
+//  pointer. Larger callables are rejected at compile time.
+#ifndef SIMPLETIMER_TASK_STORAGE
+#define SIMPLETIMER_TASK_STORAGE (3 * sizeof(void*))
+#endif
+
+// A callback with context: a plain function or any callable object small
+// enough to be stored inline, so no heap is used.
+class TimerTask {
 
 public:
-    // maximum number of timers
-    const static int MAX_TIMERS = 10;
+    TimerTask() : invoker(0), manager(0) {}
+
+    TimerTask(timer_callback f) : invoker(0), manager(0) {
+        if (f) {
+            assign(f);
+        }
+    }
+
+    template<typename F>
+    TimerTask(F f) : invoker(0), manager(0) {
+        assign(f);
+    }
+
+    TimerTask(const TimerTask& other) : invoker(0), manager(0) {
+        copyFrom(other);
+    }
+
+    TimerTask& operator=(const TimerTask& other) {
+        if (this != &other) {
+            clear();
+            copyFrom(other);
+        }
+        return *this;
+    }
+
+    ~TimerTask() { clear(); }
+
+    void operator()() { invoker(&storage); }
+
+    // true if a callable is stored
+    operator bool() const { return invoker != 0; }
+
+    // destroy the stored callable
+    void clear() {
+        if (manager) {
+            manager(&storage, 0);
+        }
+        invoker = 0;
+        manager = 0;
+    }
+
+private:
+    union Storage {
+        void* p;
+        long l;
+        double d;
+        unsigned char bytes[SIMPLETIMER_TASK_STORAGE];
+    };
+
+    template<typename F>
+    void assign(const F& f) {
+        static_assert(sizeof(F) <= sizeof(Storage), "callable too large for TimerTask, raise SIMPLETIMER_TASK_STORAGE");
+        static_assert(alignof(F) <= alignof(Storage), "callable over-aligned for TimerTask");
+        new (&storage) F(f);
+        invoker = &invoke<F>;
+        manager = &manage<F>;
+    }
+
+    void copyFrom(const TimerTask& other) {
+        if (other.manager) {
+            other.manager(&storage, &other.storage);
+        }
+        invoker = other.invoker;
+        manager = other.manager;
+    }
+
+    template<typename F>
+    static void invoke(Storage* s) { (*reinterpret_cast<F*>(s))(); }
+
+    // copy-constructs src into dst, or destroys dst when src is null
+    template<typename F>
+    static void manage(Storage* dst, const Storage* src) {
+        if (src) {
+            new (dst) F(*reinterpret_cast<const F*>(src));
+        }
+        else {
+            reinterpret_cast<F*>(dst)->~F();
+        }
+    }
 
+    Storage storage;
+    void (*invoker)(Storage*);
+    void (*manager)(Storage*, const Storage*);
+};
+
+// The timer logic, working on storage supplied by BasicSimpleTimer<N>.
+//
+// Timer ids are stable handles: the slot number in the low 8 bits and a
+// per-slot generation above it, so an id kept after its timer has ended
+// never acts on a later timer that reuses the slot.
+class SimpleTimerBase {
+
+public:
     // setTimer() constants
     const static int RUN_FOREVER = 0;
     const static int RUN_ONCE = 1;
 
-    // constructor
-    SimpleTimer();
+    // setMissedTickPolicy() constants: what run() does when it finds a
+    // timer more than one period late, e.g. after a long blocking call
+    const static int CATCH_UP = 0;      // call once per run() until every missed tick is made up
+    const static int SKIP = 1;          // call once, drop missed ticks, keep the original phase
+    const static int COALESCE = 2;      // call once, restart the period from now
+
+    // setPriority() constants; when several timers are due, run() calls
+    // the more important ones first
+    const static int PRIORITY_HIGH = 0;     // always run, never deferred by the budget
+    const static int PRIORITY_NORMAL = 1;
+    const static int PRIORITY_LOW = 2;
+
+    // what getStats() reports about a timer
+    struct TimerStats {
+        int id;                         // timer id
+        const char* name;               // as given to setName(), or NULL
+        long interval;                  // delay in milliseconds
+        unsigned long calls;            // callbacks timed
+        unsigned long minMicros;        // shortest callback, in microseconds
+        unsigned long avgMicros;        // mean callback duration
+        unsigned long maxMicros;        // longest callback
+        unsigned long avgLateness;      // mean delay of the callback past its deadline, in milliseconds
+        unsigned long maxLateness;      // longest such delay
+        unsigned long missed;           // ticks dropped by SKIP and COALESCE, or run a period or more late by CATCH_UP
+    };
 
     // this function must be called inside loop()
     void run();
 
+    // call from inside a long callback, e.g. while waiting on the network,
+    // to run the due timers of higher priority than the one being run and
+    // of at least the given priority; a callback not run by this timer,
+    // e.g. one dispatched from loop(), must give the priority it stands for
+    void yieldTask(int priority = PRIORITY_LOW);
+
+    // value of millis() at which the next timer is due; if no timer is
+    // set, a time far enough in the future to never be reached
+    unsigned long nextDeadline();
+
     // call function f every d milliseconds
-    int setInterval(long d, timer_callback f);
+    int setInterval(long d, TimerTask f);
 
     // call function f once after d milliseconds
-    int setTimeout(long d, timer_callback f);
+    int setTimeout(long d, TimerTask f);
 
     // call function f every d milliseconds for n times
-    int setTimer(long d, timer_callback f, int n);
+    int setTimer(long d, TimerTask f, int n);
 
     // destroy the specified timer
     void deleteTimer(int numTimer);
@@ -81,11 +215,113 @@ public:
     // and vice-versa
     void toggle(int numTimer);
 
+    // set the missed tick policy of the specified timer (default CATCH_UP)
+    void setMissedTickPolicy(int numTimer, int policy);
+
+    // make the next call of the specified timer offset milliseconds from
+    // now; later calls keep that phase
+    void setPhase(int numTimer, long offset);
+
+    // when the specified timer and producer are due together, call producer
+    // first; stagger() also gives the timer a later phase than producer
+    void runAfter(int numTimer, int producer);
+
+    // spread the phases of all repeating timers evenly over the shortest
+    // period, so that timers with related periods stop falling due in the
+    // same run(); each timer's next call is within that period. Call once
+    // the timers are set, not from a callback
+    void stagger();
+
+    // set the priority of the specified timer (default PRIORITY_NORMAL)
+    void setPriority(int numTimer, int priority);
+
+    // once callbacks have taken this many microseconds in one run(), due
+    // timers below PRIORITY_HIGH are left for the next run(); 0 (the
+    // default) means no limit
+    void setBudget(unsigned long micros);
+
+    // label the specified timer in its statistics; name is not copied
+    void setName(int numTimer, const char* name);
+
+    // statistics of the index'th timer in use, index 0 to
+    // getNumTimers() - 1; returns false when index is past the last timer
+    boolean getStats(int index, TimerStats& stats);
+
+    // zero the statistics of all timers
+    void resetStats();
+
     // returns the number of used timers
     int getNumTimers();
 
     // returns the number of available timers
-    int getNumAvailableTimers() { return MAX_TIMERS - numTimers; };
+    int getNumAvailableTimers() { return capacity - numTimers; };
+
+protected:
+    struct Slot {
+        Slot() : deadline(0), delay(0), maxNumRuns(0), numRuns(0), heapPos(-1),
+                 runsAfter(-1), policy(CATCH_UP), priority(PRIORITY_NORMAL), generation(0),
+                 enabled(false), name(0) {
+            resetStats();
+        }
+
+        void resetStats() {
+            calls = 0;
+            minMicros = 0;
+            maxMicros = 0;
+            totalMicros = 0;
+            maxLateness = 0;
+            totalLateness = 0;
+            missed = 0;
+        }
+
+        // the callback; an empty task means the slot is free
+        TimerTask callback;
+
+        // value of the millis() function at which the timer is next due
+        unsigned long deadline;
+
+        // delay value
+        long delay;
+
+        // number of runs to be executed
+        int maxNumRuns;
+
+        // number of executed runs
+        int numRuns;
+
+        // position in heap, -1 if not in it
+        int heapPos;
+
+        // slot of the timer this one runs after, -1 if none
+        int runsAfter;
+
+        // missed tick policy
+        uint8_t policy;
+
+        // priority
+        uint8_t priority;
+
+        // bumped each time the slot is reused, see timer ids above
+        uint8_t generation;
+
+        // whether the timer is enabled
+        boolean enabled;
+
+        // deadline the timer was found due for, set by run()
+        unsigned long dueAt;
+
+        // statistics, see TimerStats
+        const char* name;
+        unsigned long calls;
+        unsigned long minMicros;
+        unsigned long maxMicros;
+        uint64_t totalMicros;
+        unsigned long maxLateness;
+        unsigned long totalLateness;
+        unsigned long missed;
+    };
+
+    SimpleTimerBase(Slot* slots, int* heap, int* due, int capacity);
 
 private:
     // deferred call constants
@@ -93,33 +329,81 @@ private:
     const static int DEFCALL_RUNONLY = 1;       // call the callback function but don't delete the timer
     const static int DEFCALL_RUNANDDEL = 2;      // call the callback function and delete the timer
 
+    SimpleTimerBase(const SimpleTimerBase&);
+    SimpleTimerBase& operator=(const SimpleTimerBase&);
+
     // find the first available slot
     int findFirstFreeSlot();
 
-    // value returned by the millis() function
-    // in the previous run() call
-    unsigned long prev_millis[MAX_TIMERS];
+    // slot of a timer id, -1 if the timer no longer exists
+    int findSlot(int numTimer);
+
+    // free a slot
+    void freeSlot(int slot);
 
-    // pointers to the callback functions
-    timer_callback callbacks[MAX_TIMERS];
+    // length of the runAfter() chain ahead of a slot
+    int chainDepth(int slot);
 
-    // delay values
-    long delays[MAX_TIMERS];
+    // reschedule and call a due timer
+    void runSlot(int slot, unsigned long current_millis);
 
-    // number of runs to be executed for each timer
-    int maxNumRuns[MAX_TIMERS];
+    // add one timed callback to the statistics of t
+    void recordCall(Slot& t, unsigned long duration, unsigned long lateness);
 
-    // number of executed runs for each timer
-    int numRuns[MAX_TIMERS];
+    // deadline heap maintenance
+    boolean before(int a, int b);
+    void heapSwap(int i, int j);
+    void heapUp(int pos);
+    void heapDown(int pos);
+    void heapInsert(int slot);
+    void heapRemove(int slot);
 
-    // which timers are enabled
-    boolean enabled[MAX_TIMERS];
+    // per timer state
+    Slot* slots;
 
-    // deferred function call (sort of) - N.B.: this array is only used in run()
-    int toBeCalled[MAX_TIMERS];
+    // slots of the active timers as a binary min-heap ordered by deadline,
+    // so run() only has to look at heap[0] to know whether anything is due
+    int* heap;
+
+    // slots found due by run(), in the order it calls them
+    int* due;
+
+    // number of slots
+    int capacity;
+
+    // number of slots in heap
+    int heapSize;
+
+    // see setBudget()
+    unsigned long budget;
+
+    // priority of the callback being run, 0xFF outside callbacks
+    uint8_t runningPriority;
 
     // actual number of timers in use
     int numTimers;
 };
 
+// A timer with room for N timers, all allocated inline.
+template<int N>
+class BasicSimpleTimer : public SimpleTimerBase {
+
+public:
+    // maximum number of timers
+    const static int MAX_TIMERS = N;
+
+    // constructor
+    BasicSimpleTimer() : SimpleTimerBase(slotStorage, heapStorage, dueStorage, N) {}
+
+private:
+    static_assert(N > 0 && N <= 255, "BasicSimpleTimer supports 1 to 255 timers");
+
+    Slot slotStorage[N];
+    int heapStorage[N];
+    int dueStorage[N];
+};
+
+class SimpleTimer : public BasicSimpleTimer<10> {
+};
+
 #endif
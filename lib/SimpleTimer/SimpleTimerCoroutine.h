@@ -0,0 +1,173 @@
+/*
+ * SimpleTimerCoroutine.h
+ *
+ * C++20 coroutines driven by SimpleTimer.
+ *
+ * A function returning TimerCoroutine can wait without blocking loop():
+ *
+ *     TimerCoroutine readHumidity() {
+ *         sensor.startMeasurement();
+ *         co_await sleep_ms(25);
+ *         humidity = sensor.readMeasurement();
+ *     }
+ *
+ *     readHumidity().start(timer);
+ *
+ * Each co_await sets a timer in the SimpleTimer the coroutine was started
+ * on and returns to the caller; run() resumes the coroutine when the timer
+ * fires. The timer only sees millis(), so under a host build a fake
+ * millis() gives the coroutines a virtual clock.
+ *
+ * A co_await never blocks: when the timer has no free slot it returns
+ * false at once, without waiting, and the coroutine decides what to do:
+ *
+ *     if (!co_await sleep_ms(25)) {
+ *         co_return;
+ *     }
+ *
+ * A coroutine frame is allocated with operator new when the coroutine is
+ * called and freed when it returns. Every waiting coroutine also holds one
+ * timer slot.
+ *
+ * Only available when the compiler supports coroutines, e.g. g++ 10 or
+ * later with -std=c++20 (or -fcoroutines); otherwise this header is empty.
+ */
+
+
+#ifndef SIMPLETIMERCOROUTINE_H
+#define SIMPLETIMERCOROUTINE_H
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+
+#include <coroutine>
+#include <stdlib.h>
+#include "SimpleTimer.h"
+
+// SIMPLETIMER_POLL_MS : how often readable() checks its client
+#ifndef SIMPLETIMER_POLL_MS
+#define SIMPLETIMER_POLL_MS 10
+#endif
+
+class TimerCoroutine {
+
+public:
+    struct promise_type {
+        // the timer the coroutine was started on
+        SimpleTimerBase* timer = nullptr;
+
+        TimerCoroutine get_return_object() {
+            return TimerCoroutine(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        // the body only runs once start() has supplied a timer
+        std::suspend_always initial_suspend() { return {}; }
+
+        // the frame frees itself when the body returns
+        std::suspend_never final_suspend() noexcept { return {}; }
+
+        void return_void() {}
+
+        // sketches are built without exceptions
+        void unhandled_exception() { abort(); }
+    };
+
+    TimerCoroutine(TimerCoroutine&& other) : handle(other.handle) {
+        other.handle = nullptr;
+    }
+
+    // a coroutine that was never started is destroyed with its owner
+    ~TimerCoroutine() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    // run the coroutine up to its first co_await, then let timer resume it;
+    // the coroutine then owns itself
+    void start(SimpleTimerBase& timer) {
+        std::coroutine_handle<promise_type> h = handle;
+        handle = nullptr;
+        h.promise().timer = &timer;
+        h.resume();
+    }
+
+private:
+    explicit TimerCoroutine(std::coroutine_handle<promise_type> h) : handle(h) {}
+
+    TimerCoroutine(const TimerCoroutine&);
+    TimerCoroutine& operator=(const TimerCoroutine&);
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+
+// co_await sleep_ms(d): resume after d milliseconds; false if no timer
+// was free, in which case it did not wait
+class sleep_ms {
+
+public:
+    explicit sleep_ms(long d) : d(d), failed(false) {}
+
+    bool await_ready() { return d <= 0; }
+
+    bool await_suspend(std::coroutine_handle<TimerCoroutine::promise_type> h) {
+        failed = h.promise().timer->setTimeout(d, [h] { h.resume(); }) < 0;
+        return !failed;
+    }
+
+    bool await_resume() { return !failed; }
+
+private:
+    long d;
+    bool failed;
+};
+
+
+// co_await readable(client): resume once client has data to read or has
+// been closed, for any client with available() and connected(); false if
+// no timer was free to poll with, in which case it did not wait
+template<typename C>
+class ReadableAwaiter {
+
+public:
+    explicit ReadableAwaiter(C& client) : client(client), timerId(-1) {}
+
+    bool await_ready() { return ready(); }
+
+    bool await_suspend(std::coroutine_handle<TimerCoroutine::promise_type> h) {
+        handle = h;
+        timer = h.promise().timer;
+        timerId = timer->setInterval(SIMPLETIMER_POLL_MS, [this] { poll(); });
+        return timerId >= 0;
+    }
+
+    bool await_resume() { return ready(); }
+
+private:
+    bool ready() { return client.available() > 0 || !client.connected(); }
+
+    void poll() {
+        if (ready()) {
+            // resuming may destroy this awaiter, so finish with it first
+            std::coroutine_handle<TimerCoroutine::promise_type> h = handle;
+            timer->deleteTimer(timerId);
+            h.resume();
+        }
+    }
+
+    C& client;
+    SimpleTimerBase* timer;
+    int timerId;
+    std::coroutine_handle<TimerCoroutine::promise_type> handle;
+};
+
+template<typename C>
+ReadableAwaiter<C> readable(C& client) {
+    return ReadableAwaiter<C>(client);
+}
+
+#endif
+#endif
+
+#endif
@@ -0,0 +1,171 @@
+#include "SimpleTimerCoroutine.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+// a client that only has data once a test says so
+struct FakeClient {
+    int bytes = 0;
+    bool open = true;
+
+    int available() { return bytes; }
+    bool connected() { return open; }
+};
+
+char steps[64];
+int numSteps;
+
+void resetSteps() {
+    numSteps = 0;
+    steps[0] = 0;
+}
+
+void step(char label) {
+    steps[numSteps++] = label;
+    steps[numSteps] = 0;
+}
+
+unsigned long resumedAt;
+bool result;
+
+TimerCoroutine sleeper(char label, long d) {
+    step(label);
+    result = co_await sleep_ms(d);
+    resumedAt = millis();
+    step(label);
+}
+
+TimerCoroutine reader(FakeClient& client) {
+    step('r');
+    result = co_await readable(client);
+    step('R');
+}
+
+void fill(SimpleTimerBase& timer) {
+    while (timer.setInterval(1000, [] {}) >= 0) {
+    }
+}
+
+// run the timer for ms milliseconds, a millisecond at a time
+void runFor(SimpleTimerBase& timer, unsigned long ms) {
+    for (unsigned long i = 0; i < ms; i++) {
+        advance(1);
+        timer.run();
+    }
+}
+
+
+int test_coroutine_sleep() {
+    IT("resumes a sleeping coroutine after its delay, from run()");
+    SimpleTimer timer;
+    resetSteps();
+
+    unsigned long start = millis();
+    sleeper('a', 25).start(timer);
+    IS_TRUE(strcmp(steps, "a") == 0);
+    IS_TRUE(timer.getNumTimers() == 1);
+
+    runFor(timer, 24);
+    IS_TRUE(strcmp(steps, "a") == 0);
+
+    runFor(timer, 1);
+    IS_TRUE(strcmp(steps, "aa") == 0);
+    IS_TRUE(result);
+    IS_TRUE(resumedAt == start + 25);
+    IS_TRUE(timer.getNumTimers() == 0);
+
+    END_IT
+}
+
+int test_coroutine_interleave() {
+    IT("interleaves several coroutines on one timer");
+    SimpleTimer timer;
+    resetSteps();
+
+    sleeper('a', 30).start(timer);
+    sleeper('b', 10).start(timer);
+    sleeper('c', 20).start(timer);
+    IS_TRUE(strcmp(steps, "abc") == 0);
+
+    runFor(timer, 30);
+    IS_TRUE(strcmp(steps, "abcbca") == 0);
+
+    END_IT
+}
+
+int test_coroutine_sleep_no_timer() {
+    IT("fails a sleep at once, without blocking, when no timer is free");
+    BasicSimpleTimer<2> timer;
+    fill(timer);
+    resetSteps();
+
+    unsigned long start = millis();
+    sleeper('a', 25).start(timer);
+    IS_TRUE(strcmp(steps, "aa") == 0);
+    IS_FALSE(result);
+    IS_TRUE(millis() == start);
+
+    END_IT
+}
+
+int test_coroutine_readable() {
+    IT("resumes a reader once its client has data");
+    SimpleTimer timer;
+    FakeClient client;
+    resetSteps();
+
+    reader(client).start(timer);
+    runFor(timer, 100);
+    IS_TRUE(strcmp(steps, "r") == 0);
+
+    client.bytes = 3;
+    runFor(timer, SIMPLETIMER_POLL_MS);
+    IS_TRUE(strcmp(steps, "rR") == 0);
+    IS_TRUE(result);
+    IS_TRUE(timer.getNumTimers() == 0);
+
+    END_IT
+}
+
+int test_coroutine_readable_closed() {
+    IT("resumes a reader when its client is closed");
+    SimpleTimer timer;
+    FakeClient client;
+    resetSteps();
+
+    reader(client).start(timer);
+    client.open = false;
+    runFor(timer, SIMPLETIMER_POLL_MS);
+    IS_TRUE(strcmp(steps, "rR") == 0);
+    IS_TRUE(result);
+
+    END_IT
+}
+
+int test_coroutine_readable_no_timer() {
+    IT("fails a read wait at once, without blocking, when no timer is free");
+    BasicSimpleTimer<1> timer;
+    FakeClient client;
+    fill(timer);
+    resetSteps();
+
+    unsigned long start = millis();
+    reader(client).start(timer);
+    IS_TRUE(strcmp(steps, "rR") == 0);
+    IS_FALSE(result);
+    IS_TRUE(millis() == start);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("SimpleTimer coroutines");
+    test_coroutine_sleep();
+    test_coroutine_interleave();
+    test_coroutine_sleep_no_timer();
+    test_coroutine_readable();
+    test_coroutine_readable_closed();
+    test_coroutine_readable_no_timer();
+
+    FINISH
+}
@@ -0,0 +1,19 @@
+#include "Arduino.h"
+
+static unsigned long long now = 0;
+
+unsigned long millis(void) {
+    return (unsigned long)(now / 1000);
+}
+
+unsigned long micros(void) {
+    return (unsigned long)now;
+}
+
+void delay(unsigned long ms) {
+    advance(ms);
+}
+
+void advance(unsigned long ms, unsigned long us) {
+    now += (unsigned long long)ms * 1000 + us;
+}
@@ -0,0 +1,19 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef uint8_t boolean;
+
+// A virtual clock: time only moves when a test, or delay(), moves it
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+
+// advance the clock by ms milliseconds plus us microseconds
+void advance(unsigned long ms, unsigned long us = 0);
+
+#endif // Arduino_h
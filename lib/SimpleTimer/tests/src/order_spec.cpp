@@ -0,0 +1,141 @@
+#include "SimpleTimer.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+// the order callbacks were called in, as a string of timer labels
+char calls[64];
+int numCalls;
+
+void resetCalls() {
+    numCalls = 0;
+    calls[0] = 0;
+}
+
+void called(char label) {
+    calls[numCalls++] = label;
+    calls[numCalls] = 0;
+}
+
+void a() { called('a'); }
+void b() { called('b'); }
+void c() { called('c'); }
+
+
+int test_order_by_deadline() {
+    IT("calls due timers earliest deadline first, whatever order they were set in");
+    SimpleTimer timer;
+    resetCalls();
+
+    timer.setTimeout(30, c);
+    timer.setTimeout(10, a);
+    timer.setTimeout(20, b);
+
+    advance(30);
+    timer.run();
+    IS_TRUE(strcmp(calls, "abc") == 0);
+    IS_TRUE(timer.getNumTimers() == 0);
+
+    END_IT
+}
+
+int test_order_not_due() {
+    IT("calls nothing before the earliest deadline");
+    SimpleTimer timer;
+    resetCalls();
+
+    timer.setInterval(100, a);
+    timer.setTimeout(50, b);
+
+    advance(49);
+    timer.run();
+    IS_TRUE(numCalls == 0);
+
+    advance(1);
+    timer.run();
+    IS_TRUE(strcmp(calls, "b") == 0);
+
+    END_IT
+}
+
+int test_order_next_deadline() {
+    IT("reports the earliest deadline in nextDeadline()");
+    SimpleTimer timer;
+
+    unsigned long now = millis();
+    IS_TRUE((long)(timer.nextDeadline() - now) > 1000000L);
+
+    int slow = timer.setInterval(100, a);
+    timer.setInterval(70, b);
+    IS_TRUE(timer.nextDeadline() == now + 70);
+
+    timer.setPhase(slow, 5);
+    IS_TRUE(timer.nextDeadline() == now + 5);
+
+    END_IT
+}
+
+int test_order_interval_keeps_period() {
+    IT("keeps an interval timer on its original period");
+    SimpleTimer timer;
+    resetCalls();
+
+    unsigned long start = millis();
+    timer.setInterval(10, a);
+
+    // each run() is 3ms late, the deadlines must not drift
+    for (int i = 1; i <= 5; i++) {
+        advance(10 * i + 3 - (millis() - start));
+        timer.run();
+    }
+    IS_TRUE(numCalls == 5);
+    IS_TRUE(timer.nextDeadline() == start + 60);
+
+    END_IT
+}
+
+int test_order_once_per_run() {
+    IT("calls a timer that is several periods late once per run()");
+    SimpleTimer timer;
+    resetCalls();
+
+    timer.setInterval(10, a);
+    timer.setInterval(15, b);
+
+    advance(45);
+    timer.run();
+    IS_TRUE(strcmp(calls, "ab") == 0);
+
+    END_IT
+}
+
+int test_order_delete_in_callback() {
+    IT("skips a due timer deleted by an earlier callback in the same run()");
+    SimpleTimer timer;
+    resetCalls();
+
+    static SimpleTimer* t;
+    static int victim;
+    t = &timer;
+    timer.setTimeout(10, [] { called('k'); t->deleteTimer(victim); });
+    victim = timer.setTimeout(20, b);
+
+    advance(20);
+    timer.run();
+    IS_TRUE(strcmp(calls, "k") == 0);
+    IS_TRUE(timer.getNumTimers() == 0);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("SimpleTimer ordering");
+    test_order_by_deadline();
+    test_order_not_due();
+    test_order_next_deadline();
+    test_order_interval_keeps_period();
+    test_order_once_per_run();
+    test_order_delete_in_callback();
+
+    FINISH
+}
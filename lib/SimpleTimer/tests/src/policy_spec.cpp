@@ -0,0 +1,138 @@
+#include "SimpleTimer.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+int count;
+
+void tick() { count++; }
+
+// a callback that takes 250us
+void slowTick() {
+    count++;
+    advance(0, 250);
+}
+
+SimpleTimer::TimerStats statsOf(SimpleTimerBase& timer) {
+    SimpleTimer::TimerStats stats;
+    timer.getStats(0, stats);
+    return stats;
+}
+
+
+int test_policy_catch_up() {
+    IT("makes up every missed tick, once per run(), under CATCH_UP");
+    SimpleTimer timer;
+    unsigned long start = millis();
+    count = 0;
+
+    timer.setInterval(10, tick);
+
+    // a 45ms stall: ticks due at 10, 20, 30 and 40
+    advance(45);
+    for (int i = 0; i < 10; i++) {
+        timer.run();
+    }
+    IS_TRUE(count == 4);
+    IS_TRUE(timer.nextDeadline() == start + 50);
+
+    // the ticks for 10, 20 and 30 ran once the next was already due
+    IS_TRUE(statsOf(timer).missed == 3);
+
+    END_IT
+}
+
+int test_policy_skip() {
+    IT("calls once and keeps the original phase under SKIP");
+    SimpleTimer timer;
+    unsigned long start = millis();
+    count = 0;
+
+    int id = timer.setInterval(10, tick);
+    timer.setMissedTickPolicy(id, SimpleTimer::SKIP);
+
+    advance(45);
+    for (int i = 0; i < 10; i++) {
+        timer.run();
+    }
+    IS_TRUE(count == 1);
+    IS_TRUE(timer.nextDeadline() == start + 50);
+    IS_TRUE(statsOf(timer).missed == 3);
+
+    END_IT
+}
+
+int test_policy_coalesce() {
+    IT("calls once and restarts the period from now under COALESCE");
+    SimpleTimer timer;
+    unsigned long start = millis();
+    count = 0;
+
+    int id = timer.setInterval(10, tick);
+    timer.setMissedTickPolicy(id, SimpleTimer::COALESCE);
+
+    advance(45);
+    for (int i = 0; i < 10; i++) {
+        timer.run();
+    }
+    IS_TRUE(count == 1);
+    IS_TRUE(timer.nextDeadline() == start + 55);
+    IS_TRUE(statsOf(timer).missed == 3);
+
+    END_IT
+}
+
+int test_policy_on_time() {
+    IT("counts nothing missed for a timer run on time");
+    SimpleTimer timer;
+    count = 0;
+
+    timer.setInterval(10, tick);
+    for (int i = 0; i < 5; i++) {
+        advance(10);
+        timer.run();
+    }
+    IS_TRUE(count == 5);
+    IS_TRUE(statsOf(timer).missed == 0);
+
+    END_IT
+}
+
+int test_policy_stats() {
+    IT("records run time and lateness of each call");
+    SimpleTimer timer;
+    count = 0;
+
+    timer.setName(timer.setInterval(10, slowTick), "slow");
+
+    advance(10);
+    timer.run();
+    advance(14);
+    timer.run();
+
+    SimpleTimer::TimerStats stats = statsOf(timer);
+    IS_TRUE(strcmp(stats.name, "slow") == 0);
+    IS_TRUE(stats.interval == 10);
+    IS_TRUE(stats.calls == 2);
+    IS_TRUE(stats.minMicros == 250);
+    IS_TRUE(stats.maxMicros == 250);
+    IS_TRUE(stats.avgMicros == 250);
+    IS_TRUE(stats.maxLateness == 4);
+    IS_TRUE(stats.avgLateness == 2);
+
+    timer.resetStats();
+    IS_TRUE(statsOf(timer).calls == 0);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("SimpleTimer missed tick policies and statistics");
+    test_policy_catch_up();
+    test_policy_skip();
+    test_policy_coalesce();
+    test_policy_on_time();
+    test_policy_stats();
+
+    FINISH
+}
@@ -0,0 +1,155 @@
+#include "SimpleTimer.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+char calls[64];
+int numCalls;
+
+void resetCalls() {
+    numCalls = 0;
+    calls[0] = 0;
+}
+
+void called(char label) {
+    calls[numCalls++] = label;
+    calls[numCalls] = 0;
+}
+
+void high() { called('h'); }
+void normal() { called('n'); }
+void low() { called('l'); }
+
+// each takes 20ms of the budget
+void slowHigh() { called('H'); advance(20); }
+void slowNormal() { called('N'); advance(20); }
+
+SimpleTimer* current;
+int yieldPriority;
+
+// a long callback that lets other timers run while it waits
+void waiting() {
+    called('w');
+    advance(10);
+    current->yieldTask(yieldPriority);
+}
+
+int set(SimpleTimer& timer, long d, timer_callback f, int priority) {
+    int id = timer.setInterval(d, f);
+    timer.setPriority(id, priority);
+    return id;
+}
+
+
+int test_priority_order() {
+    IT("calls due timers most important first");
+    SimpleTimer timer;
+    resetCalls();
+
+    set(timer, 10, low, SimpleTimer::PRIORITY_LOW);
+    set(timer, 10, normal, SimpleTimer::PRIORITY_NORMAL);
+    set(timer, 10, high, SimpleTimer::PRIORITY_HIGH);
+
+    advance(10);
+    timer.run();
+    IS_TRUE(strcmp(calls, "hnl") == 0);
+
+    END_IT
+}
+
+int test_priority_budget() {
+    IT("leaves timers below PRIORITY_HIGH for the next run() once over budget");
+    SimpleTimer timer;
+    resetCalls();
+
+    timer.setBudget(30000);
+    set(timer, 100, slowHigh, SimpleTimer::PRIORITY_HIGH);
+    set(timer, 99, slowNormal, SimpleTimer::PRIORITY_NORMAL);
+    set(timer, 100, normal, SimpleTimer::PRIORITY_NORMAL);
+    set(timer, 100, low, SimpleTimer::PRIORITY_LOW);
+
+    advance(100);
+    timer.run();
+    IS_TRUE(strcmp(calls, "HN") == 0);
+    IS_TRUE(timer.getNumTimers() == 4);
+
+    // the deferred ones are still due and go first
+    resetCalls();
+    timer.run();
+    IS_TRUE(strcmp(calls, "nl") == 0);
+
+    END_IT
+}
+
+int test_priority_budget_high() {
+    IT("never defers a PRIORITY_HIGH timer for the budget");
+    SimpleTimer timer;
+    resetCalls();
+
+    timer.setBudget(10000);
+    set(timer, 100, slowHigh, SimpleTimer::PRIORITY_HIGH);
+    set(timer, 100, slowHigh, SimpleTimer::PRIORITY_HIGH);
+    set(timer, 100, normal, SimpleTimer::PRIORITY_NORMAL);
+
+    advance(100);
+    timer.run();
+    IS_TRUE(strcmp(calls, "HH") == 0);
+
+    END_IT
+}
+
+int test_priority_yield_in_timer() {
+    IT("runs only more important timers when a timer callback yields");
+    SimpleTimer timer;
+    current = &timer;
+    yieldPriority = SimpleTimer::PRIORITY_LOW;
+    resetCalls();
+
+    set(timer, 100, waiting, SimpleTimer::PRIORITY_NORMAL);
+    set(timer, 105, high, SimpleTimer::PRIORITY_HIGH);
+    set(timer, 105, low, SimpleTimer::PRIORITY_LOW);
+
+    advance(100);
+    timer.run();
+    IS_TRUE(strcmp(calls, "wh") == 0);
+
+    resetCalls();
+    timer.run();
+    IS_TRUE(strcmp(calls, "l") == 0);
+
+    END_IT
+}
+
+int test_priority_yield_outside() {
+    IT("runs only timers at the given priority when yielding outside a timer");
+    SimpleTimer timer;
+    current = &timer;
+    yieldPriority = SimpleTimer::PRIORITY_HIGH;
+    resetCalls();
+
+    set(timer, 50, high, SimpleTimer::PRIORITY_HIGH);
+    set(timer, 50, normal, SimpleTimer::PRIORITY_NORMAL);
+    set(timer, 50, low, SimpleTimer::PRIORITY_LOW);
+
+    // e.g. a sample bus subscriber waiting on the network
+    advance(50);
+    waiting();
+    IS_TRUE(strcmp(calls, "wh") == 0);
+
+    resetCalls();
+    timer.yieldTask();
+    IS_TRUE(strcmp(calls, "nl") == 0);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("SimpleTimer priorities, budget and yieldTask()");
+    test_priority_order();
+    test_priority_budget();
+    test_priority_budget_high();
+    test_priority_yield_in_timer();
+    test_priority_yield_outside();
+
+    FINISH
+}
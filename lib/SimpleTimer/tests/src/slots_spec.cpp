@@ -0,0 +1,142 @@
+#include "SimpleTimer.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+int count;
+
+void tick() { count++; }
+
+
+int test_slots_stale_id() {
+    IT("ignores an id whose timer was deleted and its slot reused");
+    BasicSimpleTimer<2> timer;
+    count = 0;
+
+    int first = timer.setInterval(10, tick);
+    timer.deleteTimer(first);
+    int second = timer.setInterval(10, tick);
+
+    // same slot, different id
+    IS_TRUE((first & 0xFF) == (second & 0xFF));
+    IS_TRUE(first != second);
+    IS_TRUE(first >= 0 && second >= 0);
+
+    timer.disable(first);
+    timer.deleteTimer(first);
+    IS_FALSE(timer.isEnabled(first));
+    IS_TRUE(timer.isEnabled(second));
+    IS_TRUE(timer.getNumTimers() == 1);
+
+    advance(10);
+    timer.run();
+    IS_TRUE(count == 1);
+
+    END_IT
+}
+
+int test_slots_ended_timeout() {
+    IT("ignores the id of a timeout that has already run");
+    BasicSimpleTimer<1> timer;
+    count = 0;
+
+    int once = timer.setTimeout(5, tick);
+    advance(5);
+    timer.run();
+    IS_TRUE(count == 1);
+    IS_TRUE(timer.getNumTimers() == 0);
+
+    int next = timer.setInterval(5, tick);
+    timer.deleteTimer(once);
+    IS_TRUE(timer.getNumTimers() == 1);
+    IS_TRUE(timer.isEnabled(next));
+
+    END_IT
+}
+
+int test_slots_capacity() {
+    IT("holds exactly N timers and refuses the next one");
+    BasicSimpleTimer<3> timer;
+
+    IS_TRUE(timer.getNumAvailableTimers() == 3);
+    IS_TRUE(timer.setInterval(10, tick) >= 0);
+    IS_TRUE(timer.setInterval(10, tick) >= 0);
+    int last = timer.setInterval(10, tick);
+    IS_TRUE(last >= 0);
+    IS_TRUE(timer.setInterval(10, tick) == -1);
+    IS_TRUE(timer.getNumAvailableTimers() == 0);
+
+    timer.deleteTimer(last);
+    IS_TRUE(timer.setInterval(10, tick) >= 0);
+
+    END_IT
+}
+
+int test_slots_rejects_empty() {
+    IT("refuses an empty callback");
+    SimpleTimer timer;
+
+    IS_TRUE(timer.setInterval(10, (timer_callback)0) == -1);
+    IS_TRUE(timer.getNumTimers() == 0);
+
+    END_IT
+}
+
+struct Counter {
+    int* target;
+    int step;
+    void operator()() { *target += step; }
+};
+
+int test_slots_closures() {
+    IT("calls lambdas and functors with their captures");
+    SimpleTimer timer;
+    int total = 0;
+    int* p = &total;
+
+    timer.setTimeout(10, [p] { *p += 1; });
+    Counter counter = { &total, 100 };
+    timer.setTimer(10, counter, 2);
+
+    advance(10);
+    timer.run();
+    IS_TRUE(total == 101);
+
+    advance(10);
+    timer.run();
+    IS_TRUE(total == 201);
+    IS_TRUE(timer.getNumTimers() == 0);
+
+    END_IT
+}
+
+int test_slots_delete_self() {
+    IT("lets a closure delete its own timer");
+    SimpleTimer timer;
+    static int id;
+    SimpleTimer* t = &timer;
+    count = 0;
+
+    id = timer.setInterval(10, [t] { count++; t->deleteTimer(id); });
+
+    advance(10);
+    timer.run();
+    advance(10);
+    timer.run();
+    IS_TRUE(count == 1);
+    IS_TRUE(timer.getNumTimers() == 0);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("SimpleTimer slots and closures");
+    test_slots_stale_id();
+    test_slots_ended_timeout();
+    test_slots_capacity();
+    test_slots_rejects_empty();
+    test_slots_closures();
+    test_slots_delete_self();
+
+    FINISH
+}
@@ -0,0 +1,177 @@
+#include "SimpleTimer.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+char calls[64];
+int numCalls;
+
+void resetCalls() {
+    numCalls = 0;
+    calls[0] = 0;
+}
+
+void called(char label) {
+    calls[numCalls++] = label;
+    calls[numCalls] = 0;
+}
+
+void a() { called('a'); }
+void b() { called('b'); }
+void c() { called('c'); }
+
+// number of run() calls in which more than one callback ran, over ms
+int collisions(SimpleTimerBase& timer, unsigned long ms) {
+    int count = 0;
+    for (unsigned long i = 0; i < ms; i++) {
+        advance(1);
+        int before = numCalls;
+        timer.run();
+        if (numCalls - before > 1) {
+            count++;
+        }
+    }
+    return count;
+}
+
+
+int test_stagger_spreads() {
+    IT("spreads timers over the shortest period, shortest period first");
+    SimpleTimer timer;
+    resetCalls();
+
+    unsigned long start = millis();
+    timer.setInterval(300, c);
+    timer.setInterval(100, a);
+    timer.setInterval(200, b);
+    timer.stagger();
+
+    // phases 0, 33 and 66 ms
+    IS_TRUE(timer.nextDeadline() == start);
+    timer.run();
+    IS_TRUE(strcmp(calls, "a") == 0);
+    advance(33);
+    timer.run();
+    IS_TRUE(strcmp(calls, "ab") == 0);
+    advance(33);
+    timer.run();
+    IS_TRUE(strcmp(calls, "abc") == 0);
+
+    END_IT
+}
+
+int test_stagger_no_collisions() {
+    IT("stops timers with related periods falling due in the same run()");
+    SimpleTimer timer;
+
+    timer.setInterval(100, a);
+    timer.setInterval(200, b);
+    timer.setInterval(400, c);
+    resetCalls();
+    IS_TRUE(collisions(timer, 800) > 0);
+
+    SimpleTimer staggered;
+    staggered.setInterval(100, a);
+    staggered.setInterval(200, b);
+    staggered.setInterval(400, c);
+    staggered.stagger();
+    resetCalls();
+    IS_TRUE(collisions(staggered, 800) == 0);
+
+    // a at 0, 100, ... 800, b at 33, 233, ... and c at 66 and 466
+    IS_TRUE(numCalls == 9 + 4 + 2);
+
+    END_IT
+}
+
+int test_stagger_producer_first() {
+    IT("gives a timer a later phase than the timer it runs after");
+    SimpleTimer timer;
+    resetCalls();
+
+    int consumer = timer.setInterval(100, b);
+    int producer = timer.setInterval(1000, a);
+    timer.runAfter(consumer, producer);
+    timer.stagger();
+
+    advance(100);
+    timer.run();
+    IS_TRUE(calls[0] == 'a');
+    IS_TRUE(strchr(calls, 'b') != NULL);
+
+    END_IT
+}
+
+int test_stagger_run_after() {
+    IT("calls a timer after the one it runs after when both are due");
+    SimpleTimer timer;
+    resetCalls();
+
+    int consumer = timer.setInterval(10, b);
+    int producer = timer.setInterval(10, a);
+    timer.setPriority(consumer, SimpleTimer::PRIORITY_HIGH);
+    timer.runAfter(consumer, producer);
+
+    advance(10);
+    timer.run();
+    IS_TRUE(strcmp(calls, "ab") == 0);
+
+    END_IT
+}
+
+int test_stagger_leaves_timeouts() {
+    IT("leaves timeouts and limited timers where they are");
+    SimpleTimer timer;
+    resetCalls();
+
+    unsigned long start = millis();
+    timer.setTimeout(50, c);
+    timer.setTimer(70, b, 3);
+    timer.setInterval(100, a);
+    timer.stagger();
+
+    IS_TRUE(timer.nextDeadline() == start);
+    timer.run();
+    IS_TRUE(strcmp(calls, "a") == 0);
+    IS_TRUE(timer.nextDeadline() == start + 50);
+
+    END_IT
+}
+
+SimpleTimer* current;
+
+void staggerFromCallback() {
+    called('s');
+    current->stagger();
+}
+
+int test_stagger_in_callback() {
+    IT("does nothing when called from a callback");
+    SimpleTimer timer;
+    current = &timer;
+    resetCalls();
+
+    unsigned long start = millis();
+    timer.setInterval(40, staggerFromCallback);
+    timer.setInterval(40, a);
+    timer.setInterval(40, b);
+
+    advance(40);
+    timer.run();
+    IS_TRUE(numCalls == 3);
+    IS_TRUE(timer.nextDeadline() == start + 80);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("SimpleTimer stagger()");
+    test_stagger_spreads();
+    test_stagger_no_collisions();
+    test_stagger_producer_first();
+    test_stagger_run_after();
+    test_stagger_leaves_timeouts();
+    test_stagger_in_callback();
+
+    FINISH
+}
@@ -0,0 +1,32 @@
+/*
+ * Units.cpp
+ *
+ * Units - conversions of the sensor values to the units they are
+ * reported in.
+ */
+
+
+#include "Units.h"
+
+
+int32_t toFahrenheit(int32_t celsius) {
+    return (celsius * 9 + (celsius < 0 ? -2 : 2)) / 5 + 3200;
+}
+
+
+int32_t toInchesHg(int32_t pascals) {
+    return (pascals * 2953 + 50000) / 100000;
+}
+
+
+String centiToString(int32_t value) {
+    String s;
+    if (value < 0) {
+        s = "-";
+        value = -value;
+    }
+    s += String(value / 100);
+    s += value % 100 < 10 ? ".0" : ".";
+    s += String(value % 100);
+    return s;
+}
@@ -0,0 +1,25 @@
+/*
+ * Units.h
+ *
+ * Units - conversions of the sensor values, carried as integers in
+ * hundredths (0.01 deg C, 0.01 %RH) from the raw codes to the strings sent
+ * out, to the units they are reported in. The ESP8266 has no FPU, so
+ * these stay in integers too.
+ */
+
+
+#ifndef UNITS_H
+#define UNITS_H
+
+#include <Arduino.h>
+
+// 0.01 deg C to 0.01 deg F, rounded
+int32_t toFahrenheit(int32_t celsius);
+
+// Pa to 0.01 inHg, rounded
+int32_t toInchesHg(int32_t pascals);
+
+// hundredths to a string with two decimals, as String(float) prints
+String centiToString(int32_t value);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+
+typedef uint8_t byte;
+typedef uint8_t boolean;
+
+// The parts of the Arduino String the library uses
+class String {
+public:
+    String() {}
+    String(const char* s) : s(s) {}
+    String(int value) : s(std::to_string(value)) {}
+    String(long value) : s(std::to_string(value)) {}
+
+    String& operator+=(const String& other) {
+        s += other.s;
+        return *this;
+    }
+
+    const char* c_str() const { return s.c_str(); }
+
+private:
+    std::string s;
+};
+
+#endif // Arduino_h
@@ -0,0 +1,74 @@
+#include "Units.h"
+#include "BDDTest.h"
+#include "trace.h"
+#include <stdio.h>
+
+
+int test_units_fahrenheit() {
+    IT("converts 0.01 deg C to 0.01 deg F within 0.5 of the float result");
+    double worst = 0;
+
+    for (int32_t c = -5000; c <= 7000; c++) {
+        double exact = (c / 100.0 * 9 / 5 + 32) * 100;
+        double error = fabs(toFahrenheit(c) - exact);
+        if (error > worst) {
+            worst = error;
+        }
+    }
+    TRACE(worst << " LSB ");
+    IS_TRUE(worst <= 0.5);
+
+    IS_TRUE(toFahrenheit(0) == 3200);
+    IS_TRUE(toFahrenheit(10000) == 21200);
+    IS_TRUE(toFahrenheit(-4000) == -4000);
+
+    END_IT
+}
+
+int test_units_inches() {
+    IT("converts Pa to 0.01 inHg within 0.5 of the float result");
+    double worst = 0;
+
+    for (int32_t pa = 30000; pa <= 110000; pa++) {
+        double exact = pa * 0.0002953 * 100;
+        double error = fabs(toInchesHg(pa) - exact);
+        if (error > worst) {
+            worst = error;
+        }
+    }
+    TRACE(worst << " LSB ");
+    IS_TRUE(worst <= 0.5);
+
+    IS_TRUE(toInchesHg(101325) == 2992);
+
+    END_IT
+}
+
+int test_units_string() {
+    IT("formats hundredths with two decimals as String(float) does");
+    char expected[16];
+
+    for (int32_t value = -10000; value <= 10000; value++) {
+        snprintf(expected, sizeof(expected), "%.2f", value / 100.0);
+        if (strcmp(centiToString(value).c_str(), expected) != 0) {
+            TRACE(value << ": " << centiToString(value).c_str() << " " << expected << " ");
+            IS_TRUE(false);
+        }
+    }
+
+    IS_TRUE(strcmp(centiToString(0).c_str(), "0.00") == 0);
+    IS_TRUE(strcmp(centiToString(-5).c_str(), "-0.05") == 0);
+    IS_TRUE(strcmp(centiToString(2992).c_str(), "29.92") == 0);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("Units");
+    test_units_fahrenheit();
+    test_units_inches();
+    test_units_string();
+
+    FINISH
+}
@@ -14,6 +14,7 @@ RestClient::RestClient(const char* _host){
     ssl = 0;
     fingerprint = NULL;
     num_headers = 0;
+    idleCallback = NULL;
         if (contentType == NULL) {
             contentType = "application/x-www-form-urlencoded";  // default
 	}
@@ -25,6 +26,7 @@ RestClient::RestClient(const char* _host, int _port){
     ssl = 0;
     fingerprint = NULL;
     num_headers = 0;
+    idleCallback = NULL;
         if (contentType == NULL) {
             contentType = "application/x-www-form-urlencoded";  // default
         }
@@ -48,6 +50,7 @@ RestClient::RestClient(const char* _host, int _port, const char* _fingerprint){
     ssl = 1;
     fingerprint = _fingerprint;
     num_headers = 0;
+    idleCallback = NULL;
         if (contentType == NULL) {
             contentType = "application/x-www-form-urlencoded";  // default
         }
@@ -59,6 +62,7 @@ RestClient::RestClient(const char* _host, int _port, int _ssl) {
     ssl = (_ssl) ? 1 : 0;
     fingerprint = NULL;
     num_headers = 0;
+    idleCallback = NULL;
         if (contentType == NULL) {
             contentType = "application/x-www-form-urlencoded";  // default
         }
@@ -150,6 +154,10 @@ void RestClient::setSSL(int _ssl){
     ssl = (_ssl) ? 1 : 0;
 }
 
+void RestClient::setIdleCallback(void (*callback)(void)){
+    idleCallback = callback;
+}
+
 // The mother- generic request method.
 //
 int RestClient::request(const char* method, const char* path,
@@ -291,6 +299,8 @@ int RestClient::readResponse(String* response) {
                         currentLineIsBlank = false;
                     }
                 }
+            } else if (idleCallback) {
+                idleCallback();
             }
         }
         HTTP_DEBUG_PRINT("HTTPS client closed \n");
@@ -336,6 +346,8 @@ int RestClient::readResponse(String* response) {
                         currentLineIsBlank = false;
                     }
                 }
+            } else if (idleCallback) {
+                idleCallback();
             }
         }
     }
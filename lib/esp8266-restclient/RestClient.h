@@ -28,6 +28,9 @@ public:
     void setContentType(const char*);
     // Set SSL support on(1) or off(0)
     void setSSL(int);
+    // Set a function to call while waiting for the response, e.g. to
+    // service other tasks during a slow request
+    void setIdleCallback(void (*callback)(void));
 
     // GET path
     int get(const char*);
@@ -70,6 +73,7 @@ private:
     const char* contentType;
     const char* fingerprint;
     int ssl;
+    void (*idleCallback)(void);
 };
 
 #endif
@@ -5,6 +5,13 @@
 #include <PubSubClient.h>
 #include <ArduinoOTA.h>
 #include <SimpleTimer.h>
+#include <Reactor.h>
+#include <SampleBus.h>
+#include <LoadGovernor.h>
+#include <DerivedMetrics.h>
+#include <SampleHistory.h>
+#include <PressureTendency.h>
+#include <Units.h>
 #include <Wire.h>
 #include <Adafruit_Si7021.h>
 #include <Adafruit_BMP085.h>
@@ -16,10 +23,25 @@ void loop(void);
 void callback(char* p_topic, byte* p_payload, unsigned int p_length);
 void reconnect(void);
 void ReadSensors(void);
+void ConvertSamples(void);
+void PollPressure(void);
+void SchedulePollPressure(void);
 void UpdateDisplay(void);
 void UpdateConsole(void);
 void UpdatePWS(void);
 void MQTTPublish(void);
+void PrintTimerStats(void);
+void NetworkIdle(void);
+boolean TelnetPending(void);
+void TelnetAccept(void);
+boolean TelnetReadable(void);
+void TelnetRead(void);
+boolean SerialReadable(void);
+void SerialRead(void);
+boolean MQTTReadable(void);
+void MQTTService(void);
+void OTAService(void);
+void LoadChanged(uint8_t from, uint8_t to);
 
 #define MQTT_VERSION MQTT_VERSION_3_1_1
 #define SWITCH_DURATION 2000
@@ -39,6 +61,8 @@ String PWS_PASSWORD = _PWS_PASSWORD_;
 
 WiFiClient wifiClient;
 PubSubClient client(wifiClient);
+// Second connection, used to probe the other MQTT server while connected
+WiFiClient probeClient;
 
 WiFiServer server(23);
 WiFiClient serverClients[MAX_SRV_CLIENTS];
@@ -47,12 +71,77 @@ Adafruit_Si7021 sensor = Adafruit_Si7021();
 Adafruit_BMP085 bmp;
 
 SimpleTimer appTimer;
+Reactor reactor(appTimer);
+
+// Sample kinds. ReadSensors() publishes SAMPLE_RSSI and SAMPLE_RAW, the
+// uploads subscribe to SAMPLE_RAW, and ConvertSamples() publishes the rest
+// when an upload asks for them.
+#define SAMPLE_TEMPERATURE  0   // 0.01 deg C
+#define SAMPLE_HUMIDITY     1   // 0.01 %RH
+#define SAMPLE_PRESSURE     2   // sea level, Pa
+#define SAMPLE_DEW_POINT    3   // 0.01 deg C
+#define SAMPLE_RSSI         4   // dBm
+#define SAMPLE_RAW          5   // readings waiting for ConvertSamples()
+#define SAMPLE_PRESSURE_RATE 6  // Pa per hour, which is 0.01 hPa/h
+#define CONVERTED_SAMPLES (SAMPLE_MASK(SAMPLE_TEMPERATURE) | SAMPLE_MASK(SAMPLE_HUMIDITY) | \
+                           SAMPLE_MASK(SAMPLE_PRESSURE) | SAMPLE_MASK(SAMPLE_DEW_POINT))
+SampleBus bus;
+int pwsSubscriber;
+
+// The last minute of readings. Each entry averages HISTORY_OVERSAMPLING
+// sensor ticks, and what is reported is the median of the last five
+// entries, so a single bad read never goes out.
+#define HISTORY_TEMPERATURE 0   // 0.01 deg C
+#define HISTORY_HUMIDITY    1   // 0.01 %RH
+#define HISTORY_PRESSURE    2   // sea level, Pa
+#define HISTORY_OVERSAMPLING 1
+SampleHistory<3, 60> history;
+
+// Dew point, heat index, humidex and absolute humidity, recomputed only
+// when the reported temperature or humidity moves
+DerivedMetrics metrics;
+
+// Three hours of one-minute pressure means, for the pressure tendency; it
+// takes every reading, not just the reported medians
+PressureTendency tendency;
+
+// Raw readings not converted yet, as the sensor codes and the BMP085
+// temperature compensation (B5) each pressure code goes with. Most
+// readings are never reported on their own, so ReadSensors() only stores
+// them and ConvertSamples() converts them all at once when an upload runs,
+// or when RAW_CAPACITY readings are waiting.
+#define RAW_CAPACITY        32
+uint16_t rawHumidity[RAW_CAPACITY], rawTemperature[RAW_CAPACITY];
+int32_t rawPressure[RAW_CAPACITY], rawB5[RAW_CAPACITY];
+unsigned long rawTimes[RAW_CAPACITY];
+uint8_t rawCount;
+// Set once each sensor has given a reading. A sensor that misses a tick
+// repeats its last reading (the Si7021 codes are kept here, the BMP085
+// keeps its own), so the other one is still reported.
+bool si7021Seen, bmp085Seen;
+uint16_t lastHumidityCode, lastTemperatureCode;
+// Set while no timer was free to poll the BMP085 with
+bool pressureUnpolled;
+
+// Load levels: the console and display are dropped first, then the PWS
+// upload slows down. Sampling and the MQTT keepalive are never shed.
+#define LOAD_SHED_UI        1
+#define LOAD_SHED_UPLOADS   2
+#define PWS_INTERVAL        30000
+#define PWS_INTERVAL_SHED   120000
+LoadGovernor governor;
+
+// value of millis() at the last MQTT connection attempt
+unsigned long lastReconnect;
 
 // Declare OLED display
 OLED display(D4, D5);
 
 RestClient pws = RestClient("weatherstation.wunderground.com");
 
+// Station altitude, for the sea level pressure
+#define ALTITUDE_METERS     241.20
+
 String gTemperature, gPressure, gHumidity, gRSSI, gDewPoint;
 String gUploadStatus = "N/U";
 
@@ -69,60 +158,162 @@ void callback(char* p_topic, byte* p_payload, unsigned int p_length) {
   Serial.println(payload);
 }
 
+// Make one connection attempt every 5 seconds until connected, rather
+// than blocking everything else while the broker is unreachable
 void reconnect() {
-  // Loop until we're reconnected
-  while (!client.connected()) {
-    Serial.print("INFO: Attempting MQTT connection...");
-    // Attempt to connect
-    if (client.connect(_MQTT_CLIENT_ID_, _MQTT_USER_, _MQTT_PASSWORD_)) {
-      Serial.println("INFO: connected");
-    } else {
-      Serial.print("ERROR: failed, rc=");
-      Serial.print(client.state());
-      Serial.println("DEBUG: try again in 5 seconds");
-      // Wait 5 seconds before retrying
-      delay(5000);
+  if (lastReconnect != 0 && millis() - lastReconnect < 5000) {
+    return;
+  }
+  lastReconnect = millis();
+
+  Serial.print("INFO: Attempting MQTT connection...");
+  // Attempt to connect
+  if (client.connect(_MQTT_CLIENT_ID_, _MQTT_USER_, _MQTT_PASSWORD_)) {
+    Serial.println("INFO: connected");
+  } else {
+    Serial.print("ERROR: failed, rc=");
+    Serial.print(client.state());
+    Serial.println("DEBUG: try again in 5 seconds");
+  }
+}
+
+void ReadSensors() {
+  // Collect the Si7021 conversion started on the previous tick and start
+  // the next one, so the sensor converts between ticks instead of in a
+  // delay(). There is nothing to collect on the first tick.
+  uint16_t humidityCode, temperatureCode;
+  bool haveSi7021 = sensor.readMeasurementCodes(&humidityCode, &temperatureCode);
+  if (haveSi7021) {
+    lastHumidityCode = humidityCode;
+    lastTemperatureCode = temperatureCode;
+    si7021Seen = true;
+  }
+  sensor.startMeasurement();
+  // Same for the BMP085; PollPressure() steps its conversions meanwhile.
+  // When it could not be scheduled, this call steps the measurement in
+  // progress instead of starting over, so the reading is late, not lost.
+  bool haveBMP085 = bmp.measure();
+  bmp085Seen |= haveBMP085;
+  if (haveBMP085 || !pressureUnpolled) {
+    bmp.startMeasurement();
+    SchedulePollPressure();
+  }
+
+  bus.publish(SAMPLE_RSSI, WiFi.RSSI());
+  if (!haveSi7021 && !haveBMP085) {
+    return;
+  }
+
+  rawHumidity[rawCount] = lastHumidityCode;
+  rawTemperature[rawCount] = lastTemperatureCode;
+  rawPressure[rawCount] = bmp.measuredRawPressure();
+  rawB5[rawCount] = bmp.measuredB5();
+  rawTimes[rawCount] = millis();
+  rawCount++;
+  bus.publish(SAMPLE_RAW, rawCount);
+  if (rawCount == RAW_CAPACITY) {
+    ConvertSamples();
+  }
+}
+
+// Convert the raw readings waiting, add them to the history and update
+// what the sinks report; every upload calls this first
+void ConvertSamples() {
+  if (rawCount == 0) {
+    return;
+  }
+
+  int16_t humidity[RAW_CAPACITY], celsius[RAW_CAPACITY];
+  int32_t pressure[RAW_CAPACITY];
+  Adafruit_Si7021::humidityFromCodes(rawHumidity, humidity, rawCount);
+  Adafruit_Si7021::temperatureFromCodes(rawTemperature, celsius, rawCount);
+  bmp.computePressures(rawB5, rawPressure, pressure, rawCount);
+
+  bool added = false;
+  for (uint8_t i = 0; i < rawCount; i++) {
+    int32_t sample[3] = { celsius[i], humidity[i], bmp.sealevelPressure(pressure[i]) };
+    added |= history.add(sample, rawTimes[i]);
+    if (bmp085Seen) {
+      tendency.add(sample[HISTORY_PRESSURE], rawTimes[i]);
+    }
+  }
+  rawCount = 0;
+  if (!added) {
+    return;
+  }
+
+  int16_t medianCelsius = history.median(HISTORY_TEMPERATURE);
+  int16_t medianHumidity = history.median(HISTORY_HUMIDITY);
+  int32_t pressurePa = history.median(HISTORY_PRESSURE);
+
+  gRSSI = bus.value(SAMPLE_RSSI);
+  // Only report a sensor once it has given a reading
+  if (si7021Seen) {
+    // Sensor reports higher than 100? Fix that.
+    if (medianHumidity > 10000) {
+      medianHumidity = 10000;
     }
+    gHumidity = centiToString(medianHumidity);
+    gTemperature = centiToString(toFahrenheit(medianCelsius));
+    metrics.setInput<METRIC_INPUT_TEMPERATURE>(medianCelsius);
+    metrics.setInput<METRIC_INPUT_HUMIDITY>(medianHumidity);
+    int16_t dewPointC = metrics.value(METRIC_DEW_POINT);
+    gDewPoint = centiToString(toFahrenheit(dewPointC));
+
+    bus.publish(SAMPLE_TEMPERATURE, medianCelsius);
+    bus.publish(SAMPLE_HUMIDITY, medianHumidity);
+    bus.publish(SAMPLE_DEW_POINT, dewPointC);
+  }
+  if (bmp085Seen) {
+    gPressure = centiToString(toInchesHg(pressurePa));
+    bus.publish(SAMPLE_PRESSURE, pressurePa);
+    if (tendency.ready()) {
+      bus.publish(SAMPLE_PRESSURE_RATE, tendency.rate());
+    }
+  }
+}
+
+// Name of the pressure tendency, as published
+const char* tendencyName() {
+  switch (tendency.tendency()) {
+  case TENDENCY_RISING:
+    return "rising";
+  case TENDENCY_FALLING:
+    return "falling";
+  default:
+    return "steady";
   }
 }
 
-// dewPoint function NOAA
-// reference (1) : http://wahiduddin.net/calc/density_algorithms.htm
-// reference (2) : http://www.colorado.edu/geography/weather_station/Geog_site/about.htm
-//
-float dewPoint(float celsius, float humidity)
-{
-	// (1) Saturation Vapor Pressure = ESGG(T)
-	float RATIO = 373.15 / (273.15 + celsius);
-	float RHS = -7.90298 * (RATIO - 1);
-	RHS += 5.02808 * log10(RATIO);
-	RHS += -1.3816e-7 * (pow(10, (11.344 * (1 - 1/RATIO ))) - 1) ;
-	RHS += 8.1328e-3 * (pow(10, (-3.49149 * (RATIO - 1))) - 1) ;
-	RHS += log10(1013.246);
-
-        // factor -3 is to adjust units - Vapor Pressure SVP * humidity
-	float VP = pow(10, RHS - 3) * humidity;
-
-        // (2) DEWPOINT = F(Vapor Pressure)
-	float T = log(VP/0.61078);   // temp var
-	return (241.88 * T) / (17.558 - T);
+// Advance the BMP085 measurement; it needs a step after each conversion,
+// a few milliseconds apart.
+void PollPressure() {
+  if (!bmp.measure()) {
+    SchedulePollPressure();
+  }
 }
 
-void ReadSensors() {
-  gRSSI = WiFi.RSSI();
-  float gHumidityRaw = sensor.readHumidity();
-  // Sensor reports higher than 100? Fix that.
-  if (gHumidityRaw > 100) {
-    gHumidityRaw = 100;
+// Step the BMP085 again in 5 ms; with every timer in use, ReadSensors()
+// steps it once a tick instead. The step runs at PRIORITY_HIGH like
+// ReadSensors(), so NetworkIdle() lets it through during a PWS upload;
+// otherwise the next tick would start over and drop the reading.
+void SchedulePollPressure() {
+  int timerId = appTimer.setTimeout(5, PollPressure);
+  bool failed = timerId < 0;
+  if (!failed) {
+    appTimer.setPriority(timerId, SimpleTimer::PRIORITY_HIGH);
+  }
+  if (failed && !pressureUnpolled) {
+    Serial.println("WARN: no free timer to poll the BMP085, pressure readings will lag");
   }
-  gHumidity = gHumidityRaw;
-  float gTemperatureRawC = sensor.readTemperature();
-  gTemperature = (gTemperatureRawC * 9 / 5) + 32;
-  gPressure = bmp.readSealevelPressure(241.20) * 0.0002953;
-  gDewPoint = (dewPoint(gTemperatureRawC, gHumidityRaw) * 9 / 5) + 32;
+  pressureUnpolled = failed;
 }
 
 void UpdateDisplay() {
+  if (governor.level() >= LOAD_SHED_UI) {
+    return;
+  }
+
   display.print((char*)"Weather Station");
 
   display.print((char*)"WiFi sig: ", 1, 0);
@@ -146,6 +337,10 @@ void UpdateDisplay() {
 }
 
 void UpdateConsole() {
+    if (governor.level() >= LOAD_SHED_UI) {
+        return;
+    }
+
     Serial.println("---------------------------");
     Serial.print("Humidity: ");
     Serial.print(gHumidity);
@@ -166,12 +361,21 @@ void UpdateConsole() {
     Serial.print("DewPoint: ");
     Serial.print(gDewPoint);
     Serial.println(" F");
+
+    if (tendency.ready()) {
+        Serial.print("Pressure tendency: ");
+        Serial.print(tendencyName());
+        Serial.print(", ");
+        Serial.print(centiToString(tendency.rate()));
+        Serial.println(" hPa/h");
+    }
 }
 
 String response;
 void UpdatePWS() {
 
   String request;
+  ConvertSamples();
 
   request = "/weatherstation/updateweatherstation.php?ID=";
   request += _PWS_ID_;
@@ -203,11 +407,66 @@ void UpdatePWS() {
   gUploadStatus = response;
 }
 
+// Called while the PWS upload waits on the network, so that MQTT and the
+// sensor timers keep their timing during a slow request. The upload runs
+// from the sample bus rather than a timer, so only the PRIORITY_HIGH
+// timers are let through; diagnostics wait for the upload to finish
+void NetworkIdle() {
+  governor.update(ESP.getFreeHeap());
+  client.loop();
+  appTimer.yieldTask(SimpleTimer::PRIORITY_HIGH);
+}
+
 void MQTTPublish() {
+  ConvertSamples();
   client.publish("home/outside/temperature", gTemperature.c_str());
   client.publish("home/outside/humidity", gHumidity.c_str());
   client.publish("home/outside/pressure", gPressure.c_str());
   client.publish("home/outside/dew_point", gDewPoint.c_str());
+  if (tendency.ready()) {
+    client.publish("home/outside/pressure_tendency", tendencyName());
+    client.publish("home/outside/pressure_rate", centiToString(tendency.rate()).c_str());
+  }
+  if (!metrics.available(METRIC_HEAT_INDEX)) {
+    return;
+  }
+  client.publish("home/outside/heat_index", centiToString(toFahrenheit(metrics.value(METRIC_HEAT_INDEX))).c_str());
+  client.publish("home/outside/humidex", centiToString(metrics.value(METRIC_HUMIDEX)).c_str());
+  client.publish("home/outside/absolute_humidity", centiToString(metrics.value(METRIC_ABSOLUTE_HUMIDITY)).c_str());
+}
+
+// Print how long each timer's callback takes and how late it starts, to
+// spot a slow task such as the PWS upload holding up the sensor reads
+void PrintTimerStats() {
+  SimpleTimer::TimerStats stats;
+  Serial.println("---------------------------");
+  Serial.print("load: level ");
+  Serial.print(governor.level());
+  Serial.print(", latency ms avg/peak ");
+  Serial.print(governor.latency());
+  Serial.print("/");
+  Serial.print(governor.peakLatency());
+  Serial.print(", transitions ");
+  Serial.print(governor.transitions());
+  Serial.print(", free heap ");
+  Serial.println(ESP.getFreeHeap());
+  for (int i = 0; appTimer.getStats(i, stats); i++) {
+    Serial.print(stats.name ? stats.name : "timer");
+    Serial.print(": calls ");
+    Serial.print(stats.calls);
+    Serial.print(", run us min/avg/max ");
+    Serial.print(stats.minMicros);
+    Serial.print("/");
+    Serial.print(stats.avgMicros);
+    Serial.print("/");
+    Serial.print(stats.maxMicros);
+    Serial.print(", late ms avg/max ");
+    Serial.print(stats.avgLateness);
+    Serial.print("/");
+    Serial.print(stats.maxLateness);
+    Serial.print(", missed ");
+    Serial.println(stats.missed);
+  }
 }
 
 void setup() {
@@ -221,6 +480,8 @@ void setup() {
   sensor.begin();
 
   // initialize the pressure sensor
+  bmp.setAltitude(ALTITUDE_METERS);
+  history.setOversampling(HISTORY_OVERSAMPLING);
   if (!bmp.begin(1)) {
     Serial.println("Could not find a valid BMP085 sensor, check wiring!");
   //while (1) {}
@@ -229,12 +490,29 @@ void setup() {
   // Initialize display
   // display.begin();
 
-  // Update the user interface and telnet client
-  appTimer.setInterval(2000, UpdateConsole);
-  //appTimer.setInterval(2000, UpdateDisplay);
-  appTimer.setInterval(30000, UpdatePWS);
-  appTimer.setInterval(1000, ReadSensors);
-  appTimer.setInterval(10000, MQTTPublish);
+  // Sample the sensors; the user interface, telnet client and uploads
+  // subscribe to the samples and run, each at its own rate, only after a
+  // new reading. Diagnostics wait for the next pass once a pass of the
+  // timer has taken 50 ms.
+  int timerId;
+  timerId = appTimer.setInterval(1000, ReadSensors);
+  appTimer.setName(timerId, "sensors");
+  appTimer.setPriority(timerId, SimpleTimer::PRIORITY_HIGH);
+  timerId = appTimer.setInterval(60000, PrintTimerStats);
+  appTimer.setName(timerId, "stats");
+  appTimer.setPriority(timerId, SimpleTimer::PRIORITY_LOW);
+  // The console and display show the converted values, which only change
+  // when ConvertSamples() runs, for the MQTT upload every 10 s or a full
+  // batch. So they refresh about every 10 s, and lag the sensors by up to
+  // that; the 2000 ms is only a cap in case conversions come faster.
+  bus.subscribe(CONVERTED_SAMPLES, 2000, UpdateConsole);
+  //bus.subscribe(CONVERTED_SAMPLES, 2000, UpdateDisplay);
+  pwsSubscriber = bus.subscribe(SAMPLE_MASK(SAMPLE_RAW), PWS_INTERVAL, UpdatePWS);
+  bus.subscribe(SAMPLE_MASK(SAMPLE_RAW), 10000, MQTTPublish);
+  appTimer.stagger();
+  appTimer.setBudget(50000);
+  pws.setIdleCallback(NetworkIdle);
+  governor.onChange(LoadChanged);
 
   Serial.print("INFO: Connecting to ");
   WiFi.mode(WIFI_STA);
@@ -291,61 +569,127 @@ void setup() {
   Serial.println(WiFi.localIP());
 
   // init the MQTT connection
-  client.setServer(_MQTT_SERVER_IP_, _MQTT_SERVER_PORT_);
+  client.addServer(_MQTT_SERVER_IP_, _MQTT_SERVER_PORT_);
+#ifdef _MQTT_SERVER2_IP_
+  client.addServer(_MQTT_SERVER2_IP_, _MQTT_SERVER2_PORT_);
+  client.setProbeClient(probeClient);
+#endif
   client.setCallback(callback);
 
+  // Event sources for loop(); the services are cheap, so they stay off the
+  // staggered schedule above
+  reactor.watch(TelnetPending, TelnetAccept);
+  reactor.watch(TelnetReadable, TelnetRead);
+  reactor.watch(SerialReadable, SerialRead);
+  reactor.watch(MQTTReadable, MQTTService);
+  reactor.watch([]() -> boolean { return bus.pending(); }, []() { bus.dispatch(); });
+  timerId = appTimer.setInterval(1000, MQTTService);
+  appTimer.setName(timerId, "mqtt loop");
+  appTimer.setPriority(timerId, SimpleTimer::PRIORITY_HIGH);
+  timerId = appTimer.setInterval(100, OTAService);
+  appTimer.setName(timerId, "ota");
+#ifdef _WIFI_LIGHT_SLEEP_
+  // Let the reactor's idle time become light sleep
+  WiFi.setSleepMode(WIFI_LIGHT_SLEEP);
+#endif
+
   ReadSensors();
 }
 
-void loop() {
-  if (!client.connected()) {
-    reconnect();
-  }
+// Reactor sources: each handler runs only on a pass where its source has
+// something to do
+boolean TelnetPending() {
+  return server.hasClient();
+}
 
+void TelnetAccept() {
   uint8_t i;
-  //check if there are any new clients
-  if (server.hasClient()){
-    for(i = 0; i < MAX_SRV_CLIENTS; i++){
-      //find free/disconnected spot
-      if (!serverClients[i] || !serverClients[i].connected()){
-        if(serverClients[i]) serverClients[i].stop();
-        serverClients[i] = server.available();
-        Serial1.print("New client: "); Serial1.print(i);
-        continue;
-      }
+  for(i = 0; i < MAX_SRV_CLIENTS; i++){
+    //find free/disconnected spot
+    if (!serverClients[i] || !serverClients[i].connected()){
+      if(serverClients[i]) serverClients[i].stop();
+      serverClients[i] = server.available();
+      Serial1.print("New client: "); Serial1.print(i);
+      continue;
     }
-    //no free/disconnected spot so reject
-    WiFiClient serverClient = server.available();
-    serverClient.stop();
   }
+  //no free/disconnected spot so reject
+  WiFiClient serverClient = server.available();
+  serverClient.stop();
+}
 
-  //check clients for data
-  for(i = 0; i < MAX_SRV_CLIENTS; i++){
+boolean TelnetReadable() {
+  for(uint8_t i = 0; i < MAX_SRV_CLIENTS; i++){
+    if (serverClients[i] && serverClients[i].connected() && serverClients[i].available()){
+      return true;
+    }
+  }
+  return false;
+}
+
+void TelnetRead() {
+  for(uint8_t i = 0; i < MAX_SRV_CLIENTS; i++){
     if (serverClients[i] && serverClients[i].connected()){
-      if(serverClients[i].available()){
-        //get data from the telnet client and push it to the UART
-        while(serverClients[i].available()) Serial.write(serverClients[i].read());
-      }
+      //get data from the telnet client and push it to the UART
+      while(serverClients[i].available()) Serial.write(serverClients[i].read());
     }
   }
+}
 
-  //check UART for data
-  // To echo local debug information (from Serial.println()) place a
-  // jumper wire between TX & RX on the ESP8266.
-  if(Serial.available()){
-    size_t len = Serial.available();
-    uint8_t sbuf[len];
-    Serial.readBytes(sbuf, len);
-    //push UART data to all connected telnet clients
-    for(i = 0; i < MAX_SRV_CLIENTS; i++){
-      if (serverClients[i] && serverClients[i].connected()){
-        serverClients[i].write(sbuf, len);
-        delay(1);
-      }
+boolean SerialReadable() {
+  return Serial.available();
+}
+
+// To echo local debug information (from Serial.println()) place a
+// jumper wire between TX & RX on the ESP8266.
+void SerialRead() {
+  size_t len = Serial.available();
+  uint8_t sbuf[len];
+  Serial.readBytes(sbuf, len);
+  //push UART data to all connected telnet clients
+  for(uint8_t i = 0; i < MAX_SRV_CLIENTS; i++){
+    if (serverClients[i] && serverClients[i].connected()){
+      serverClients[i].write(sbuf, len);
+      delay(1);
     }
   }
+}
 
-  appTimer.run();
-  ArduinoOTA.handle();
+boolean MQTTReadable() {
+  return wifiClient.available();
+}
+
+// Also run on a timer for the keepalive and to reconnect
+void MQTTService() {
+  if (!client.connected()) {
+    reconnect();
+  }
   client.loop();
 }
+
+void OTAService() {
+  ArduinoOTA.handle();
+}
+
+// Report load level changes and apply the ones the sinks don't check
+void LoadChanged(uint8_t from, uint8_t to) {
+  Serial.print("WARN: load level ");
+  Serial.print(from);
+  Serial.print(" -> ");
+  Serial.print(to);
+  Serial.print(", latency ");
+  Serial.print(governor.latency());
+  Serial.print(" ms, free heap ");
+  Serial.println(ESP.getFreeHeap());
+
+  bus.setInterval(pwsSubscriber, to >= LOAD_SHED_UPLOADS ? PWS_INTERVAL_SHED : PWS_INTERVAL);
+
+  if (client.connected()) {
+    client.publish("home/outside/load", String(to).c_str());
+  }
+}
+
+void loop() {
+  reactor.runOnce();
+  governor.update(ESP.getFreeHeap());
+}